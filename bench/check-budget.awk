@@ -0,0 +1,68 @@
+# -*- coding: utf-8; mode: awk; tab-width: 3; indent-tabs-mode: nil -*-
+#
+# Copyright 2022 Raffaello D. Di Napoli
+#
+# This file is part of RAWR.
+#
+# RAWR is free software: you can redistribute it and/or modify it under the terms of version 2.1 of the GNU
+# Lesser General Public License as published by the Free Software Foundation.
+#
+# RAWR is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+# warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+# for more details.
+#-------------------------------------------------------------------------------------------------------------
+
+# Compares benchmark results against a budget; both are tab-separated “example metric value” lines, with the
+# budget file passed first. Prints every metric exceeding its budget, and exits with 1 if there were any.
+#
+# Metrics without a budget are only counted, unless strict is set to 1, in which case each of them is printed
+# and counts as a failure. If config is set (e.g. to “MCU=atmega328p F_CPU=1000000”), a non-empty budget must
+# have been recorded with the same configuration, since budgets for other ones are not comparable.
+#
+# Usage: awk [-v strict=1] [-v config=...] -f check-budget.awk budget.tsv results.tsv
+
+BEGIN {
+   FS = "\t"
+   failed = 0
+}
+
+FILENAME == ARGV[1] && /^# Recorded with / {
+   recorded_config = substr($0, length("# Recorded with ") + 1)
+   next
+}
+
+/^#/ || NF != 3 {
+   next
+}
+
+FILENAME == ARGV[1] {
+   budget[$1 FS $2] = $3
+   budget_size++
+   next
+}
+
+{
+   key = $1 FS $2
+   if (!(key in budget)) {
+      unbudgeted++
+      if (strict) {
+         printf "%s: %s = %s has no budget\n", $1, $2, $3 >"/dev/stderr"
+         failed = 1
+      }
+   } else if ($3 + 0 > budget[key] + 0) {
+      printf "%s: %s = %s exceeds budget of %s\n", $1, $2, $3, budget[key] >"/dev/stderr"
+      failed = 1
+   }
+}
+
+END {
+   if (config != "" && budget_size && recorded_config != config) {
+      printf "budget was recorded with %s, not %s\n", \
+         recorded_config == "" ? "no configuration" : recorded_config, config >"/dev/stderr"
+      failed = 1
+   }
+   if (unbudgeted) {
+      printf "%d metrics have no budget; run make bench-budget to record them\n", unbudgeted >"/dev/stderr"
+   }
+   exit failed
+}
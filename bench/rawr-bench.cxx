@@ -0,0 +1,195 @@
+/* -*- coding: utf-8; mode: c++; tab-width: 3; indent-tabs-mode: nil -*-
+
+Copyright 2022 Raffaello D. Di Napoli
+
+This file is part of RAWR.
+
+RAWR is free software: you can redistribute it and/or modify it under the terms of version 2.1 of the GNU
+Lesser General Public License as published by the Free Software Foundation.
+
+RAWR is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for
+more details.
+------------------------------------------------------------------------------------------------------------*/
+
+/*! @file
+Host program that runs an AVR ELF file under simavr for a fixed simulated time, and reports run-time metrics
+as tab-separated “metric value” lines on stdout:
+
+   stack                Maximum number of bytes of stack used, i.e. RAMEND minus the lowest SP seen.
+   vectorN.count        Number of times interrupt vector N was serviced.
+   vectorN.cycles       Total CPU cycles spent in interrupt vector N, from its dispatch to reti.
+   vectorN.max_cycles   CPU cycles spent in the longest run of interrupt vector N.
+
+Vectors that were never serviced are not reported. Used by `make bench`; see GNUmakefile.
+
+Usage: rawr-bench -m mcu -f frequency [-s seconds] [-t port_pin:period_ms …] file.elf
+
+Each -t option toggles an input pin (e.g. D4) every period_ms milliseconds, to trigger pin change interrupts
+the same way a button would. */
+
+#include <simavr/avr_ioport.h>
+#include <simavr/sim_avr.h>
+#include <simavr/sim_cycle_timers.h>
+#include <simavr/sim_elf.h>
+#include <simavr/sim_interrupts.h>
+#include <simavr/sim_io.h>
+#include <simavr/sim_irq.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+struct vector_stats {
+   avr_t * avr;
+   uint32_t count;
+   uint64_t cycles;
+   uint64_t max_cycles;
+   //! Cycle at which the vector was last dispatched.
+   avr_cycle_count_t start;
+};
+
+struct pin_toggler {
+   avr_irq_t * irq;
+   avr_cycle_count_t period;
+   uint8_t value;
+};
+
+// Vector numbers fit in 6 bits on every AVR.
+vector_stats stats[64];
+
+//! Invoked with value == 1 when a vector is dispatched, and with value == 0 when it executes reti.
+void vector_running_changed(avr_irq_t *, uint32_t value, void * param) {
+   auto & vs{*static_cast<vector_stats *>(param)};
+   if (value) {
+      vs.start = vs.avr->cycle;
+   } else {
+      auto cycles{vs.avr->cycle - vs.start};
+      ++vs.count;
+      vs.cycles += cycles;
+      if (cycles > vs.max_cycles) {
+         vs.max_cycles = cycles;
+      }
+   }
+}
+
+avr_cycle_count_t toggle_pin(avr_t *, avr_cycle_count_t when, void * param) {
+   auto toggler{static_cast<pin_toggler *>(param)};
+   toggler->value ^= 1;
+   avr_raise_irq(toggler->irq, toggler->value);
+   return when + toggler->period;
+}
+
+void usage(char const * argv0) {
+   fprintf(
+      stderr, "Usage: %s -m mcu -f frequency [-s seconds] [-t port_pin:period_ms ...] file.elf\n", argv0
+   );
+   exit(2);
+}
+
+} //namespace
+
+int main(int argc, char ** argv) {
+   char const * mcu{nullptr};
+   uint32_t frequency{0};
+   uint32_t seconds{5};
+   char const * toggles[16];
+   unsigned toggles_size{0};
+   for (int opt; (opt = getopt(argc, argv, "m:f:s:t:")) != -1; ) {
+      switch (opt) {
+         case 'm':
+            mcu = optarg;
+            break;
+         case 'f':
+            frequency = static_cast<uint32_t>(strtoul(optarg, nullptr, 10));
+            break;
+         case 's':
+            seconds = static_cast<uint32_t>(strtoul(optarg, nullptr, 10));
+            break;
+         case 't':
+            if (toggles_size == sizeof toggles / sizeof toggles[0]) {
+               usage(argv[0]);
+            }
+            toggles[toggles_size++] = optarg;
+            break;
+         default:
+            usage(argv[0]);
+      }
+   }
+   if (!mcu || !frequency || optind != argc - 1) {
+      usage(argv[0]);
+   }
+
+   elf_firmware_t firmware;
+   memset(&firmware, 0, sizeof firmware);
+   if (elf_read_firmware(argv[optind], &firmware) != 0) {
+      fprintf(stderr, "%s: unable to load %s\n", argv[0], argv[optind]);
+      return 1;
+   }
+   avr_t * avr{avr_make_mcu_by_name(mcu)};
+   if (!avr) {
+      fprintf(stderr, "%s: unknown MCU %s\n", argv[0], mcu);
+      return 1;
+   }
+   avr_init(avr);
+   avr_load_firmware(avr, &firmware);
+   avr->frequency = frequency;
+   avr->log = LOG_NONE;
+
+   for (unsigned i = 0; i < avr->interrupts.vector_count; ++i) {
+      auto vector{avr->interrupts.vector[i]};
+      auto & vs{stats[vector->vector]};
+      vs.avr = avr;
+      avr_irq_register_notify(vector->irq + AVR_INT_IRQ_RUNNING, vector_running_changed, &vs);
+   }
+
+   pin_toggler togglers[sizeof toggles / sizeof toggles[0]];
+   for (unsigned i = 0; i < toggles_size; ++i) {
+      char port;
+      unsigned pin, period_ms;
+      if (sscanf(toggles[i], "%c%u:%u", &port, &pin, &period_ms) != 3 || pin > 7 || period_ms == 0) {
+         usage(argv[0]);
+      }
+      auto & toggler{togglers[i]};
+      toggler.irq = avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ(port), static_cast<int>(pin));
+      if (!toggler.irq) {
+         fprintf(stderr, "%s: %s has no pin %c%u\n", argv[0], mcu, port, pin);
+         return 1;
+      }
+      toggler.period = avr_usec_to_cycles(avr, period_ms * 1000);
+      // Start high, like an input with a pull-up resistor.
+      toggler.value = 1;
+      avr_raise_irq(toggler.irq, toggler.value);
+      avr_cycle_timer_register(avr, toggler.period, toggle_pin, &toggler);
+   }
+
+   avr_cycle_count_t end_cycle{static_cast<avr_cycle_count_t>(frequency) * seconds};
+   uint16_t min_sp{static_cast<uint16_t>(avr->ramend)};
+   while (avr->cycle < end_cycle) {
+      int state{avr_run(avr)};
+      if (state == cpu_Done || state == cpu_Crashed) {
+         fprintf(stderr, "%s: simulation stopped after %" PRIu64 " cycles\n", argv[0], avr->cycle);
+         return 1;
+      }
+      auto sp{static_cast<uint16_t>(avr->data[R_SPL] | (avr->data[R_SPH] << 8))};
+      if (sp < min_sp) {
+         min_sp = sp;
+      }
+   }
+
+   printf("stack\t%u\n", static_cast<unsigned>(avr->ramend - min_sp));
+   for (unsigned vector = 0; vector < sizeof stats / sizeof stats[0]; ++vector) {
+      auto const & vs{stats[vector]};
+      if (vs.count) {
+         printf("vector%u.count\t%" PRIu32 "\n", vector, vs.count);
+         printf("vector%u.cycles\t%" PRIu64 "\n", vector, vs.cycles);
+         printf("vector%u.max_cycles\t%" PRIu64 "\n", vector, vs.max_cycles);
+      }
+   }
+   return 0;
+}
@@ -0,0 +1,64 @@
+/* -*- coding: utf-8; mode: c++; tab-width: 3; indent-tabs-mode: nil -*-
+
+Copyright 2022 Raffaello D. Di Napoli
+
+This file is distributed under the terms of the Creative Commons Attribution-ShareAlike 4.0 International
+(CC BY-SA 4.0) license.
+------------------------------------------------------------------------------------------------------------*/
+
+/*! @file
+Analog threshold example
+
+This program will light up an LED connected to B5 while the voltage on ADC0 (C0), e.g. from a potentiometer
+between GND and Vcc, is above half of Vcc. The ADC converts in free running mode, and its samples are
+processed in batches of 16: each batch is decimated into one 12-bit value, which is then smoothed by an IIR
+filter and compared against two thresholds, to avoid flickering around the middle. Between conversions the
+CPU sleeps in ADC noise reduction mode. */
+
+#define RAWR_DEFERRED_CALLBACKS
+#define RAWR_POWER_MANAGEMENT
+
+#include <rawr/adc.hxx>
+#include <rawr/event_loop.hxx>
+#include <rawr/filter.hxx>
+#include <rawr/hw/binary_output_pin.hxx>
+#include <rawr/startup.hxx>
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//! Turns a stream of ADC samples into the state of the LED.
+struct threshold_led {
+   static constexpr uint16_t on_threshold{2048 + 200}, off_threshold{2048 - 200};
+
+   void push(uint16_t sample) {
+      if (decimator.push(sample)) {
+         uint16_t level{filter.push(decimator.value())};
+         if (level > on_threshold) {
+            led.set();
+         } else if (level < off_threshold) {
+            led.clear();
+         }
+      }
+   }
+
+   rawr::hw::binary_output_pin<'B', 5> led;
+   // 10-bit samples in, one 12-bit value out for each batch.
+   rawr::decimator<16, 2> decimator;
+   rawr::iir_filter<3, 12> filter;
+};
+
+void uc_main() {
+   threshold_led threshold_led;
+   rawr::adc<rawr::adc_free_running_trigger, 32> adc{0};
+
+   // Two references, which fit in a rawr::function without enlarging it.
+   adc.set_callback(16, [&adc, &threshold_led] (uint8_t) {
+      uint16_t samples[16];
+      uint8_t count{adc.read(samples, 16)};
+      for (uint8_t i = 0; i < count; ++i) {
+         threshold_led.push(samples[i]);
+      }
+   });
+
+   rawr::event_loop::run();
+}
@@ -10,65 +10,88 @@ This file is distributed under the terms of the Creative Commons Attribution-Sha
 Variable-frequency LED blinker example
 
 Starting from a frequency of 4 Hz, the LED connected to pin B4 (active high) will be toggled at a frequency
-adjustable by grounding D4 (adjust faster) or D5 (adjust slower). */
+adjustable by grounding D4 (adjust faster) or D5 (adjust slower); a new period takes effect from the next
+toggle.
 
-#define RAWR_FUNCTION_DEFAULT_MAX_LAMBDA_SIZE 12
+Each activity is a rawr::task coroutine: one blinks the LED, waiting on the timer_mux between toggles, and one
+per input pin waits for the pin to change, then updates the period. All three share a pool of 3 frames. */
+
+#define RAWR_DEFERRED_CALLBACKS
 
 #include <rawr/binary_input_pin.hxx>
+#include <rawr/event_loop.hxx>
 #include <rawr/hw/binary_output_pin.hxx>
+#include <rawr/inplace_function.hxx>
 #include <rawr/startup.hxx>
+#include <rawr/task.hxx>
 #include <rawr/timer_mux.hxx>
-#include <avr/interrupt.h>
-#include <avr/sleep.h>
 
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-void uc_main() {
-   rawr::hw::binary_output_pin<'B', 4> led{true /*initialize to logic 1*/};
-   rawr::binary_input_pin<'D', 4> toggle_switch_d4{true /*initialize with pull-up*/};
-   rawr::binary_input_pin<'D', 5> toggle_switch_d5{true /*initialize with pull-up*/};
-   rawr::timer_mux<0> timer_mux;
-   rawr::timer_mux<0>::delay_control repeat_control;
-   auto repeat_period{250_ms};
-
-   auto reschedule{[&] {
-      repeat_control = timer_mux.repeat(repeat_period, [&] { led.toggle(); });
-   }};
-   toggle_switch_d4.set_callback([&] (bool value) {
-      if (value) {
-         if (repeat_period) {
-            repeat_period *= 2;
-            if (repeat_period >= timer_mux.min_max_duration) {
-               repeat_period = timer_mux.min_max_duration;
-            }
-         } else {
-            repeat_period = 1_ms;
-         }
-         if (repeat_control) {
-            repeat_control.cancel();
-         } else {
-            led.set();
-         }
-         reschedule();
+typedef rawr::hw::binary_output_pin<'B', 4> led_t;
+template <uint8_t Bit>
+using switch_t = rawr::binary_input_pin<'D', Bit, rawr::resume_callback<bool>>;
+// Delays only store the handle of the coroutine to resume.
+typedef rawr::timer_mux<
+   0, 2, rawr::chrono::milliseconds, rawr::inplace_function<void (), sizeof(void *)>
+> timer_mux_t;
+/* The largest frame is blink()’s, at 25 bytes: 13 of bookkeeping, the two references, the awaitables of
+start.wait() and of the delay, and its duration. */
+typedef rawr::task<3, 28> task_t;
+
+//! Period between toggles; 0 stops the blinking, until start is invoked.
+static auto period{250_ms};
+static rawr::resume_callback<bool> start;
+
+static task_t blink(timer_mux_t & timer_mux, led_t & led) {
+   for (;;) {
+      if (!period) {
+         led.clear();
+         co_await start.wait();
+         led.set();
       }
-   });
-   toggle_switch_d5.set_callback([&] (bool value) {
+      co_await timer_mux.delay(period);
+      if (period) {
+         led.toggle();
+      }
+   }
+}
+
+static task_t double_period(switch_t<4> & toggle_switch) {
+   for (;;) {
+      bool value{co_await toggle_switch.changed()};
       if (value) {
-         repeat_period /= 2;
-         if (repeat_control) {
-            repeat_control.cancel();
-         }
-         if (repeat_period) {
-            reschedule();
+         if (period) {
+            period *= 2;
+            if (period >= timer_mux_t::min_max_duration) {
+               period = timer_mux_t::min_max_duration;
+            }
          } else {
-            repeat_control.cancel();
-            led.clear();
+            period = 1_ms;
+            start(true);
          }
       }
-   });
+   }
+}
 
-   sei();
+static task_t halve_period(switch_t<5> & toggle_switch) {
    for (;;) {
-      sleep_cpu();
+      bool value{co_await toggle_switch.changed()};
+      if (value) {
+         period /= 2;
+      }
    }
 }
+
+void uc_main() {
+   led_t led{true /*initialize to logic 1*/};
+   switch_t<4> toggle_switch_d4{true /*pull-up*/};
+   switch_t<5> toggle_switch_d5{true /*pull-up*/};
+   timer_mux_t timer_mux;
+
+   blink(timer_mux, led);
+   double_period(toggle_switch_d4);
+   halve_period(toggle_switch_d5);
+
+   rawr::event_loop::run();
+}
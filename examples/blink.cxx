@@ -12,11 +12,12 @@ LED blinker example
 This program will toggle pin B3 every 250 ms, making an LED blink if one is connected via a resistor between
 B3 and Vcc or GND. */
 
+#define RAWR_DEFERRED_CALLBACKS
+
+#include <rawr/event_loop.hxx>
 #include <rawr/hw/binary_output_pin.hxx>
 #include <rawr/startup.hxx>
 #include <rawr/timer_mux.hxx>
-#include <avr/interrupt.h>
-#include <avr/sleep.h>
 
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -28,8 +29,5 @@ void uc_main() {
       led.toggle();
    });
 
-   sei();
-   for (;;) {
-      sleep_cpu();
-   }
+   rawr::event_loop::run();
 }
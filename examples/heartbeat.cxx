@@ -10,34 +10,48 @@ This file is distributed under the terms of the Creative Commons Attribution-Sha
 LED blinker example
 
 This program will toggle pin B3 twice every second, making an LED (if one is connected via a resistor between
-B3 and Vcc or GND) blink in a way resemblant of a heartbeat. */
+B3 and Vcc or GND) blink in a way resemblant of a heartbeat. Between beats, the MCU sleeps in power-down mode,
+woken up by the watchdog timer (see rawr::power_manager).
 
+The beat is a rawr::task coroutine waiting on the timer_mux between steps, rather than a chain of callbacks;
+its delays only store the coroutine handle, so they fit an inplace_function the size of a pointer. */
+
+#define RAWR_DEFERRED_CALLBACKS
+#define RAWR_POWER_MANAGEMENT
+
+#include <rawr/event_loop.hxx>
 #include <rawr/hw/binary_output_pin.hxx>
+#include <rawr/inplace_function.hxx>
 #include <rawr/startup.hxx>
+#include <rawr/task.hxx>
 #include <rawr/timer_mux.hxx>
-#include <avr/interrupt.h>
-#include <avr/sleep.h>
 
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-void uc_main() {
-   rawr::hw::binary_output_pin<'B', 3> led{true /*initialize to logic 1*/};
-   rawr::timer_mux<0> timer_mux;
-   timer_mux.repeat(1000_ms, [&] () {
-      led.set();
-      timer_mux.once(100_ms, [&] () {
-         led.clear();
-      });
-      timer_mux.once(200_ms, [&] () {
-         led.set();
-      });
-      timer_mux.once(300_ms, [&] () {
-         led.clear();
-      });
-   });
-
-   sei();
+typedef rawr::hw::binary_output_pin<'B', 3> led_t;
+typedef rawr::timer_mux<
+   0, 2, rawr::chrono::milliseconds, rawr::inplace_function<void (), sizeof(void *)>
+> timer_mux_t;
+
+/* The frame takes 41 bytes: 13 of bookkeeping, the two references, and the four delay awaitables with their
+durations. */
+static rawr::task<1, 44> beat(timer_mux_t & timer_mux, led_t & led) {
    for (;;) {
-      sleep_cpu();
+      led.set();
+      co_await timer_mux.delay(100_ms);
+      led.clear();
+      co_await timer_mux.delay(100_ms);
+      led.set();
+      co_await timer_mux.delay(100_ms);
+      led.clear();
+      co_await timer_mux.delay(700_ms);
    }
 }
+
+void uc_main() {
+   led_t led{true /*initialize to logic 1*/};
+   timer_mux_t timer_mux;
+   beat(timer_mux, led);
+
+   rawr::event_loop::run();
+}
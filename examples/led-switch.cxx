@@ -10,54 +10,36 @@ This file is distributed under the terms of the Creative Commons Attribution-Sha
 Switch-toggled LEDs example
 
 This program will toggle pin B3 every time D5 is grounded (defaults to 1 via pull-up), and B4 every time
-D4 is grounded. Both D4 and D5 feature a software debouncer using timer_mux. */
+D4 is grounded. Both D4 and D5 are debounced by sampling port D every 5 ms via timer_mux. */
 
-#define RAWR_FUNCTION_DEFAULT_MAX_LAMBDA_SIZE 8
+#define RAWR_DEFERRED_CALLBACKS
 
-#include <rawr/binary_input_pin.hxx>
+#include <rawr/debounced_input_pin.hxx>
+#include <rawr/event_loop.hxx>
 #include <rawr/hw/binary_output_pin.hxx>
 #include <rawr/startup.hxx>
 #include <rawr/timer_mux.hxx>
-#include <avr/interrupt.h>
-#include <avr/sleep.h>
 
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 void uc_main() {
    rawr::hw::binary_output_pin<'B', 3> led_b3{true /*initialize to logic 1*/};
    rawr::hw::binary_output_pin<'B', 4> led_b4{true /*initialize to logic 1*/};
-   rawr::binary_input_pin<'D', 4> toggle_switch_d4{true /*initialize with pull-up*/};
-   rawr::binary_input_pin<'D', 5> toggle_switch_d5{true /*initialize with pull-up*/};
+   rawr::debounced_input_pin<'D', 4> toggle_switch_d4{true /*initialize with pull-up*/};
+   rawr::debounced_input_pin<'D', 5> toggle_switch_d5{true /*initialize with pull-up*/};
    rawr::timer_mux<0> timer_mux;
+   rawr::debounced_input_port<'D'> debouncer_d{timer_mux};
 
-   bool ignore_next_d4{false}, ignore_next_d5{false};
    toggle_switch_d4.set_callback([&] (bool value) {
-      if (!ignore_next_d4) {
-         ignore_next_d4 = true;
-         if (!value) {
-            led_b4.toggle();
-         }
-
-         timer_mux.once(200_ms, [&] () {
-            ignore_next_d4 = false;
-         });
+      if (!value) {
+         led_b4.toggle();
       }
    });
    toggle_switch_d5.set_callback([&] (bool value) {
-      if (!ignore_next_d5) {
-         if (!value) {
-            led_b3.toggle();
-         }
-
-         ignore_next_d5 = true;
-         timer_mux.once(200_ms, [&] () {
-            ignore_next_d5 = false;
-         });
+      if (!value) {
+         led_b3.toggle();
       }
    });
 
-   sei();
-   for (;;) {
-      sleep_cpu();
-   }
+   rawr::event_loop::run();
 }
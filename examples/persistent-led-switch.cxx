@@ -0,0 +1,57 @@
+/* -*- coding: utf-8; mode: c++; tab-width: 3; indent-tabs-mode: nil -*-
+
+Copyright 2022 Raffaello D. Di Napoli
+
+This file is distributed under the terms of the Creative Commons Attribution-ShareAlike 4.0 International
+(CC BY-SA 4.0) license.
+------------------------------------------------------------------------------------------------------------*/
+
+/*! @file
+Persistent switch-toggled LEDs example
+
+Like the switch-toggled LEDs example, this program will toggle pin B3 every time D5 is grounded, and B4 every
+time D4 is grounded; the state of the LEDs is also saved to the EEPROM, and restored at startup. Saving
+happens in the background, from the EEPROM ready interrupt, so it doesn’t hold up debouncing, which keeps
+sampling port D every 5 ms via timer_mux. */
+
+#define RAWR_DEFERRED_CALLBACKS
+
+#include <rawr/debounced_input_pin.hxx>
+#include <rawr/eeprom_store.hxx>
+#include <rawr/event_loop.hxx>
+#include <rawr/hw/binary_output_pin.hxx>
+#include <rawr/startup.hxx>
+#include <rawr/timer_mux.hxx>
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct settings {
+   bool led_b3;
+   bool led_b4;
+};
+
+void uc_main() {
+   // Both on, the first time.
+   rawr::eeprom_store<settings, 16> store{settings{true, true}};
+   rawr::hw::binary_output_pin<'B', 3> led_b3{store.get().led_b3};
+   rawr::hw::binary_output_pin<'B', 4> led_b4{store.get().led_b4};
+   rawr::debounced_input_pin<'D', 4> toggle_switch_d4{true /*initialize with pull-up*/};
+   rawr::debounced_input_pin<'D', 5> toggle_switch_d5{true /*initialize with pull-up*/};
+   rawr::timer_mux<0> timer_mux;
+   rawr::debounced_input_port<'D'> debouncer_d{timer_mux};
+
+   toggle_switch_d4.set_callback([&] (bool value) {
+      if (!value) {
+         store.set(&settings::led_b4, !store.get().led_b4);
+         led_b4.set(store.get().led_b4);
+      }
+   });
+   toggle_switch_d5.set_callback([&] (bool value) {
+      if (!value) {
+         store.set(&settings::led_b3, !store.get().led_b3);
+         led_b3.set(store.get().led_b3);
+      }
+   });
+
+   rawr::event_loop::run();
+}
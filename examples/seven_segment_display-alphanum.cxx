@@ -12,11 +12,12 @@ Single 7-segment display alphanumeric enumerator
 This program cycles letters and digits, showing them on a 7-segment display connected as listed in the code,
 below. The increment will occur every second. */
 
+#define RAWR_DEFERRED_CALLBACKS
+
+#include <rawr/event_loop.hxx>
 #include <rawr/seven_segment_display.hxx>
 #include <rawr/startup.hxx>
 #include <rawr/timer_mux.hxx>
-#include <avr/interrupt.h>
-#include <avr/sleep.h>
 
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -43,8 +44,5 @@ void uc_main() {
       display.write(chars[char_index]);
    });
 
-   sei();
-   for (;;) {
-      sleep_cpu();
-   }
+   rawr::event_loop::run();
 }
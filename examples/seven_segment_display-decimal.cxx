@@ -13,12 +13,13 @@ This program count from 0 to 9 over and over, showing the number on a 7-segment
 the code, below. The increment will occur every second, while the decimal point will stay on for half a second
 every second. */
 
+#define RAWR_DEFERRED_CALLBACKS
+
+#include <rawr/event_loop.hxx>
 #include <rawr/hw/binary_output_pin.hxx>
 #include <rawr/seven_segment_display.hxx>
 #include <rawr/startup.hxx>
 #include <rawr/timer_mux.hxx>
-#include <avr/interrupt.h>
-#include <avr/sleep.h>
 
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -47,8 +48,5 @@ void uc_main() {
       dot.toggle();
    });
 
-   sei();
-   for (;;) {
-      sleep_cpu();
-   }
+   rawr::event_loop::run();
 }
@@ -0,0 +1,56 @@
+/* -*- coding: utf-8; mode: c++; tab-width: 3; indent-tabs-mode: nil -*-
+
+Copyright 2022 Raffaello D. Di Napoli
+
+This file is distributed under the terms of the Creative Commons Attribution-ShareAlike 4.0 International
+(CC BY-SA 4.0) license.
+------------------------------------------------------------------------------------------------------------*/
+
+/*! @file
+Multiplexed 4-digit 7-segment display counter
+
+This program counts seconds from 0 to 9999 over and over, showing the number on a common-cathode 4-digit
+7-segment display connected as listed in the code, below. The display is scanned by timer/counter 2, while
+timer/counter 0 is used to count seconds. */
+
+#define RAWR_DEFERRED_CALLBACKS
+
+#include <rawr/event_loop.hxx>
+#include <rawr/multiplexed_seven_segment_display.hxx>
+#include <rawr/startup.hxx>
+#include <rawr/timer_mux.hxx>
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void uc_main() {
+   uint16_t number{0};
+   rawr::multiplexed_seven_segment_display<
+      rawr::seven_segment_display_decimal_font, 2,
+      rawr::binary_output_pin_aggregator<
+         rawr::hw::io_port_pin<'B', 0>, /* A */
+         rawr::hw::io_port_pin<'D', 6>, /* B */
+         rawr::hw::io_port_pin<'D', 4>, /* C */
+         rawr::hw::io_port_pin<'D', 3>, /* D */
+         rawr::hw::io_port_pin<'D', 2>, /* E */
+         rawr::hw::io_port_pin<'B', 1>, /* F */
+         rawr::hw::io_port_pin<'B', 2>  /* G */
+      >,
+      rawr::binary_output_pin_aggregator<
+         rawr::hw::io_port_pin<'C', 0>, /* Leftmost digit */
+         rawr::hw::io_port_pin<'C', 1>,
+         rawr::hw::io_port_pin<'C', 2>,
+         rawr::hw::io_port_pin<'C', 3>  /* Rightmost digit */
+      >
+   > display{100_Hz, 0xc0 /*75% brightness*/};
+   rawr::timer_mux<0> timer_mux;
+
+   display.write_number(number);
+   timer_mux.repeat(1000_ms, [&] () {
+      if (++number > 9999) {
+         number = 0;
+      }
+      display.write_number(number);
+   });
+
+   rawr::event_loop::run();
+}
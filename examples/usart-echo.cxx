@@ -0,0 +1,73 @@
+/* -*- coding: utf-8; mode: c++; tab-width: 3; indent-tabs-mode: nil -*-
+
+Copyright 2022 Raffaello D. Di Napoli
+
+This file is distributed under the terms of the Creative Commons Attribution-ShareAlike 4.0 International
+(CC BY-SA 4.0) license.
+------------------------------------------------------------------------------------------------------------*/
+
+/*! @file
+Serial line echo example
+
+This program will echo back each line received by USART 0 at 9600 baud, 8N1, once its end (CR) is received.
+Lines are transmitted straight from the buffer they were received into, alternating between two buffers so
+that the next line can be received while the previous one is being transmitted; received bytes are read as
+soon as the receive interrupt reports them, so none are dropped even if lines arrive back to back. */
+
+#define RAWR_DEFERRED_CALLBACKS
+
+#include <rawr/event_loop.hxx>
+#include <rawr/startup.hxx>
+#include <rawr/usart.hxx>
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/* The receive ring can hold a whole line, which is as much as can arrive while line_echo::receive() waits for
+a buffer (see below). */
+typedef rawr::usart<0, 9600, 4, 32> usart_t;
+
+class line_echo {
+public:
+   explicit line_echo(usart_t & usart_) :
+      usart{usart_} {
+   }
+
+   //! Reads all received bytes, queuing each line for transmission once complete.
+   void receive() {
+      uint8_t byte;
+      while (usart.read(&byte)) {
+         auto line{lines[current]};
+         line[size++] = static_cast<char>(byte);
+         if (byte == '\r' || size == sizeof lines[0]) {
+            /* The other buffer is free once the line queued from it has been handed to the USART. That takes
+            at most as long as receiving a line, and the receive ring holds whatever arrives meanwhile. */
+            usart.flush();
+            usart.write(line, size);
+            current ^= 1;
+            size = 0;
+         }
+      }
+   }
+
+private:
+   usart_t & usart;
+   char lines[2][32];
+   //! Index of the buffer being received into.
+   uint8_t current{0};
+   //! Bytes received into lines[current].
+   uint8_t size{0};
+};
+
+void uc_main() {
+   usart_t usart;
+   // Any abort() will be reported over the USART before resetting.
+   usart.report_aborts();
+
+   line_echo echo{usart};
+   usart.print_P(PSTR("ready\r\n"));
+   usart.set_rx_callback([&echo] (uint8_t) {
+      echo.receive();
+   });
+
+   rawr::event_loop::run();
+}
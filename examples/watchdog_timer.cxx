@@ -10,37 +10,39 @@ This file is distributed under the terms of the Creative Commons Attribution-Sha
 Watchdog timer example
 
 This program lets the user turn on or off an LED (on B4, active high) by grounding D4 or D5 (active low) while
-the watchdog timer is running. After 4 seconds of inactivity, the microcontroller is reset. */
+the watchdog timer is running. After 4 seconds of inactivity, the microcontroller is reset. The buttons are
+handled by a rawr::pin_change_port, whose interrupt handler tests only D4 and D5. */
 
-#include <rawr/binary_input_pin.hxx>
+#define RAWR_DEFERRED_CALLBACKS
+
+#include <rawr/event_loop.hxx>
 #include <rawr/hw/binary_output_pin.hxx>
 #include <rawr/hw/watchdog_timer.hxx>
+#include <rawr/pin_change_port.hxx>
 #include <rawr/startup.hxx>
-#include <avr/interrupt.h>
-#include <avr/sleep.h>
 
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 void uc_main() {
-   rawr::hw::binary_output_pin<'B', 4> led{false /*initialize to logic 0*/};
-   rawr::binary_input_pin<'D', 4> button_d4{true /*initialize with pull-up*/};
-   rawr::binary_input_pin<'D', 5> button_d5{true /*initialize with pull-up*/};
-   rawr::hw::watchdog_timer wdt;
+   /* Static, so the handlers below can use them without captures; since led is initialized at run time, this
+   relies on -fno-threadsafe-statics (see GNUmakefile). */
+   static rawr::hw::binary_output_pin<'B', 4> led{false /*initialize to logic 0*/};
+   static rawr::hw::watchdog_timer wdt;
+
+   rawr::pin_change_port<
+      'D',
+      rawr::pin_change_handler<4, [] (bool) {
+         led.set();
+         wdt.reset();
+      }>,
+      rawr::pin_change_handler<5, [] (bool) {
+         led.clear();
+         wdt.reset();
+      }>
+   > buttons_d{true /*initialize with pull-up*/};
 
    // Reset after 4 seconds of inactivity.
    wdt.enable(wdt.timeout::_4s);
 
-   button_d4.set_callback([&] (bool) {
-      led.set();
-      wdt.reset();
-   });
-   button_d5.set_callback([&] (bool) {
-      led.clear();
-      wdt.reset();
-   });
-
-   sei();
-   for (;;) {
-      sleep_cpu();
-   }
+   rawr::event_loop::run();
 }
@@ -14,14 +14,37 @@ more details.
 
 #pragma once
 
+#include <inttypes.h>
 #include <rawr/reset.hxx>
 
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 namespace rawr {
 
-inline void abort() {
-   // TODO: output something somewhere.
+//! Reasons for abort(); passed to abort_reporter.
+enum class abort_reason : uint8_t {
+   //! No specific reason given.
+   unspecified,
+   //! rawr::event_loop::post() found the queue full.
+   event_loop_full,
+   //! rawr::timer_mux had no delay available for scheduling.
+   timer_mux_full,
+   //! A rawr::task coroutine was started with all the frames of its pool in use.
+   task_pool_full,
+   //! A rawr::task coroutine needed a frame larger than its FrameSize (only if not caught at compile time).
+   task_frame_too_large,
+};
+
+/*! If set, invoked by abort() before resetting the device, for example to transmit the reason over a serial
+port (see rawr::usart::report_aborts()). It can be invoked with interrupts enabled or disabled, and from an
+interrupt handler, so it must not wait on interrupts. */
+inline void (* abort_reporter)(abort_reason reason) = nullptr;
+
+//! Reports the reason via abort_reporter, if set, and resets the device.
+inline void abort(abort_reason reason = abort_reason::unspecified) {
+   if (abort_reporter) {
+      abort_reporter(reason);
+   }
    reset();
 }
 
@@ -0,0 +1,361 @@
+/* -*- coding: utf-8; mode: c++; tab-width: 3; indent-tabs-mode: nil -*-
+
+Copyright 2022 Raffaello D. Di Napoli
+
+This file is part of RAWR.
+
+RAWR is free software: you can redistribute it and/or modify it under the terms of version 2.1 of the GNU
+Lesser General Public License as published by the Free Software Foundation.
+
+RAWR is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for
+more details.
+------------------------------------------------------------------------------------------------------------*/
+
+#pragma once
+
+#include <rawr/alias.hxx>
+#ifdef RAWR_DEFERRED_CALLBACKS
+   #include <rawr/event_loop.hxx>
+#endif
+#include <rawr/function.hxx>
+#include <rawr/hw/adc.hxx>
+#include <rawr/hw/timer_counter.hxx>
+#include <rawr/misc.hxx>
+#include <rawr/power_manager.hxx>
+#include <rawr/trace.hxx>
+#ifdef RAWR_HOST
+   #include <rawr/host.hxx>
+#else
+   #include <avr/interrupt.h>
+#endif
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace rawr { namespace _pvt {
+
+//! Tag type used to find, via ADL, the interrupt handler of the rawr::adc instantiated; see usart_tag.
+struct adc_tag {
+   friend void adc_interrupt(adc_tag);
+};
+
+class adc_vector {
+private:
+   //! Conversion complete interrupt vector. It has a weird name to work around g++’s name check.
+   static __attribute__((signal, used)) void __vector() {
+      RAWR_ALIAS(RAWR_TOSTRING(ADC_vect), "_ZN4rawr4_pvt10adc_vector8__vectorEv");
+      trace::isr_entry(trace::adc_source());
+      adc_interrupt(adc_tag{});
+      trace::isr_exit(trace::adc_source());
+   }
+};
+
+/*! Ring buffer and interrupt handler of rawr::adc, kept apart from it so that they don’t depend on the type
+of its callback, which is instead reached via a function pointer like binary_input_pin_data does. The ring is
+indexed by two free-running counters, each written by only one side, like usart_base’s receive buffer. */
+template <typename Trigger, uint8_t Capacity>
+class adc_base : private adc_vector {
+protected:
+   static_assert(
+      Capacity >= 2 && Capacity <= 128 && (Capacity & (Capacity - 1)) == 0,
+      "Capacity must be a power of 2, up to 128"
+   );
+
+private:
+   /*! Invoked by the interrupt vector. Being a friend, it’s declared in this namespace, where adc_tag
+   declared it too. */
+   friend void adc_interrupt(adc_tag) {
+      conversion_complete();
+   }
+
+   static void conversion_complete() {
+      Trigger::clear_flag();
+      uint16_t sample{hw::adc::data};
+      uint8_t in{in_count};
+      auto available{static_cast<uint8_t>(in - out_count)};
+      if (available == Capacity) {
+         overrun = true;
+         return;
+      }
+      samples[in & (Capacity - 1)] = sample;
+      in_count = static_cast<uint8_t>(in + 1);
+      if (batch_callback_owner && !callback_pending && available + 1u >= batch_size) {
+         callback_pending = true;
+#ifdef RAWR_DEFERRED_CALLBACKS
+         event_loop::post(batch_dispatch, batch_callback_owner, 0);
+#else
+         batch_dispatch(batch_callback_owner, 0);
+#endif
+      }
+   }
+
+protected:
+   static inline uint16_t samples[Capacity];
+   //! Count of samples stored in samples; only written by the interrupt handler.
+   static inline uint8_t volatile in_count;
+   //! Count of samples read from samples; only written outside of the interrupt handler.
+   static inline uint8_t volatile out_count;
+   //! Set if any samples were dropped since the last check.
+   static inline bool volatile overrun;
+   //! Set from posting the callback until it’s invoked, so that it’s not posted again meanwhile.
+   static inline bool volatile callback_pending;
+   //! Samples that make a batch.
+   static inline uint8_t batch_size;
+   /*! Invokes the callback of batch_callback_owner. The signature matches event_loop::handler_t, so that it
+   can be posted as is. */
+   static inline void (* batch_dispatch)(void * owner, uint8_t);
+   //! rawr::adc whose callback is invoked for each batch, or nullptr if none.
+   static inline void * batch_callback_owner;
+};
+
+}} //namespace rawr::_pvt
+
+namespace rawr {
+
+/*! Trigger for rawr::adc: each conversion starts as soon as the previous one ends, so samples come at a fixed
+fraction of the ADC clock. */
+class adc_free_running_trigger {
+public:
+   static constexpr uint8_t trigger_bits{hw::adc::free_running_trigger};
+   //! Samples per second.
+   static constexpr uint32_t sample_rate{hw::adc_prescaler<>::frequency / hw::adc::conversion_cycles};
+
+public:
+   static void start() {
+   }
+
+   static void stop() {
+   }
+
+   static void clear_flag() {
+   }
+};
+
+/*! Trigger for rawr::adc: conversions start SampleRate times per second, on the compare matches of
+comparator Comparator of timer/counter TimerIndex. The timer/counter runs in CTC mode with TOP = OCRnA, with
+prescaler and TOP chosen at compile time; like for rawr::pwm_output, it’s entirely dedicated to this, and
+since it needs the I/O clock, the CPU can only sleep in idle mode. */
+template <int TimerIndex, char Comparator, uint32_t SampleRate>
+class adc_timer_trigger {
+private:
+   typedef hw::timer_counter<TimerIndex> timer_counter_t;
+   typedef typename timer_counter_t::value_type timer_ticks;
+   typedef typename timer_counter_t::template comparators<Comparator> tc_comp;
+   static constexpr int layout{hw::timer_counter_control_registers_layout<TimerIndex>::layout};
+   static constexpr auto & prescalers{hw::timer_counter_prescaler_list<TimerIndex>::values};
+
+   //! Returns the number of timer ticks in a sample period, with prescalers[i].
+   static constexpr uint32_t period_ticks(uint8_t i) {
+      return int_round_div(static_cast<uint32_t>(F_CPU), prescalers[i] * SampleRate);
+   }
+
+   //! Returns the index of the smallest prescaler, starting from i, for which the period fits the counter.
+   static constexpr uint8_t select(uint8_t i) {
+      return i + 1u == RAWR_COUNTOF(prescalers) || period_ticks(i) <= timer_ticks(~timer_ticks{}) + 1u ?
+         i : select(static_cast<uint8_t>(i + 1));
+   }
+
+   static constexpr uint8_t prescaler_index{select(0)};
+
+public:
+   static constexpr uint8_t trigger_bits{
+      static_cast<uint8_t>(hw::adc_timer_counter_trigger<TimerIndex, Comparator>::bits)
+   };
+   //! Value of OCRnA.
+   static constexpr timer_ticks top{static_cast<timer_ticks>(period_ticks(prescaler_index) - 1)};
+   //! Actual samples per second, after rounding the period to timer ticks.
+   static constexpr uint32_t sample_rate{
+      static_cast<uint32_t>(F_CPU) / (prescalers[prescaler_index] * (uint32_t{top} + 1))
+   };
+
+   static_assert(
+      hw::adc_timer_counter_trigger<TimerIndex, Comparator>::bits >= 0,
+      "the selected MCU can’t trigger the ADC with this timer/comparator combination"
+   );
+   static_assert(
+      period_ticks(prescaler_index) >= 1 && period_ticks(prescaler_index) <= timer_ticks(~timer_ticks{}) + 1u,
+      "SampleRate can’t be generated by this timer/counter"
+   );
+   static_assert(
+      sample_rate <= adc_free_running_trigger::sample_rate,
+      "SampleRate too high: conversions would not complete before the next trigger"
+   );
+
+public:
+   static void start() {
+      power_manager::power_up(_pvt::timer_counter_power_reduction<TimerIndex>::bit);
+      power_manager::require_io_clock(power_manager::timer_counter_clock(TimerIndex), true);
+      timer_counter_t::control_registers.set_wgm(layout == 3 ? 4 : 2);
+      timer_counter_t::value = 0;
+      timer_counter_t::template comparators<'A'>::top = top;
+      if constexpr (Comparator != 'A') {
+         // Match at the same time as comparator A, i.e. once per period.
+         tc_comp::top = top;
+      }
+      clear_flag();
+      timer_counter_t::control_registers.set_cs(static_cast<uint8_t>(prescaler_index + 1));
+   }
+
+   static void stop() {
+      timer_counter_t::control_registers.set_cs(0);
+      power_manager::require_io_clock(power_manager::timer_counter_clock(TimerIndex), false);
+   }
+
+   /*! Clears the compare match flag, since the ADC is only triggered by it going from 0 to 1, and without its
+   interrupt enabled nothing else clears it. */
+   static void clear_flag() {
+#ifdef RAWR_HOST
+      // Writes of 1 clearing interrupt flags are not simulated.
+      timer_counter_t::interrupt_flags.clear_bit(tc_comp::flag_bit);
+#else
+      // Writing back other flags that are set would clear them as well, so don’t read-modify-write.
+      timer_counter_t::interrupt_flags = _BV(tc_comp::flag_bit);
+#endif
+   }
+};
+
+/*! Interrupt-driven driver for the ADC, continuously converting one channel. Conversions are started by
+Trigger, either adc_free_running_trigger or adc_timer_trigger, and their results are stored by the interrupt
+handler in a ring of Capacity samples, a power of 2, to be consumed in batches via read(); samples that don’t
+fit are dropped, and reported by take_overrun(). Results are 10-bit, right-adjusted; they can be smoothed with
+the filters in <rawr/filter.hxx>.
+
+The ADC clock is chosen at compile time from F_CPU (see hw::adc_prescaler). While the ADC is converting,
+rawr::power_manager puts the CPU in ADC noise reduction mode instead of power-down mode, so the CPU sleeps
+between conversions, and only the conversion complete interrupt wakes it up.
+
+A callback can be set to process samples in batches, instead of waking up the program for each of them; it’s
+invoked, or posted to rawr::event_loop if RAWR_DEFERRED_CALLBACKS is defined, once at least batch_size
+samples are available, with the count of samples available, and it should read() them:
+
+   rawr::adc<rawr::adc_timer_trigger<1, 'B', 1000>, 32> adc{0};
+   rawr::iir_filter<4> filter;
+   adc.set_callback(16, [&adc, &filter] (uint8_t) {
+      uint16_t samples[16];
+      for (uint8_t i = 0, count = adc.read(samples, 16); i < count; ++i) {
+         filter.push(samples[i]);
+      }
+   });
+   rawr::event_loop::run();
+
+Callback is the type the callback is stored as, like for rawr::binary_input_pin; with
+rawr::resume_callback<uint8_t>, batch() lets a rawr::task coroutine co_await the next batch.
+
+Only one adc can exist, since there’s only one ADC. To save power, the digital input buffer of the pin can be
+disabled via hw::adc::digital_input_disable; its bits are not numbered after channels on every MCU. */
+template <
+   typename Trigger = adc_free_running_trigger, uint8_t Capacity = 16,
+   typename Callback = function<void (uint8_t)>
+>
+class adc : public _pvt::adc_base<Trigger, Capacity> {
+private:
+   typedef _pvt::adc_base<Trigger, Capacity> adc_base_;
+   typedef hw::adc adc_;
+   typedef hw::adc_prescaler<> prescaler;
+
+public:
+   //! Samples per second.
+   static constexpr uint32_t sample_rate{Trigger::sample_rate};
+
+public:
+   /*! Starts converting a channel, measured against a voltage reference.
+
+   @param channel
+      Value of the MUXn bits of ADMUX, e.g. 0 for ADC0.
+   @param reference
+      Value of the REFSn bits of ADMUX, e.g. hw::adc_references::internal_1v1.
+   */
+   explicit adc(uint8_t channel, uint8_t reference = hw::adc_references::vcc) {
+      power_manager::power_up(_pvt::adc_power_reduction<0>::bit);
+      power_manager::require_adc_clock(true);
+      adc_::multiplexer_selection = static_cast<uint8_t>(reference | (channel & adc_::channel_mask));
+      adc_::control_status_b = static_cast<uint8_t>(
+         (adc_::control_status_b & ~adc_::trigger_source_mask) | Trigger::trigger_bits
+      );
+      // In free running mode, the first conversion must be started explicitly.
+      adc_::control_status_a = static_cast<uint8_t>(
+         _BV(adc_::enable_bit) | _BV(adc_::auto_trigger_enable_bit) | _BV(adc_::interrupt_enable_bit) |
+         (Trigger::trigger_bits == adc_::free_running_trigger ? _BV(adc_::start_conversion_bit) : 0) |
+         prescaler::bits
+      );
+      Trigger::start();
+   }
+
+   /*! Switches to another channel. The conversion in progress, if any, is not affected, and in free running
+   mode the next one has already started, so up to two samples may still come from the previous channel. */
+   void set_channel(uint8_t channel) {
+      adc_::multiplexer_selection = static_cast<uint8_t>(
+         (adc_::multiplexer_selection & ~adc_::channel_mask) | (channel & adc_::channel_mask)
+      );
+   }
+
+   /*! Stops conversions, aborting the one in progress, and the trigger; samples already stored can still be
+   read. */
+   void stop() {
+      adc_::control_status_a = 0;
+      Trigger::stop();
+      power_manager::require_adc_clock(false);
+   }
+
+   //! Returns the number of samples waiting to be read.
+   uint8_t available() const {
+      return static_cast<uint8_t>(adc_base_::in_count - adc_base_::out_count);
+   }
+
+   /*! Moves up to max_count of the oldest samples into dst, returning how many were moved. Doesn’t need to
+   disable interrupts. */
+   uint8_t read(uint16_t * dst, uint8_t max_count) {
+      uint8_t out{adc_base_::out_count}, in{adc_base_::in_count}, count{0};
+      for (; count < max_count && out != in; ++count) {
+         dst[count] = adc_base_::samples[out & (Capacity - 1)];
+         ++out;
+      }
+      adc_base_::out_count = out;
+      return count;
+   }
+
+   //! Returns true, clearing the condition, if any samples were dropped since the last call.
+   bool take_overrun() {
+      bool overrun_{adc_base_::overrun};
+      adc_base_::overrun = false;
+      return overrun_;
+   }
+
+   /*! Sets the callback to invoke once batch_size (at most Capacity) samples are available; it’s invoked
+   again after each further sample until read() makes fewer than batch_size available. */
+   template <typename F>
+   void set_callback(uint8_t batch_size_, F && callback_) {
+      callback = forward<F>(callback_);
+      enable_callback(batch_size_);
+   }
+
+   /*! Returns an awaitable suspending the awaiting rawr::task coroutine until batch_size_ samples are
+   available; the result of co_await is the count of samples available. Callback must be
+   rawr::resume_callback<uint8_t>. */
+   auto batch(uint8_t batch_size_) {
+      enable_callback(batch_size_);
+      return callback.wait();
+   }
+
+private:
+   void enable_callback(uint8_t batch_size_) {
+      uint8_t sreg{SREG};
+      cli();
+      adc_base_::batch_size = batch_size_;
+      adc_base_::batch_callback_owner = callback ? this : nullptr;
+      adc_base_::batch_dispatch = &dispatch;
+      SREG = sreg;
+   }
+
+   //! Invoked by the interrupt handler, or by the event loop if RAWR_DEFERRED_CALLBACKS is defined.
+   static void dispatch(void * owner, uint8_t) {
+      adc_base_::callback_pending = false;
+      auto & owner_{*static_cast<adc *>(owner)};
+      owner_.callback(owner_.available());
+   }
+
+private:
+   Callback callback;
+};
+
+} //namespace rawr
@@ -1,6 +1,6 @@
 /* -*- coding: utf-8; mode: c++; tab-width: 3; indent-tabs-mode: nil -*-
 
-Copyright 2017 Raffaello D. Di Napoli
+Copyright 2017, 2022 Raffaello D. Di Napoli
 
 This file is part of RAWR.
 
@@ -16,8 +16,12 @@ more details.
 
 #include <rawr/alias.hxx>
 #include <rawr/bitmanip.hxx>
+#ifdef RAWR_DEFERRED_CALLBACKS
+   #include <rawr/event_loop.hxx>
+#endif
 #include <rawr/function.hxx>
 #include <rawr/hw/io_port.hxx>
+#include <rawr/trace.hxx>
 
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -49,8 +53,12 @@ struct binary_input_port_asm;
 #endif
 #undef _RAWR_SPECIALIZE_BINARY_INPUT_PORT_ASM
 
+/*! Entry of binary_input_port::per_pin_data. Only points to a function, so that the interrupt handler doesn’t
+depend on the type each binary_input_pin stores its callback as. */
 struct binary_input_pin_data {
-   function<void (bool)> changed_callback;
+   /*! Invokes the pin’s changed callback; pin_data is the binary_input_pin_data itself. The signature matches
+   event_loop::handler_t, so that it can be posted as is. */
+   void (* dispatch)(void * pin_data, uint8_t value);
 };
 
 template <char Port>
@@ -72,18 +80,25 @@ private:
    // Weird name to work around g++ name check for interrupt vectors.
    static __attribute__((signal, used)) void __vector() {
       binary_input_port_asm<Port>::emit();
+      trace::isr_entry(trace::binary_input_port_source(Port));
       uint8_t curr_pins = io_port_::pins, changed_pins = curr_pins ^ last_pins;
       for (uint8_t i = 0; i < RAWR_COUNTOF(per_pin_data); ++i) {
          if ((changed_pins & _BV(i)) == 0) {
             // This pin did not really change.
             continue;
          }
+         // Only set for pins with a changed callback.
          auto pin_data{per_pin_data[i]};
-         if (pin_data && pin_data->changed_callback) {
-            pin_data->changed_callback((curr_pins & _BV(i)) != 0);
+         if (pin_data) {
+#ifdef RAWR_DEFERRED_CALLBACKS
+            event_loop::post(pin_data->dispatch, pin_data, (curr_pins & _BV(i)) != 0);
+#else
+            pin_data->dispatch(pin_data, (curr_pins & _BV(i)) != 0);
+#endif
          }
       }
       last_pins = curr_pins;
+      trace::isr_exit(trace::binary_input_port_source(Port));
    }
 
 protected:
@@ -103,9 +118,13 @@ uint8_t volatile binary_input_port<Port>::last_pins;
 
 namespace rawr {
 
-/*! Configures an I/O port’s pin as input, optionally pre-enabling its pin change interrupt and setting its
-pull-up to the value provided via the third template argument. */
-template <char Port, uint8_t Bit>
+/*! Configures an I/O port’s pin as input, optionally setting its pull-up, and invokes a callback when it
+changes value.
+
+Callback is the type the callback is stored as: the default rawr::function, rawr::inplace_function sized for
+the actual lambda, or rawr::function_ref if the lambda is kept alive by the caller. Pins on the same port can
+use different types. */
+template <char Port, uint8_t Bit, typename Callback = function<void (bool)>>
 class binary_input_pin : public _pvt::binary_input_port<Port>, protected _pvt::binary_input_pin_data {
 private:
    typedef _pvt::binary_input_port<Port> binary_input_port_;
@@ -113,7 +132,8 @@ private:
 
 public:
    //! Configures the pin as input, without activating internal pull-up or pull-down.
-   binary_input_pin() {
+   binary_input_pin() :
+      _pvt::binary_input_pin_data{&dispatch} {
       io_port_::data_direction.clear_bit(Bit);
    }
 
@@ -133,16 +153,41 @@ public:
    }
 
    template <typename F>
-   void set_callback(F callback) {
+   void set_callback(F && callback) {
+      changed_callback = forward<F>(callback);
+      enable_callback();
+   }
+
+   /*! Returns an awaitable suspending the awaiting rawr::task coroutine until the pin changes value, which
+   is then the result of co_await. Callback must be rawr::resume_callback<bool>; changes happening while no
+   coroutine is waiting are ignored. */
+   auto changed() {
+      enable_callback();
+      return changed_callback.wait();
+   }
+
+   bool value() const {
+      return (io_port_::pins & _BV(Bit)) != 0;
+   }
+
+private:
+   //! Starts tracking the pin, so that changes from its current value invoke changed_callback.
+   void enable_callback() {
       binary_input_port_::set_last_pins_bit(Bit);
-      changed_callback = move(callback);
+      binary_input_port_::per_pin_data[Bit] = changed_callback ? this : nullptr;
       io_port_::pcint_mask.set_bit(Bit);
       PCICR.set_bit(io_port_::pcint_enable_bit);
    }
 
-   bool value() const {
-      return (io_port_::pins & _BV(Bit)) != 0;
+   //! Invoked by the interrupt handler, or by the event loop if RAWR_DEFERRED_CALLBACKS is defined.
+   static void dispatch(void * pin_data, uint8_t value) {
+      static_cast<binary_input_pin *>(static_cast<_pvt::binary_input_pin_data *>(pin_data))->changed_callback(
+         value != 0
+      );
    }
+
+private:
+   Callback changed_callback;
 };
 
 } //namespace rawr
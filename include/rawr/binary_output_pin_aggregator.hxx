@@ -15,6 +15,14 @@ more details.
 #pragma once
 
 #include <rawr/hw/binary_output_pin.hxx>
+#include <rawr/hw/io.hxx>
+#include <rawr/hw/io_port.hxx>
+#ifdef RAWR_HOST
+   #include <rawr/host.hxx>
+#else
+   #include <avr/interrupt.h>
+   #include <avr/pgmspace.h>
+#endif
 
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -37,50 +45,171 @@ struct uint_t_from_bytes<2> {
 };
 
 
-/*! Allows to regroup the bits making up an “aggregaged word” into ports, so that all bits in one port may be
-changed simultaneously. */
-template <typename I, typename... IoPortPins>
-struct binary_output_pin_aggregator_impl;
+/*! Maps the bits of an “aggregated word” to the pins of one I/O port, i.e. to the value of its PORTx bits;
+the first pin in IoPortPins corresponds to the most significant bit of the word.
 
-// Base step, selecting bits matching a given I/O port pin.
-template <typename I, typename IoPortPin0>
-struct binary_output_pin_aggregator_impl<I, IoPortPin0> {
-   template <char IfPort>
-   static constexpr uint8_t get_mask() {
-      if (IoPortPin0::port::name != IfPort) {
-         return 0;
-      } else {
-         return 1 << IoPortPin0::pin;
+Everything is computed at compile time, choosing between two ways of doing the mapping at run time:
+•  Shifts: bits that move by the same number of positions from the word to the port are masked and shifted
+   together, so e.g. pins listed in the same order as the port’s bits need a single mask and shift;
+•  Nibble tables: each 4 bits of the word containing any bit for the port index a 16-byte table in program
+   memory, yielding the corresponding port bits; this is cheaper for scattered or reversed pin orders, which
+   need one shift per bit.
+The one needing fewer instructions, as estimated below for the AVR, is used. */
+template <typename I, char Port, typename... IoPortPins>
+class binary_output_pin_port_map {
+private:
+   static constexpr unsigned word_size{sizeof...(IoPortPins)};
+   static constexpr char ports[]{IoPortPins::port::name...};
+   static constexpr uint8_t pins[]{static_cast<uint8_t>(IoPortPins::pin)...};
+   static constexpr unsigned nibbles_size{(word_size + 3) / 4};
+
+   //! Bits of the word that all move by shift positions (left if positive) to get to their pin.
+   struct shift_group {
+      int8_t shift;
+      I word_mask;
+   };
+
+   struct shift_groups_t {
+      shift_group groups[word_size];
+      uint8_t size;
+   };
+
+   struct nibble_tables_t {
+      uint8_t values[nibbles_size][16];
+   };
+
+   //! Returns the bit of the word corresponding to pins[i].
+   static constexpr unsigned word_bit(unsigned i) {
+      return word_size - 1 - i;
+   }
+
+   static constexpr shift_groups_t find_shift_groups() {
+      shift_groups_t ret{};
+      for (unsigned i{0}; i < word_size; ++i) {
+         if (ports[i] != Port) {
+            continue;
+         }
+         auto shift{static_cast<int8_t>(static_cast<int>(pins[i]) - static_cast<int>(word_bit(i)))};
+         uint8_t j{0};
+         while (j < ret.size && ret.groups[j].shift != shift) {
+            ++j;
+         }
+         if (j == ret.size) {
+            ret.groups[j].shift = shift;
+            ++ret.size;
+         }
+         ret.groups[j].word_mask = static_cast<I>(ret.groups[j].word_mask | (I{1} << word_bit(i)));
       }
+      return ret;
    }
 
-   template <char IfPort, unsigned Index = 0>
-   static constexpr uint8_t slice_value(I value) {
-      if (IoPortPin0::port::name != IfPort) {
-         return 0;
-      } else if ((value & (1 << Index)) == 0) {
-         return 0;
+   static constexpr nibble_tables_t make_nibble_tables() {
+      nibble_tables_t ret{};
+      for (unsigned i{0}; i < word_size; ++i) {
+         if (ports[i] != Port) {
+            continue;
+         }
+         auto nibble{word_bit(i) / 4};
+         auto nibble_bit{word_bit(i) % 4};
+         for (unsigned value{0}; value < 16; ++value) {
+            if ((value & (1u << nibble_bit)) != 0) {
+               ret.values[nibble][value] = static_cast<uint8_t>(ret.values[nibble][value] | (1 << pins[i]));
+            }
+         }
+      }
+      return ret;
+   }
+
+   //! Returns true if any bit of the specified nibble of the word maps to a pin of Port.
+   static constexpr bool nibble_used(unsigned nibble) {
+      for (unsigned i{0}; i < word_size; ++i) {
+         if (ports[i] == Port && word_bit(i) / 4 == nibble) {
+            return true;
+         }
+      }
+      return false;
+   }
+
+   //! Estimated instructions for the shifts: and, or, and one per bit shifted, or swap + and for 4 bits.
+   static constexpr unsigned shifts_cost() {
+      unsigned cost{0};
+      for (uint8_t j{0}; j < shift_groups.size; ++j) {
+         auto shift{static_cast<unsigned>(shift_groups.groups[j].shift < 0 ?
+            -shift_groups.groups[j].shift : shift_groups.groups[j].shift
+         )};
+         cost += 2 + (shift >= 4 ? 2 + shift - 4 : shift);
+      }
+      return cost;
+   }
+
+   //! Estimated instructions for the table lookups: extracting the nibble, adding it to Z, lpm and or.
+   static constexpr unsigned nibble_tables_cost() {
+      unsigned cost{0};
+      for (unsigned nibble{0}; nibble < nibbles_size; ++nibble) {
+         if (nibble_used(nibble)) {
+            cost += 8;
+         }
+      }
+      return cost;
+   }
+
+   static constexpr uint8_t find_mask() {
+      uint8_t mask_{0};
+      for (unsigned i{0}; i < word_size; ++i) {
+         if (ports[i] == Port) {
+            mask_ = static_cast<uint8_t>(mask_ | (1 << pins[i]));
+         }
+      }
+      return mask_;
+   }
+
+   static constexpr shift_groups_t shift_groups{find_shift_groups()};
+   static constexpr bool use_nibble_tables{nibble_tables_cost() < shifts_cost()};
+   static constexpr nibble_tables_t nibble_tables PROGMEM{make_nibble_tables()};
+
+public:
+   //! Pins of Port used by the word; 0 if none.
+   static constexpr uint8_t mask{find_mask()};
+
+   //! Returns the value of the bits of PORTx in mask corresponding to the word value; other bits are 0.
+   static uint8_t map(I value) {
+      if constexpr (use_nibble_tables) {
+         return map_nibbles<0>(value);
       } else {
-         return 1 << IoPortPin0::pin;
+         return map_shift_groups<0>(value);
       }
    }
-};
 
-// Recursive step, grouping bits based on the I/O port they correspond to.
-template <typename I, typename IoPortPin0, typename... IoPortPins>
-struct binary_output_pin_aggregator_impl<I, IoPortPin0, IoPortPins...> {
-   template <char IfPort>
-   static constexpr uint8_t get_mask() {
-      return
-         binary_output_pin_aggregator_impl<I, IoPortPin0>::template get_mask<IfPort>() |
-         binary_output_pin_aggregator_impl<I, IoPortPins...>::template get_mask<IfPort>();
+private:
+   template <uint8_t Group>
+   static uint8_t map_shift_groups(I value) {
+      if constexpr (Group == shift_groups.size) {
+         return 0;
+      } else {
+         constexpr auto shift{shift_groups.groups[Group].shift};
+         auto bits{static_cast<I>(value & shift_groups.groups[Group].word_mask)};
+         uint8_t port_bits;
+         if constexpr (shift >= 0) {
+            port_bits = static_cast<uint8_t>(bits << shift);
+         } else {
+            port_bits = static_cast<uint8_t>(bits >> -shift);
+         }
+         return static_cast<uint8_t>(port_bits | map_shift_groups<Group + 1>(value));
+      }
    }
 
-   template <char IfPort, unsigned Index = 0>
-   static constexpr uint8_t slice_value(I value) {
-      return
-         binary_output_pin_aggregator_impl<I, IoPortPin0>::template slice_value<IfPort, sizeof...(IoPortPins) - Index>(value) |
-         binary_output_pin_aggregator_impl<I, IoPortPins...>::template slice_value<IfPort, Index>(value);
+   template <unsigned Nibble>
+   static uint8_t map_nibbles(I value) {
+      if constexpr (Nibble == nibbles_size) {
+         return 0;
+      } else if constexpr (!nibble_used(Nibble)) {
+         return map_nibbles<Nibble + 1>(value);
+      } else {
+         auto index{static_cast<uint8_t>((value >> (Nibble * 4)) & 0xf)};
+         return static_cast<uint8_t>(
+            pgm_read_byte(&nibble_tables.values[Nibble][index]) | map_nibbles<Nibble + 1>(value)
+         );
+      }
    }
 };
 
@@ -89,7 +218,13 @@ struct binary_output_pin_aggregator_impl<I, IoPortPin0, IoPortPins...> {
 namespace rawr {
 
 /*! Aggregates a variable number of I/O pins as output, dispatching to each individual pin individual bits
-from the desired output word, synchronizing the output across them. */
+from the desired output word, synchronizing the output across them.
+
+The bits for each port are rearranged by code generated at compile time (see
+_pvt::binary_output_pin_port_map), and applied with a single write per port: to PINx, toggling the bits of
+PORTx that need to change, on MCUs that support it; otherwise, with a read-modify-write of PORTx with
+interrupts disabled. Either way, interrupt handlers are free to change other pins of the same ports at any
+time, but the pins of the aggregator must not be changed by anything else. */
 template <typename... IoPortPins>
 class binary_output_pin_aggregator {
 public:
@@ -97,7 +232,8 @@ public:
    using word_type = typename _pvt::uint_t_from_bytes<(word_size + 7) / 8>::type;
 
 private:
-   using impl = _pvt::binary_output_pin_aggregator_impl<word_type, IoPortPins...>;
+   template <char Port>
+   using port_map = _pvt::binary_output_pin_port_map<word_type, Port, IoPortPins...>;
 
 public:
    constexpr binary_output_pin_aggregator() = default;
@@ -106,97 +242,163 @@ public:
       set(value);
    }
 
-   //! Changes all output pins to a new logical value, according to the bits in the argument.
+   //! Configures all the pins as outputs; this is not done by the constructors.
+   static void configure_outputs() {
+      (IoPortPins::port::data_direction.set_bit(IoPortPins::pin), ...);
+   }
+
+   /*! Changes all output pins to a new logical value, according to the bits in the argument. An interrupt
+   can occur between the updates of two ports; see set_atomically(). */
    void set(word_type value) {
-      /* First calculate all masks and values, and only then set all pins. This should minimize undesirable
-      intermediate states. */
+      update<false>(value);
+   }
+
+   /*! Like set(), but keeps interrupts disabled while updating the ports, so that no interrupt handler can
+   observe or extend an intermediate state. Since everything is computed beforehand, interrupts are only
+   disabled for one write per port (one out instruction each, if the MCU can toggle pins via PINx). */
+   void set_atomically(word_type value) {
+      update<true>(value);
+   }
+
+private:
+   //! Values returned by prepare() for each port, to be passed to write().
+   struct prepared_ports {
 #ifdef PORTA
-      auto a_mask{impl::template get_mask<'A'>()};
-      auto a_value{impl::template slice_value<'A'>(value)};
+      uint8_t a;
 #endif
 #ifdef PORTB
-      auto b_mask{impl::template get_mask<'B'>()};
-      auto b_value{impl::template slice_value<'B'>(value)};
+      uint8_t b;
 #endif
 #ifdef PORTC
-      auto c_mask{impl::template get_mask<'C'>()};
-      auto c_value{impl::template slice_value<'C'>(value)};
+      uint8_t c;
 #endif
 #ifdef PORTD
-      auto d_mask{impl::template get_mask<'D'>()};
-      auto d_value{impl::template slice_value<'D'>(value)};
+      uint8_t d;
 #endif
 #ifdef PORTE
-      auto e_mask{impl::template get_mask<'E'>()};
-      auto e_value{impl::template slice_value<'E'>(value)};
+      uint8_t e;
 #endif
 #ifdef PORTF
-      auto f_mask{impl::template get_mask<'F'>()};
-      auto f_value{impl::template slice_value<'F'>(value)};
+      uint8_t f;
 #endif
 #ifdef PORTG
-      auto g_mask{impl::template get_mask<'G'>()};
-      auto g_value{impl::template slice_value<'G'>(value)};
+      uint8_t g;
 #endif
 #ifdef PORTH
-      auto h_mask{impl::template get_mask<'H'>()};
-      auto h_value{impl::template slice_value<'H'>(value)};
+      uint8_t h;
 #endif
 #ifdef PORTJ
-      auto j_mask{impl::template get_mask<'J'>()};
-      auto j_value{impl::template slice_value<'J'>(value)};
+      uint8_t j;
 #endif
+   };
+
+   template <bool Atomic>
+   static void update(word_type value) {
+      /* First calculate all values, and only then write them to all ports. This should minimize undesirable
+      intermediate states. */
+      prepared_ports prepared{
 #ifdef PORTA
-      if (a_mask) {
-         set_slice(a_mask, a_value, PORTA);
-      }
+         prepare<'A'>(value),
 #endif
 #ifdef PORTB
-      if (b_mask) {
-         set_slice(b_mask, b_value, PORTB);
-      }
+         prepare<'B'>(value),
 #endif
 #ifdef PORTC
-      if (c_mask) {
-         set_slice(c_mask, c_value, PORTC);
-      }
+         prepare<'C'>(value),
 #endif
 #ifdef PORTD
-      if (d_mask) {
-         set_slice(d_mask, d_value, PORTD);
-      }
+         prepare<'D'>(value),
 #endif
 #ifdef PORTE
-      if (e_mask) {
-         set_slice(e_mask, e_value, PORTE);
-      }
+         prepare<'E'>(value),
 #endif
 #ifdef PORTF
-      if (f_mask) {
-         set_slice(f_mask, f_value, PORTF);
-      }
+         prepare<'F'>(value),
 #endif
 #ifdef PORTG
-      if (g_mask) {
-         set_slice(g_mask, g_value, PORTG);
-      }
+         prepare<'G'>(value),
 #endif
 #ifdef PORTH
-      if (h_mask) {
-         set_slice(h_mask, h_value, PORTH);
-      }
+         prepare<'H'>(value),
 #endif
 #ifdef PORTJ
-      if (j_mask) {
-         set_slice(j_mask, j_value, PORTJ);
+         prepare<'J'>(value),
+#endif
+      };
+      if constexpr (Atomic) {
+         uint8_t sreg{SREG};
+         cli();
+         write_all<true>(prepared);
+         SREG = sreg;
+      } else {
+         write_all<false>(prepared);
       }
+   }
+
+   template <bool InterruptsDisabled>
+   static void write_all(prepared_ports const & prepared) {
+#ifdef PORTA
+      write<'A', InterruptsDisabled>(prepared.a);
+#endif
+#ifdef PORTB
+      write<'B', InterruptsDisabled>(prepared.b);
+#endif
+#ifdef PORTC
+      write<'C', InterruptsDisabled>(prepared.c);
+#endif
+#ifdef PORTD
+      write<'D', InterruptsDisabled>(prepared.d);
+#endif
+#ifdef PORTE
+      write<'E', InterruptsDisabled>(prepared.e);
+#endif
+#ifdef PORTF
+      write<'F', InterruptsDisabled>(prepared.f);
+#endif
+#ifdef PORTG
+      write<'G', InterruptsDisabled>(prepared.g);
+#endif
+#ifdef PORTH
+      write<'H', InterruptsDisabled>(prepared.h);
+#endif
+#ifdef PORTJ
+      write<'J', InterruptsDisabled>(prepared.j);
 #endif
    }
 
-private:
-   void set_slice(uint8_t mask, uint8_t value, uint8_t volatile & data_reg) {
-      if (mask) {
-         data_reg = static_cast<uint8_t>(data_reg & ~mask) | value;
+   /*! Returns the bits of PINx to write to apply the word value to the port, or the new value for the bits of
+   PORTx if the port can’t toggle them via PINx. */
+   template <char Port>
+   static uint8_t prepare(word_type value) {
+      if constexpr (port_map<Port>::mask == 0) {
+         return 0;
+      } else {
+         typedef hw::io_port<Port> io_port_;
+         auto port_bits{port_map<Port>::map(value)};
+         if constexpr (io_port_::pins_toggle_data) {
+            return static_cast<uint8_t>((io_port_::data ^ port_bits) & port_map<Port>::mask);
+         } else {
+            return port_bits;
+         }
+      }
+   }
+
+   //! Applies to the port the value returned by prepare().
+   template <char Port, bool InterruptsDisabled>
+   static void write(uint8_t prepared) {
+      if constexpr (port_map<Port>::mask != 0) {
+         typedef hw::io_port<Port> io_port_;
+         constexpr auto mask{port_map<Port>::mask};
+         if constexpr (io_port_::pins_toggle_data) {
+            io_port_::pins = prepared;
+         } else if constexpr (InterruptsDisabled) {
+            io_port_::data = static_cast<uint8_t>((io_port_::data & ~mask) | prepared);
+         } else {
+            uint8_t sreg{SREG};
+            cli();
+            io_port_::data = static_cast<uint8_t>((io_port_::data & ~mask) | prepared);
+            SREG = sreg;
+         }
       }
    }
 };
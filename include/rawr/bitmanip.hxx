@@ -14,6 +14,8 @@ more details.
 
 #pragma once
 
+#include <inttypes.h>
+
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 namespace rawr { namespace bitmanip {
@@ -41,4 +43,11 @@ inline constexpr void toggle(T * t, unsigned bit) {
    *t = static_cast<T>(*t ^ static_cast<T>(1 << bit));
 }
 
+//! Returns the byte with its bits in reverse order, i.e. bit 0 swapped with bit 7, and so on.
+inline constexpr uint8_t reverse(uint8_t byte) {
+   byte = static_cast<uint8_t>((byte >> 4) | (byte << 4));
+   byte = static_cast<uint8_t>(((byte & 0xcc) >> 2) | ((byte & 0x33) << 2));
+   return static_cast<uint8_t>(((byte & 0xaa) >> 1) | ((byte & 0x55) << 1));
+}
+
 }} //namespace rawr::bitmanip
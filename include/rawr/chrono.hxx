@@ -61,6 +61,8 @@ template <typename Int, Int Scale>
 class time_unit {
 public:
    typedef Int count_type;
+   //! Units in a second.
+   static constexpr count_type scale{Scale};
 
 public:
    explicit constexpr time_unit(count_type count__ = 0) :
@@ -127,8 +129,9 @@ private:
    count_type count_;
 };
 
-// The associated integer types are large enough to hold about 1 minute.
-typedef time_unit< uint8_t,          1> seconds;
+/* The associated integer types are large enough to hold about 1 minute, except for seconds, which can hold
+about 18 hours. */
+typedef time_unit<uint16_t,          1> seconds;
 typedef time_unit<uint16_t,       1000> milliseconds;
 typedef time_unit<uint32_t,    1000000> microseconds;
 typedef time_unit<uint64_t, 1000000000> nanoseconds;
@@ -154,6 +157,14 @@ inline constexpr uint64_t int_round_div(uint64_t dividend, chrono::hertz divisor
 
 } //namespace rawr
 
+constexpr rawr::chrono::hertz operator""_Hz(unsigned long long hz) {
+   return rawr::chrono::hertz(hz);
+}
+
+constexpr rawr::chrono::hertz operator""_kHz(unsigned long long khz) {
+   return rawr::chrono::hertz(khz * 1000);
+}
+
 constexpr rawr::chrono::seconds operator""_s(unsigned long long s) {
    return rawr::chrono::seconds(static_cast<rawr::chrono::seconds::count_type>(s));
 }
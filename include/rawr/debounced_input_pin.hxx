@@ -0,0 +1,202 @@
+/* -*- coding: utf-8; mode: c++; tab-width: 3; indent-tabs-mode: nil -*-
+
+Copyright 2022 Raffaello D. Di Napoli
+
+This file is part of RAWR.
+
+RAWR is free software: you can redistribute it and/or modify it under the terms of version 2.1 of the GNU
+Lesser General Public License as published by the Free Software Foundation.
+
+RAWR is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for
+more details.
+------------------------------------------------------------------------------------------------------------*/
+
+#pragma once
+
+#include <rawr/bitmanip.hxx>
+#include <rawr/chrono.hxx>
+#include <rawr/function.hxx>
+#include <rawr/hw/io_port.hxx>
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace rawr { namespace _pvt {
+
+//! Entry of debounced_input_port_base::per_pin_data; see binary_input_pin_data.
+struct debounced_input_pin_data {
+   //! Invokes the pin’s changed callback; pin_data is the debounced_input_pin_data itself.
+   void (* dispatch)(void * pin_data, uint8_t value);
+};
+
+/*! Debounced state of the pins of an I/O port, shared by rawr::debounced_input_port (which updates it) and
+rawr::debounced_input_pin (which reads it).
+
+Each pin is filtered by a 2-bit counter, stored “vertically”: bit n of count_lo and count_hi make up the
+counter for pin n, so that a few bitwise operations update the counters for all pins at once. A pin’s counter
+advances on every sample that differs from its debounced state, and is reset by any sample that doesn’t; when
+it wraps around, i.e. after stable_samples consecutive differing samples, the debounced state changes. */
+template <char Port>
+class debounced_input_port_base {
+private:
+   typedef hw::io_port<Port> io_port_;
+   static constexpr unsigned bit_size{io_port_::bit_size};
+
+public:
+   //! Number of consecutive samples a pin needs to hold a new value for, for it to be accepted.
+   static constexpr uint8_t stable_samples{4};
+
+protected:
+   //! Resets the filter for a pin, accepting its current value as debounced state.
+   static void set_state_bit(uint8_t bit) {
+      if ((io_port_::pins & _BV(bit)) != 0) {
+         bitmanip::set(&state, bit);
+      } else {
+         bitmanip::clear(&state, bit);
+      }
+      bitmanip::clear(&count_lo, bit);
+      bitmanip::clear(&count_hi, bit);
+   }
+
+   //! Samples all pins of the port and updates their counters; invoked periodically by timer_mux.
+   static void sample() {
+      auto changed{static_cast<uint8_t>(io_port_::pins ^ state)};
+      count_hi = static_cast<uint8_t>((count_hi ^ count_lo) & changed);
+      count_lo = static_cast<uint8_t>(~count_lo & changed);
+      auto toggled{static_cast<uint8_t>(changed & ~(count_lo | count_hi))};
+      if (toggled != 0) {
+         state ^= toggled;
+         dispatch(toggled);
+      }
+   }
+
+private:
+   //! Invokes the changed callback for each pin whose debounced state just changed.
+   static void dispatch(uint8_t toggled) {
+      for (uint8_t i = 0; toggled != 0; ++i, toggled = static_cast<uint8_t>(toggled >> 1)) {
+         if ((toggled & 1) == 0) {
+            continue;
+         }
+         // Only set for pins with a changed callback.
+         auto pin_data{per_pin_data[i]};
+         if (pin_data) {
+            pin_data->dispatch(pin_data, (state & _BV(i)) != 0);
+         }
+      }
+   }
+
+protected:
+   static debounced_input_pin_data * per_pin_data[bit_size];
+   //! Debounced value of each pin.
+   static uint8_t state;
+   //! Low bit-plane of the per-pin counters.
+   static uint8_t count_lo;
+   //! High bit-plane of the per-pin counters.
+   static uint8_t count_hi;
+};
+
+template <char Port>
+debounced_input_pin_data * debounced_input_port_base<Port>::per_pin_data[bit_size];
+
+template <char Port>
+uint8_t debounced_input_port_base<Port>::state;
+
+template <char Port>
+uint8_t debounced_input_port_base<Port>::count_lo;
+
+template <char Port>
+uint8_t debounced_input_port_base<Port>::count_hi;
+
+}} //namespace rawr::_pvt
+
+namespace rawr {
+
+/*! Periodically samples all the pins of an I/O port using a rawr::timer_mux delay, filtering out contact
+bounce for all of them at once. Callbacks for rawr::debounced_input_pin instances on the port are only invoked
+when their debounced state changes, so a bouncing contact causes a single callback after it settles, without
+any pin change interrupts.
+
+The time it takes for a change to be accepted is between stable_samples - 1 and stable_samples times period;
+with the default 5 ms period, that’s 15-20 ms. */
+template <char Port>
+class debounced_input_port : public _pvt::debounced_input_port_base<Port> {
+private:
+   typedef _pvt::debounced_input_port_base<Port> debounced_input_port_base_;
+   typedef hw::io_port<Port> io_port_;
+
+public:
+   template <typename TimerMux>
+   explicit debounced_input_port(TimerMux & timer_mux, chrono::milliseconds period = 5_ms) {
+      debounced_input_port_base_::state = io_port_::pins;
+      // Pass an l-value, so that this works with any callback type of timer_mux.
+      timer_mux.repeat(period, sampler);
+   }
+
+   //! Returns the debounced value of all the pins on the port.
+   uint8_t value() const {
+      return debounced_input_port_base_::state;
+   }
+
+private:
+   struct sampler_t {
+      void operator()() const {
+         debounced_input_port_base_::sample();
+      }
+   };
+
+   static constexpr sampler_t sampler{};
+};
+
+/*! Configures an I/O port’s pin as input, reporting changes after filtering them through the port’s
+rawr::debounced_input_port, which must be instantiated separately. Callback is the type the callback is stored
+as, like for rawr::binary_input_pin. */
+template <char Port, uint8_t Bit, typename Callback = function<void (bool)>>
+class debounced_input_pin :
+   public _pvt::debounced_input_port_base<Port>, protected _pvt::debounced_input_pin_data {
+private:
+   typedef _pvt::debounced_input_port_base<Port> debounced_input_port_base_;
+   typedef hw::io_port<Port> io_port_;
+
+public:
+   //! Configures the pin as input, without activating internal pull-up or pull-down.
+   debounced_input_pin() :
+      _pvt::debounced_input_pin_data{&dispatch} {
+      io_port_::data_direction.clear_bit(Bit);
+      debounced_input_port_base_::set_state_bit(Bit);
+   }
+
+   //! Configures the pin as input, activating internal pull-up or pull-down.
+   debounced_input_pin(bool pullup) :
+      _pvt::debounced_input_pin_data{&dispatch} {
+      io_port_::data_direction.clear_bit(Bit);
+      if (pullup) {
+         io_port_::data.set_bit(Bit);
+      } else {
+         io_port_::data.clear_bit(Bit);
+      }
+      debounced_input_port_base_::set_state_bit(Bit);
+   }
+
+   template <typename F>
+   void set_callback(F && callback) {
+      changed_callback = forward<F>(callback);
+      debounced_input_port_base_::per_pin_data[Bit] = changed_callback ? this : nullptr;
+   }
+
+   //! Returns the debounced value of the pin.
+   bool value() const {
+      return (debounced_input_port_base_::state & _BV(Bit)) != 0;
+   }
+
+private:
+   //! Invoked by debounced_input_port_base::dispatch().
+   static void dispatch(void * pin_data, uint8_t value) {
+      static_cast<debounced_input_pin *>(static_cast<_pvt::debounced_input_pin_data *>(pin_data))
+         ->changed_callback(value != 0);
+   }
+
+private:
+   Callback changed_callback;
+};
+
+} //namespace rawr
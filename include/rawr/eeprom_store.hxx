@@ -0,0 +1,355 @@
+/* -*- coding: utf-8; mode: c++; tab-width: 3; indent-tabs-mode: nil -*-
+
+Copyright 2022 Raffaello D. Di Napoli
+
+This file is part of RAWR.
+
+RAWR is free software: you can redistribute it and/or modify it under the terms of version 2.1 of the GNU
+Lesser General Public License as published by the Free Software Foundation.
+
+RAWR is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for
+more details.
+------------------------------------------------------------------------------------------------------------*/
+
+#pragma once
+
+#include <rawr/alias.hxx>
+#include <rawr/hw/eeprom.hxx>
+#include <rawr/misc.hxx>
+#include <rawr/power_manager.hxx>
+#include <rawr/trace.hxx>
+#ifdef RAWR_HOST
+   #include <rawr/host.hxx>
+#else
+   #include <avr/interrupt.h>
+#endif
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace rawr { namespace _pvt {
+
+//! Tag type used to find, via ADL, the interrupt handler of the rawr::eeprom_store instantiated; see adc_tag.
+struct eeprom_tag {
+   friend void eeprom_ready_interrupt(eeprom_tag);
+};
+
+#if defined(EE_READY_vect)
+   #define _RAWR_EEPROM_READY_VECT EE_READY_vect
+#elif defined(EE_RDY_vect)
+   #define _RAWR_EEPROM_READY_VECT EE_RDY_vect
+#endif
+
+class eeprom_vector {
+private:
+   //! EEPROM ready interrupt vector. It has a weird name to work around g++’s name check.
+   static __attribute__((signal, used)) void __vector() {
+      RAWR_ALIAS(RAWR_TOSTRING(_RAWR_EEPROM_READY_VECT), "_ZN4rawr4_pvt13eeprom_vector8__vectorEv");
+      trace::isr_entry(trace::eeprom_source());
+      eeprom_ready_interrupt(eeprom_tag{});
+      trace::isr_exit(trace::eeprom_source());
+   }
+};
+
+#undef _RAWR_EEPROM_READY_VECT
+
+//! Reads a byte of EEPROM, which must not be being written. The CPU is halted for 4 cycles.
+inline uint8_t eeprom_read(uint16_t address) {
+   typedef hw::eeprom eeprom_;
+   eeprom_::address = address;
+   eeprom_::control.set_bit(eeprom_::read_enable_bit);
+#ifdef RAWR_HOST
+   // Writes to simulated registers don’t start reads or writes by themselves.
+   host::strobe_eeprom();
+#endif
+   return eeprom_::data;
+}
+
+/*! Starts erasing and writing a byte of EEPROM, which must not be being written already. Must be called with
+interrupts disabled, since EEPE must be set within 4 cycles of EEMPE. */
+inline void eeprom_write(uint16_t address, uint8_t value) {
+   typedef hw::eeprom eeprom_;
+   eeprom_::address = address;
+   eeprom_::data = value;
+   // Timed sequence: EEPE only starts the write while EEMPE is set.
+   eeprom_::control.set_bit(eeprom_::master_write_enable_bit);
+   eeprom_::control.set_bit(eeprom_::write_enable_bit);
+#ifdef RAWR_HOST
+   host::strobe_eeprom();
+#endif
+}
+
+//! Returns crc updated with byte, using CRC-8 with polynomial x^8 + x^2 + x + 1.
+inline uint8_t eeprom_crc8(uint8_t crc, uint8_t byte) {
+   crc = static_cast<uint8_t>(crc ^ byte);
+   for (uint8_t i = 0; i < 8; ++i) {
+      crc = static_cast<uint8_t>((crc & 0x80) != 0 ? (crc << 1) ^ 0x07 : crc << 1);
+   }
+   return crc;
+}
+
+/*! RAM cache and interrupt handler of rawr::eeprom_store. Each slot of the ring holds a copy of the record,
+followed by its CRC and by its sequence number; sequence numbers go from 0 to 0xfe, wrapping around, so that
+erased slots (0xff) are never valid. */
+template <typename Record, uint8_t Slots, uint16_t Address>
+class eeprom_store_base : private eeprom_vector {
+protected:
+   static_assert(__is_trivially_copyable(Record), "Record must be trivially copyable");
+   static_assert(sizeof(Record) <= 252, "Record must be at most 252 bytes");
+   static_assert(Slots >= 2 && Slots <= 254, "Slots must be 2 to 254");
+
+   //! Bytes of a slot: the record, its CRC and its sequence number.
+   static constexpr uint8_t slot_size{static_cast<uint8_t>(sizeof(Record) + 2)};
+
+   static_assert(
+      uint32_t{Address} + uint32_t{slot_size} * Slots <= hw::eeprom::size,
+      "the slots don’t fit in the EEPROM"
+   );
+
+   //! Value of position while no commit is in progress.
+   static constexpr uint8_t idle{0xff};
+
+private:
+   static constexpr uint8_t crc_offset{sizeof(Record)};
+   static constexpr uint8_t seq_offset{sizeof(Record) + 1};
+   static constexpr uint8_t last_seq{0xfe};
+
+   /*! Invoked by the interrupt vector. Being a friend, it’s declared in this namespace, where eeprom_tag
+   declared it too. */
+   friend void eeprom_ready_interrupt(eeprom_tag) {
+      ready();
+   }
+
+   /*! Writes the next byte of the commit in progress that differs from the slot’s current contents; once the
+   commit is complete, starts the next one if the cache changed meanwhile, or else disables the interrupt. */
+   static void ready() {
+      for (;;) {
+         if (position == slot_size) {
+            // The last write of the commit completed.
+            position = idle;
+         }
+         if (position == idle && !begin_commit()) {
+            hw::eeprom::control.clear_bit(hw::eeprom::ready_interrupt_enable_bit);
+            power_manager::require_io_clock(power_manager::eeprom_clock, false);
+            return;
+         }
+         uint8_t value;
+         if (position < sizeof(Record)) {
+            value = reinterpret_cast<uint8_t const *>(&staging)[position];
+         } else if (position == crc_offset) {
+            value = staging_crc;
+         } else {
+            // The sequence number goes last, making the slot the newest only once it’s complete.
+            value = staging_seq;
+            latest_slot = target_slot;
+            latest_seq = staging_seq;
+         }
+         auto address{static_cast<uint16_t>(slot_address(target_slot) + position)};
+         position = static_cast<uint8_t>(position + 1);
+         if (eeprom_read(address) != value) {
+            eeprom_write(address, value);
+            return;
+         }
+      }
+   }
+
+   /*! Copies the cache into the staging record if it differs from it, which holds the record last committed,
+   and prepares to write it to the slot after the newest; returns false if there’s nothing to commit. */
+   static bool begin_commit() {
+      if (!dirty) {
+         return false;
+      }
+      dirty = false;
+      auto src{reinterpret_cast<uint8_t const *>(&cache)};
+      auto dst{reinterpret_cast<uint8_t *>(&staging)};
+      bool changed{false};
+      for (uint8_t i = 0; i < sizeof(Record); ++i) {
+         if (dst[i] != src[i]) {
+            dst[i] = src[i];
+            changed = true;
+         }
+      }
+      if (!changed) {
+         return false;
+      }
+      target_slot = latest_slot + 1u == Slots ? 0 : static_cast<uint8_t>(latest_slot + 1);
+      staging_seq = latest_seq == last_seq ? 0 : static_cast<uint8_t>(latest_seq + 1);
+      uint8_t crc{eeprom_crc8(crc_init, staging_seq)};
+      for (uint8_t i = 0; i < sizeof(Record); ++i) {
+         crc = eeprom_crc8(crc, dst[i]);
+      }
+      staging_crc = crc;
+      position = 0;
+      return true;
+   }
+
+   static uint16_t slot_address(uint8_t slot) {
+      return static_cast<uint16_t>(Address + uint16_t{slot_size} * slot);
+   }
+
+   /*! Reads a slot into the cache, returning true if it holds a valid record, in which case it also becomes
+   the newest. */
+   static bool load(uint8_t slot) {
+      auto address{slot_address(slot)};
+      uint8_t seq{eeprom_read(static_cast<uint16_t>(address + seq_offset))};
+      if (seq > last_seq) {
+         return false;
+      }
+      uint8_t crc{eeprom_crc8(crc_init, seq)};
+      auto dst{reinterpret_cast<uint8_t *>(&cache)};
+      for (uint8_t i = 0; i < sizeof(Record); ++i) {
+         dst[i] = eeprom_read(static_cast<uint16_t>(address + i));
+         crc = eeprom_crc8(crc, dst[i]);
+      }
+      if (crc != eeprom_read(static_cast<uint16_t>(address + crc_offset))) {
+         return false;
+      }
+      latest_slot = slot;
+      latest_seq = seq;
+      return true;
+   }
+
+protected:
+   /*! Loads the newest valid record into the cache, or defaults if there’s none. Only the sequence numbers
+   are read from every slot: slots are written in ring order, so the newest is the last one of the run of
+   consecutive sequence numbers starting from slot 0. If the last commit was interrupted, e.g. by a power
+   loss, the newest slot fails its CRC and the one before is used. */
+   static void recover(Record const & defaults) {
+      uint8_t newest{0};
+      uint8_t seq{eeprom_read(static_cast<uint16_t>(Address + seq_offset))};
+      for (uint8_t slot = 1; slot < Slots; ++slot) {
+         uint8_t next_seq{eeprom_read(static_cast<uint16_t>(slot_address(slot) + seq_offset))};
+         if (next_seq != (seq == last_seq ? 0 : seq + 1)) {
+            break;
+         }
+         seq = next_seq;
+         newest = slot;
+      }
+      for (uint8_t i = 0; i < Slots; ++i) {
+         if (load(newest)) {
+            staging = cache;
+            return;
+         }
+         newest = newest == 0 ? static_cast<uint8_t>(Slots - 1) : static_cast<uint8_t>(newest - 1);
+      }
+      cache = defaults;
+      staging = defaults;
+      // The first commit will go to slot 0, with sequence number 0.
+      latest_slot = Slots - 1;
+      latest_seq = last_seq;
+   }
+
+   //! Marks the cache as changed, starting a commit if none is in progress. Interrupts must be disabled.
+   static void schedule_commit() {
+      dirty = true;
+      power_manager::require_io_clock(power_manager::eeprom_clock, true);
+      // If no write is in progress, this raises the interrupt right away.
+      hw::eeprom::control.set_bit(hw::eeprom::ready_interrupt_enable_bit);
+   }
+
+protected:
+   //! Current value of the record; only written with interrupts disabled.
+   static inline Record cache;
+   //! Record being committed, or last committed; only accessed by the interrupt handler after recover().
+   static inline Record staging;
+   static inline uint8_t staging_crc;
+   static inline uint8_t staging_seq;
+   //! Slot being written by the commit in progress.
+   static inline uint8_t target_slot;
+   /*! Offset in target_slot of the next byte to commit, slot_size while its last byte is being written, or
+   idle. */
+   static inline uint8_t volatile position{idle};
+   //! Slot holding the newest record.
+   static inline uint8_t latest_slot;
+   static inline uint8_t latest_seq;
+   //! Set if cache changed since it was last copied into staging.
+   static inline bool volatile dirty;
+
+private:
+   //! Initial CRC value; using the record size makes slots written with a different layout invalid.
+   static constexpr uint8_t crc_init{static_cast<uint8_t>(sizeof(Record))};
+};
+
+}} //namespace rawr::_pvt
+
+namespace rawr {
+
+/*! Persistent record stored in the data EEPROM, e.g. settings. Reads are served from a copy in RAM, loaded
+when the store is constructed; writes update that copy, and are committed to the EEPROM asynchronously by the
+EEPROM ready interrupt handler, one byte per interrupt, instead of blocking for 3.4 ms per byte like
+avr-libc’s eeprom_write_*() functions:
+
+   struct settings {
+      uint8_t brightness;
+      uint16_t blink_period_ms;
+   };
+   rawr::eeprom_store<settings, 8> store{settings{128, 500}};
+   led.set_brightness(store.get().brightness);
+   store.set(&settings::brightness, 200);
+
+Writes made while a commit is in progress are coalesced into the next commit, so changing a field many times
+in a row, e.g. while a knob is turned, results in one commit at a time with the latest values, instead of one
+per change; a commit that would leave the record unchanged is skipped altogether.
+
+For wear leveling, each commit goes to the next of Slots slots (Record plus 2 bytes each) starting at
+Address, in a ring, and only writes bytes that differ from the slot’s old contents, so each byte of EEPROM is
+written at most once every Slots commits; its endurance is about 100,000 writes. The constructor finds the
+newest slot reading only the sequence numbers, then loads it after checking its CRC; a commit interrupted by a
+power loss or reset leaves the previous record intact, and is recovered as such. If no slot holds a valid
+record, e.g. on first boot or after Record changed size, the defaults passed to the constructor are used.
+
+While committing, the store needs the EEPROM ready interrupt to wake up the CPU, so rawr::power_manager only
+lets it enter idle mode. Only one eeprom_store can exist, since the EEPROM ready interrupt can’t be shared. */
+template <typename Record, uint8_t Slots = 4, uint16_t Address = 0>
+class eeprom_store : public _pvt::eeprom_store_base<Record, Slots, Address> {
+private:
+   typedef _pvt::eeprom_store_base<Record, Slots, Address> eeprom_store_base_;
+   typedef hw::eeprom eeprom_;
+
+public:
+   //! Loads the newest record from the EEPROM, or defaults if none is valid.
+   explicit eeprom_store(Record const & defaults = Record{}) {
+      // A write started before a reset completes anyway, and reads must wait for it.
+      while ((eeprom_::control & _BV(eeprom_::write_enable_bit)) != 0) {
+      }
+      // Atomic erase and write, no interrupt.
+      eeprom_::control = 0;
+      eeprom_store_base_::recover(defaults);
+   }
+
+   //! Returns the current value of the record, including changes not committed yet.
+   Record const & get() const {
+      return eeprom_store_base_::cache;
+   }
+
+   //! Changes a field of the record, scheduling a commit. Safe to call with interrupts enabled.
+   template <typename T>
+   void set(T Record::* field, typename identity<T>::type const & value) {
+      update([field, &value] (Record & record) {
+         record.*field = value;
+      });
+   }
+
+   /*! Invokes fn with the record, to change it, then schedules a commit. fn is invoked with interrupts
+   disabled, so that changes to multiple fields are committed together. */
+   template <typename F>
+   void update(F && fn) {
+      uint8_t sreg{SREG};
+      cli();
+      fn(eeprom_store_base_::cache);
+      eeprom_store_base_::schedule_commit();
+      SREG = sreg;
+#ifdef RAWR_HOST
+      // Writes to simulated registers don’t raise interrupts by themselves.
+      host::dispatch_interrupts();
+#endif
+   }
+
+   /*! Returns true while changes are waiting to be committed, or being committed; a power loss meanwhile
+   makes the next boot load the previous record. */
+   bool pending() const {
+      return eeprom_store_base_::dirty || eeprom_store_base_::position != eeprom_store_base_::idle;
+   }
+};
+
+} //namespace rawr
@@ -0,0 +1,137 @@
+/* -*- coding: utf-8; mode: c++; tab-width: 3; indent-tabs-mode: nil -*-
+
+Copyright 2022 Raffaello D. Di Napoli
+
+This file is part of RAWR.
+
+RAWR is free software: you can redistribute it and/or modify it under the terms of version 2.1 of the GNU
+Lesser General Public License as published by the Free Software Foundation.
+
+RAWR is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for
+more details.
+------------------------------------------------------------------------------------------------------------*/
+
+#pragma once
+
+#include <rawr/abort.hxx>
+#include <rawr/hw/io.hxx>
+#ifdef RAWR_POWER_MANAGEMENT
+   #include <rawr/power_manager.hxx>
+#endif
+#ifdef RAWR_HOST
+   #include <rawr/host.hxx>
+#else
+   #include <avr/interrupt.h>
+   #include <avr/sleep.h>
+#endif
+
+/*! Maximum number of events that can be waiting for rawr::event_loop to dispatch them; exceeding it results
+in abort(). */
+#ifndef RAWR_EVENT_LOOP_QUEUE_SIZE
+   #define RAWR_EVENT_LOOP_QUEUE_SIZE 8
+#endif
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace rawr {
+
+/*! Queue of events posted by interrupt handlers, to be dispatched from the main loop with interrupts enabled.
+This keeps interrupt handlers short, so they don’t delay each other.
+
+Each event is a plain function pointer plus its arguments, so that posting one doesn’t involve copying a
+rawr::function.
+
+Defining RAWR_DEFERRED_CALLBACKS before including any rawr header makes rawr::timer_mux and
+rawr::binary_input_pin post their callbacks here, instead of invoking them from their interrupt handlers. */
+class event_loop {
+public:
+   //! Type of the functions invoked to dispatch events.
+   typedef void (* handler_t)(void * context, uint8_t arg);
+
+public:
+   /*! Adds an event to the queue. Must be called with interrupts disabled, which is the case in interrupt
+   handlers. */
+   static void post(handler_t handler, void * context, uint8_t arg) {
+      if (size == RAWR_EVENT_LOOP_QUEUE_SIZE) {
+         abort(abort_reason::event_loop_full);
+      }
+      auto tail{static_cast<uint8_t>(first + size)};
+      if (tail >= RAWR_EVENT_LOOP_QUEUE_SIZE) {
+         tail = static_cast<uint8_t>(tail - RAWR_EVENT_LOOP_QUEUE_SIZE);
+      }
+      auto & event = events[tail];
+      event.handler = handler;
+      event.context = context;
+      event.arg = arg;
+      size = static_cast<uint8_t>(size + 1);
+   }
+
+   /*! Dispatches the first event in the queue, if any. Must be called with interrupts enabled, and returns
+   with interrupts enabled.
+
+   @return
+      true if an event was dispatched, or false if the queue was empty.
+   */
+   static bool run_one() {
+      cli();
+      if (size == 0) {
+         sei();
+         return false;
+      }
+      // Copy the event, so that its slot can be reused right away.
+      auto event{events[first]};
+      if (++first == RAWR_EVENT_LOOP_QUEUE_SIZE) {
+         first = 0;
+      }
+      size = static_cast<uint8_t>(size - 1);
+      sei();
+      event.handler(event.context, event.arg);
+      return true;
+   }
+
+   //! Dispatches events until the queue is empty.
+   static void run_until_idle() {
+      while (run_one()) {
+      }
+   }
+
+   /*! Dispatches events forever, putting the CPU to sleep whenever the queue is empty. Enables interrupts if
+   they weren’t already. If RAWR_POWER_MANAGEMENT is defined, rawr::power_manager selects the sleep mode. */
+   [[noreturn]] static void run() {
+      sei();
+      for (;;) {
+         run_until_idle();
+         cli();
+         if (size == 0) {
+#ifdef RAWR_POWER_MANAGEMENT
+            power_manager::sleep();
+#else
+            sleep_enable();
+            /* The instruction following sei is guaranteed to execute before any interrupt, so an event posted
+            after the check above will wake the CPU up instead of being missed. */
+            sei();
+            sleep_cpu();
+            sleep_disable();
+#endif
+         } else {
+            sei();
+         }
+      }
+   }
+
+private:
+   struct event {
+      handler_t handler;
+      void * context;
+      uint8_t arg;
+   };
+
+   static inline event events[RAWR_EVENT_LOOP_QUEUE_SIZE];
+   //! Index of the first event in the queue.
+   static inline uint8_t first;
+   //! Count of events in the queue.
+   static inline uint8_t volatile size;
+};
+
+} //namespace rawr
@@ -0,0 +1,182 @@
+/* -*- coding: utf-8; mode: c++; tab-width: 3; indent-tabs-mode: nil -*-
+
+Copyright 2022 Raffaello D. Di Napoli
+
+This file is part of RAWR.
+
+RAWR is free software: you can redistribute it and/or modify it under the terms of version 2.1 of the GNU
+Lesser General Public License as published by the Free Software Foundation.
+
+RAWR is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for
+more details.
+------------------------------------------------------------------------------------------------------------*/
+
+#pragma once
+
+#include <rawr/misc.hxx>
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace rawr { namespace _pvt {
+
+//! Defines a member named type as the narrowest of uint16_t and uint32_t having at least Bits bits.
+template <unsigned Bits, typename = void>
+struct filter_accumulator {
+   static_assert(Bits <= 32, "filter parameters need more than 32 bits");
+
+   typedef uint32_t type;
+};
+
+template <unsigned Bits>
+struct filter_accumulator<Bits, typename enable_if<(Bits <= 16)>::type> {
+   typedef uint16_t type;
+};
+
+}} //namespace rawr::_pvt
+
+namespace rawr {
+
+/*! Decimation filter: sums each group of Factor consecutive samples, a power of 2, and outputs the sum
+shifted right by Shift, so that the output rate is 1/Factor of the input rate.
+
+With the default Shift of log2(Factor) the output is the average of the group, with the same resolution as
+the samples; a lower Shift keeps some of the resolution gained by oversampling, which adds one bit for every
+4 samples as long as the input has at least 1 LSB of noise:
+
+   // 10-bit samples in, 12-bit values out at 1/16 of the sample rate.
+   rawr::decimator<16, 2> decimator;
+   if (decimator.push(sample)) {
+      use(decimator.value());
+   }
+
+SampleBits is the width of the input samples, which selects at compile time the narrowest accumulator. */
+template <uint8_t Factor, uint8_t Shift = int_log2(Factor), uint8_t SampleBits = 10>
+class decimator {
+public:
+   static_assert(Factor >= 2 && (Factor & (Factor - 1)) == 0, "Factor must be a power of 2");
+   static_assert(Shift <= int_log2(Factor), "Shift must be at most log2(Factor)");
+
+   //! Width of the output values.
+   static constexpr uint8_t output_bits{SampleBits + int_log2(Factor) - Shift};
+
+   static_assert(output_bits <= 16, "output values would not fit in 16 bits; increase Shift");
+
+private:
+   typedef typename _pvt::filter_accumulator<SampleBits + int_log2(Factor)>::type accumulator_t;
+
+public:
+   constexpr decimator() :
+      sum{0},
+      count{0},
+      output{0} {
+   }
+
+   /*! Adds a sample; returns true if that completed a group, in which case value() returns the group’s
+   result. */
+   bool push(uint16_t sample) {
+      sum = static_cast<accumulator_t>(sum + sample);
+      if (++count < Factor) {
+         return false;
+      }
+      output = static_cast<uint16_t>(sum >> Shift);
+      sum = 0;
+      count = 0;
+      return true;
+   }
+
+   //! Returns the result of the last complete group.
+   uint16_t value() const {
+      return output;
+   }
+
+private:
+   accumulator_t sum;
+   //! Samples in sum.
+   uint8_t count;
+   uint16_t output;
+};
+
+/*! Moving average of the last Length samples, a power of 2. Each push() takes a subtraction and an addition
+to a running sum, and a shift, regardless of Length; the last Length samples are kept, taking 2 × Length
+bytes.
+
+Until Length samples have been pushed, the average includes the initial value passed to the constructor. */
+template <uint8_t Length, uint8_t SampleBits = 10>
+class moving_average {
+public:
+   static_assert(Length >= 2 && Length <= 128 && (Length & (Length - 1)) == 0, "Length must be a power of 2");
+
+private:
+   typedef typename _pvt::filter_accumulator<SampleBits + int_log2(Length)>::type accumulator_t;
+
+public:
+   explicit constexpr moving_average(uint16_t initial = 0) :
+      samples{},
+      sum{static_cast<accumulator_t>(accumulator_t{initial} * Length)},
+      next{0} {
+      for (auto & sample : samples) {
+         sample = initial;
+      }
+   }
+
+   //! Replaces the oldest sample with sample, returning the updated average.
+   uint16_t push(uint16_t sample) {
+      sum = static_cast<accumulator_t>(sum - samples[next] + sample);
+      samples[next] = sample;
+      next = static_cast<uint8_t>((next + 1) & (Length - 1));
+      return value();
+   }
+
+   //! Returns the average of the last Length samples, rounded to nearest.
+   uint16_t value() const {
+      return static_cast<uint16_t>((sum + Length / 2) >> int_log2(Length));
+   }
+
+private:
+   uint16_t samples[Length];
+   //! Sum of samples.
+   accumulator_t sum;
+   //! Index of the oldest sample, to be replaced next.
+   uint8_t next;
+};
+
+/*! First-order IIR low-pass filter, i.e. an exponential moving average: each push() moves the output by
+1/2^Shift of its distance from the sample, giving a time constant of about 2^Shift samples, in just a couple
+of 16-bit shifts and additions.
+
+The state is kept in fixed point with FractionBits fractional bits, which by default are all those left by
+SampleBits in 16 bits; since 1/2^Shift of the distance from each sample is truncated, the output settles
+within 2^(Shift - FractionBits) LSBs of a constant input, so Shift can’t exceed FractionBits. For longer time
+constants, feed the filter through a decimator. */
+template <uint8_t Shift, uint8_t SampleBits = 10, uint8_t FractionBits = 16 - SampleBits>
+class iir_filter {
+public:
+   static_assert(Shift >= 1 && Shift <= FractionBits, "Shift must be 1 to FractionBits");
+   static_assert(SampleBits + FractionBits <= 16, "the state must fit in 16 bits");
+
+public:
+   explicit constexpr iir_filter(uint16_t initial = 0) :
+      state{static_cast<uint16_t>(initial << FractionBits)} {
+   }
+
+   //! Adds a sample, returning the updated output.
+   uint16_t push(uint16_t sample) {
+      // state += (sample − state) / 2^Shift, without needing a signed 17-bit difference.
+      state = static_cast<uint16_t>(
+         state - (state >> Shift) + (static_cast<uint16_t>(sample << FractionBits) >> Shift)
+      );
+      return value();
+   }
+
+   //! Returns the output, rounded to nearest.
+   uint16_t value() const {
+      return static_cast<uint16_t>((state + (1u << (FractionBits - 1))) >> FractionBits);
+   }
+
+private:
+   //! Output, with FractionBits fractional bits.
+   uint16_t state;
+};
+
+} //namespace rawr
@@ -22,8 +22,10 @@ more details.
 namespace rawr {
 
 #ifndef RAWR_FUNCTION_DEFAULT_MAX_LAMBDA_SIZE
-   // This may be overridden, at the cost of enlarging sizeof(rawr::function) for the entire binary.
-   #define RAWR_FUNCTION_DEFAULT_MAX_LAMBDA_SIZE 6
+   /* This may be overridden, at the cost of enlarging sizeof(rawr::function) for the entire binary. Room for
+   the vtable pointer and two captured pointers, i.e. 6 bytes on AVR, and enough for the same lambdas in host
+   builds. */
+   #define RAWR_FUNCTION_DEFAULT_MAX_LAMBDA_SIZE (3 * sizeof(void *))
 #endif
 
 // Equivalent to std::function.
@@ -123,11 +125,16 @@ public:
       }
    }
 
-   template <typename L>
+   template <
+      typename L,
+      typename LT = typename remove_cv<typename remove_reference<L>::type>::type,
+      typename = typename enable_if<!__is_same(LT, function)>::type
+   >
    /*implicit*/ constexpr function(L && lambda) :
       set{true} {
-      static_assert(sizeof(lambda_impl<L>) <= sizeof impl_storage, "cannot use lambdas of size > sizeof impl_storage - vtable cost");
-      new(impl_storage) lambda_impl<L>{forward<L>(lambda)};
+      // LT rather than L, so that l-value lambdas get copied instead of referenced.
+      static_assert(sizeof(lambda_impl<LT>) <= sizeof impl_storage, "cannot use lambdas of size > sizeof impl_storage - vtable cost");
+      new(impl_storage) lambda_impl<LT>{forward<L>(lambda)};
    }
 
    ~function() {
@@ -199,7 +206,8 @@ private:
 
 private:
    bool set;
-   uint8_t impl_storage[RAWR_FUNCTION_DEFAULT_MAX_LAMBDA_SIZE];
+   //! Holds a lambda_impl, aligned for its vtable pointer; on AVR this is 1, so it costs nothing.
+   alignas(__BIGGEST_ALIGNMENT__) uint8_t impl_storage[RAWR_FUNCTION_DEFAULT_MAX_LAMBDA_SIZE];
 };
 
 /*template <typename L>
@@ -0,0 +1,91 @@
+/* -*- coding: utf-8; mode: c++; tab-width: 3; indent-tabs-mode: nil -*-
+
+Copyright 2022 Raffaello D. Di Napoli
+
+This file is part of RAWR.
+
+RAWR is free software: you can redistribute it and/or modify it under the terms of version 2.1 of the GNU
+Lesser General Public License as published by the Free Software Foundation.
+
+RAWR is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for
+more details.
+------------------------------------------------------------------------------------------------------------*/
+
+#pragma once
+
+#include <rawr/misc.hxx>
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace rawr {
+
+/*! Non-owning reference to a callable object, such as a lambda: just a pointer to the object and one to an
+invoker function, regardless of what the lambda captures.
+
+The referenced object must outlive the function_ref, and every copy made of it. To make that harder to get
+wrong, function_refs can only be constructed from l-values, i.e. named lambdas:
+
+   auto on_tick{[&] () { led.toggle(); }};
+   timer_mux.repeat(250_ms, on_tick);
+
+This is the cheapest option for callbacks invoked before the call that receives them returns, and for
+callbacks referencing objects that are never destructed, such as locals of a uc_main() that never returns. */
+template <typename F>
+class function_ref;
+
+template <typename Ret, typename... Args>
+class function_ref<Ret (Args...)> {
+private:
+   typedef Ret (* invoker_t)(void const * object, Args... args);
+
+   template <typename L>
+   static Ret invoke(void const * object, Args... args) {
+      return (*static_cast<L const *>(object))(args...);
+   }
+
+public:
+   constexpr function_ref() :
+      object{nullptr},
+      invoker{nullptr} {
+   }
+
+   constexpr function_ref(decltype(nullptr)) :
+      function_ref{} {
+   }
+
+   template <
+      typename L,
+      typename LT = typename remove_cv<typename remove_reference<L>::type>::type,
+      typename = typename enable_if<!__is_same(LT, function_ref)>::type
+   >
+   /*implicit*/ constexpr function_ref(L && callable) :
+      object{&callable},
+      invoker{&invoke<LT>} {
+      static_assert(is_lvalue_reference<L>::value, "function_ref cannot reference a temporary object");
+   }
+
+   explicit constexpr operator bool() const {
+      return invoker != nullptr;
+   }
+
+   constexpr bool operator==(decltype(nullptr)) const {
+      return invoker == nullptr;
+   }
+
+   constexpr bool operator!=(decltype(nullptr)) const {
+      return invoker != nullptr;
+   }
+
+   Ret operator()(Args... args) const {
+      return invoker(object, args...);
+   }
+
+private:
+   //! Referenced object.
+   void const * object;
+   //! Calls *object; nullptr if *this is empty.
+   invoker_t invoker;
+};
+
+} //namespace rawr
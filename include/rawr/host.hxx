@@ -0,0 +1,1103 @@
+/* -*- coding: utf-8; mode: c++; tab-width: 3; indent-tabs-mode: nil -*-
+
+Copyright 2022 Raffaello D. Di Napoli
+
+This file is part of RAWR.
+
+RAWR is free software: you can redistribute it and/or modify it under the terms of version 2.1 of the GNU
+Lesser General Public License as published by the Free Software Foundation.
+
+RAWR is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for
+more details.
+------------------------------------------------------------------------------------------------------------*/
+
+/*! @file
+Host-native backend, enabled by defining RAWR_HOST.
+
+Allows to build RAWR code for the machine running the build (see `make host/path/to/file_name`), to test,
+fuzz or profile it at native speed. Every rawr::hw::io_mem_reg is backed by rawr::host::register_file instead
+of I/O memory, and this file simulates just enough of the MCU for the code on top of the registers to run:
+
+•  A virtual clock, advanced explicitly by the test code, drives the timer/counters according to their
+   prescaler, waveform generation mode and compare registers, setting their interrupt flags;
+•  Pin values can be set from the test code, which sets pin change interrupt flags;
+•  USARTs transmit instantly: their data register is always empty, and each byte written to it by the Data
+   Register Empty interrupt handler is passed to usart_transmit_handler; bytes can be received from the test
+   code with receive();
+•  ADC conversions, started via ADSC or auto-triggered in free running mode or by timer/counter compare
+   matches, take 13 (the first one 25) cycles of the ADC clock, and read their result from adc_input;
+•  EEPROM reads complete instantly, and writes in 3.4 ms, after which the EEPROM ready interrupt occurs;
+   their effects are visible in rawr::host::eeprom. Since writes to simulated registers have no side effects,
+   code setting EERE or EEPE must then invoke strobe_eeprom();
+•  The watchdog timer, in interrupt mode, sets its interrupt flag every period of the nominal 128 kHz
+   watchdog oscillator, as selected by its prescaler; wdt_reset() restarts the period;
+•  Enabled interrupts are serviced as soon as their flag is set while interrupts are globally enabled, by
+   invoking the vector (__vector_N) the program defined for them;
+•  sei(), cli(), sleep_cpu() and other avr-libc macros that would otherwise expand to AVR instructions are
+   replaced by functions operating on the simulated registers; sleep_cpu() advances the virtual clock until an
+   interrupt occurs.
+
+For example:
+
+   rawr::timer_mux<0> timer_mux;
+   unsigned calls{0};
+   timer_mux.repeat(10_ms, [&calls] () { ++calls; });
+   sei();
+   rawr::host::advance(1_s);
+   // calls is now about 100, depending on how 10 ms round to timer ticks at F_CPU.
+
+Interrupt vectors can also be invoked directly, e.g. rawr::host::interrupt(TIMER0_COMPA_vect).
+
+Not simulated: phase correct PWM modes (they count like fast PWM), external clock sources, writes to PINx
+toggling PORTx (unless RAWR_HOST_PINS_TOGGLE_DATA is defined, which also makes hw::io_port::pins_toggle_data
+true), writes of 1 clearing interrupt flags, pins configured as output reading back their PORTx bit, and the
+watchdog timer resetting the device: it only expires in interrupt mode. Sleep modes are not simulated either:
+timers keep counting while the CPU sleeps. */
+
+#pragma once
+
+#ifndef RAWR_HOST
+   #error "rawr/host.hxx can only be used in host builds; define RAWR_HOST to enable them"
+#endif
+
+#include <rawr/chrono.hxx>
+#include <rawr/hw/adc.hxx>
+#include <rawr/hw/eeprom.hxx>
+#include <rawr/hw/io.hxx>
+#include <rawr/hw/io_port.hxx>
+#include <rawr/hw/timer_counter.hxx>
+#include <rawr/hw/usart.hxx>
+#include <rawr/misc.hxx>
+#include <rawr/reset.hxx>
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/* Declare every interrupt vector a program might define, so that the simulation can refer to them via
+avr-libc’s names (e.g. TIMER0_COMPA_vect is __vector_14 on some MCUs). Being weak, those not defined by the
+program will just have a nullptr address. */
+#define _RAWR_HOST_DECLARE_VECTORS(decade) \
+   void __vector_ ## decade ## 0() __attribute__((weak)); \
+   void __vector_ ## decade ## 1() __attribute__((weak)); \
+   void __vector_ ## decade ## 2() __attribute__((weak)); \
+   void __vector_ ## decade ## 3() __attribute__((weak)); \
+   void __vector_ ## decade ## 4() __attribute__((weak)); \
+   void __vector_ ## decade ## 5() __attribute__((weak)); \
+   void __vector_ ## decade ## 6() __attribute__((weak)); \
+   void __vector_ ## decade ## 7() __attribute__((weak)); \
+   void __vector_ ## decade ## 8() __attribute__((weak)); \
+   void __vector_ ## decade ## 9() __attribute__((weak));
+extern "C" {
+   _RAWR_HOST_DECLARE_VECTORS()
+   _RAWR_HOST_DECLARE_VECTORS(1)
+   _RAWR_HOST_DECLARE_VECTORS(2)
+   _RAWR_HOST_DECLARE_VECTORS(3)
+   _RAWR_HOST_DECLARE_VECTORS(4)
+   _RAWR_HOST_DECLARE_VECTORS(5)
+   _RAWR_HOST_DECLARE_VECTORS(6)
+   _RAWR_HOST_DECLARE_VECTORS(7)
+}
+#undef _RAWR_HOST_DECLARE_VECTORS
+
+namespace rawr { namespace host { namespace _pvt {
+
+typedef void (* vector_t)();
+
+//! Returned as number of cycles or ticks to an event that will never happen.
+inline constexpr uint32_t never{~uint32_t{}};
+
+//! Elapsed time of the virtual clock, in CPU cycles.
+inline uint64_t elapsed_cycles;
+//! Count of interrupts serviced so far; allows to tell whether any was serviced during some operation.
+inline uint32_t serviced_interrupts;
+//! Value of serviced_interrupts when sleep_enable() was last invoked.
+inline uint32_t serviced_interrupts_at_sleep_enable;
+
+#ifdef SMCR
+   inline constexpr decltype(SMCR) sleep_control{};
+#else
+   inline constexpr decltype(MCUCR) sleep_control{};
+#endif
+
+}}} //namespace rawr::host::_pvt
+
+namespace rawr { namespace host {
+
+/*! Invokes an interrupt vector like the CPU does, i.e. with interrupts disabled. A vector not defined by the
+program (nullptr) resets the device, like an unexpected interrupt does. Unlike reti, this doesn’t enable
+interrupts on return if they were disabled before the call, so that test code can invoke vectors regardless of
+the state of the I bit. */
+inline void interrupt(void (* vector)()) {
+   if (!vector) {
+      reset();
+   }
+   bool enabled{(SREG & _BV(SREG_I)) != 0};
+   SREG.clear_bit(SREG_I);
+   ++_pvt::serviced_interrupts;
+   vector();
+   if (enabled) {
+      SREG.set_bit(SREG_I);
+   }
+}
+
+}} //namespace rawr::host
+
+namespace rawr { namespace host { namespace _pvt {
+
+/*! Clears an interrupt flag and returns true if both the flag and the corresponding interrupt enable bit are
+set; returns false otherwise. */
+template <typename Flags, typename Mask>
+inline bool take_flag(Flags flags, uint8_t flag_bit, Mask mask, uint8_t enable_bit) {
+   if ((flags & _BV(flag_bit)) != 0 && (mask & _BV(enable_bit)) != 0) {
+      flags.clear_bit(flag_bit);
+      return true;
+   }
+   return false;
+}
+
+//! Flag, enable bit and vector of the overflow interrupt of each timer/counter.
+template <int Index>
+struct timer_counter_overflow_source {
+   static constexpr bool present{false};
+};
+
+//! Flag, enable bit and vector of the compare match interrupt of each timer/counter comparator.
+template <int Index, char Comparator>
+struct timer_counter_comparator_source {
+   static constexpr bool present{false};
+};
+
+#define _RAWR_SPECIALIZE_TIMER_COUNTER_OVERFLOW_SOURCE(index, tifr, vect) \
+   template <> \
+   struct timer_counter_overflow_source<index> { \
+      static constexpr bool present{true}; \
+      static constexpr decltype(tifr) flags{}; \
+      static constexpr uint8_t flag_bit{RAWR_CPP_CAT2(TOV, index)}; \
+      static constexpr uint8_t enable_bit{RAWR_CPP_CAT2(TOIE, index)}; \
+      static constexpr vector_t vector{&vect}; \
+   };
+#define _RAWR_SPECIALIZE_TIMER_COUNTER_COMPARATOR_SOURCE(index, tifr, comparator, comp_unquoted, vect) \
+   template <> \
+   struct timer_counter_comparator_source<index, comparator> { \
+      static constexpr bool present{true}; \
+      static constexpr decltype(tifr) flags{}; \
+      static constexpr uint8_t flag_bit{RAWR_CPP_CAT3(OCF, index, comp_unquoted)}; \
+      static constexpr uint8_t enable_bit{RAWR_CPP_CAT3(OCIE, index, comp_unquoted)}; \
+      static constexpr vector_t vector{&vect}; \
+   };
+#ifdef TCNT0
+   #ifdef TIFR0
+      #define _RAWR_TIFR TIFR0
+   #else
+      #define _RAWR_TIFR TIFR
+   #endif
+   #ifdef TIMER0_OVF_vect
+      _RAWR_SPECIALIZE_TIMER_COUNTER_OVERFLOW_SOURCE(0, _RAWR_TIFR, TIMER0_OVF_vect)
+   #endif
+   #ifdef TIMER0_COMPA_vect
+      _RAWR_SPECIALIZE_TIMER_COUNTER_COMPARATOR_SOURCE(0, _RAWR_TIFR, 'A', A, TIMER0_COMPA_vect)
+   #endif
+   #ifdef TIMER0_COMPB_vect
+      _RAWR_SPECIALIZE_TIMER_COUNTER_COMPARATOR_SOURCE(0, _RAWR_TIFR, 'B', B, TIMER0_COMPB_vect)
+   #endif
+   #undef _RAWR_TIFR
+#endif
+#ifdef TCNT1
+   #ifdef TIFR1
+      #define _RAWR_TIFR TIFR1
+   #else
+      #define _RAWR_TIFR TIFR
+   #endif
+   #ifdef TIMER1_OVF_vect
+      _RAWR_SPECIALIZE_TIMER_COUNTER_OVERFLOW_SOURCE(1, _RAWR_TIFR, TIMER1_OVF_vect)
+   #endif
+   #ifdef TIMER1_COMPA_vect
+      _RAWR_SPECIALIZE_TIMER_COUNTER_COMPARATOR_SOURCE(1, _RAWR_TIFR, 'A', A, TIMER1_COMPA_vect)
+   #endif
+   #ifdef TIMER1_COMPB_vect
+      _RAWR_SPECIALIZE_TIMER_COUNTER_COMPARATOR_SOURCE(1, _RAWR_TIFR, 'B', B, TIMER1_COMPB_vect)
+   #endif
+   #undef _RAWR_TIFR
+#endif
+#ifdef TCNT2
+   #ifdef TIFR2
+      #define _RAWR_TIFR TIFR2
+   #else
+      #define _RAWR_TIFR TIFR
+   #endif
+   #ifdef TIMER2_OVF_vect
+      _RAWR_SPECIALIZE_TIMER_COUNTER_OVERFLOW_SOURCE(2, _RAWR_TIFR, TIMER2_OVF_vect)
+   #endif
+   #ifdef TIMER2_COMPA_vect
+      _RAWR_SPECIALIZE_TIMER_COUNTER_COMPARATOR_SOURCE(2, _RAWR_TIFR, 'A', A, TIMER2_COMPA_vect)
+   #endif
+   #ifdef TIMER2_COMPB_vect
+      _RAWR_SPECIALIZE_TIMER_COUNTER_COMPARATOR_SOURCE(2, _RAWR_TIFR, 'B', B, TIMER2_COMPB_vect)
+   #endif
+   #undef _RAWR_TIFR
+#endif
+#undef _RAWR_SPECIALIZE_TIMER_COUNTER_COMPARATOR_SOURCE
+#undef _RAWR_SPECIALIZE_TIMER_COUNTER_OVERFLOW_SOURCE
+
+}}} //namespace rawr::host::_pvt
+
+namespace rawr { namespace host {
+
+/*! Invoked at the end of each ADC conversion with the channel selected by the MUXn bits of ADMUX, to return
+its 10-bit result; if nullptr, all conversions result in 0. */
+inline uint16_t (* adc_input)(uint8_t channel) = nullptr;
+
+}} //namespace rawr::host
+
+namespace rawr { namespace host { namespace _pvt {
+
+#ifdef ADCSRA
+//! Simulates the conversions of the ADC.
+class adc_model {
+private:
+   typedef hw::adc adc_;
+
+public:
+   //! Returns the number of CPU cycles until the conversion in progress completes, or never.
+   static uint32_t cycles_to_interrupt() {
+      update();
+      if (remaining == 0 || (adc_::control_status_a & _BV(adc_::interrupt_enable_bit)) == 0) {
+         return never;
+      }
+      return remaining;
+   }
+
+   //! Advances the conversion in progress by the specified number of CPU cycles, completing it if it’s due.
+   static void advance(uint32_t cycles) {
+      update();
+      while (remaining != 0 && cycles != 0) {
+         auto step{min(cycles, remaining)};
+         remaining -= step;
+         cycles -= step;
+         if (remaining == 0) {
+            complete();
+         }
+      }
+   }
+
+   //! Invokes the conversion complete vector if its interrupt is pending; returns true if it did.
+   static bool dispatch_one() {
+      if (take_flag(
+         adc_::control_status_a, adc_::interrupt_flag_bit, adc_::control_status_a, adc_::interrupt_enable_bit
+      )) {
+         interrupt(&ADC_vect);
+         return true;
+      }
+      return false;
+   }
+
+   //! Returns true if compare matches of timer/counter Index’s comparator Comparator trigger conversions.
+   template <int Index, char Comparator>
+   static bool triggered_by() {
+      constexpr auto bits{hw::adc_timer_counter_trigger<Index, Comparator>::bits};
+      return bits >= 0 && auto_triggered() &&
+         (adc_::control_status_b & adc_::trigger_source_mask) == static_cast<uint8_t>(bits);
+   }
+
+   /*! Invoked by timer_counter_model when the compare match flag of timer/counter Index’s comparator
+   Comparator goes from 0 to 1, which starts a conversion if it’s the trigger source and none is in
+   progress. */
+   template <int Index, char Comparator>
+   static void compare_match() {
+      if (remaining == 0 && triggered_by<Index, Comparator>()) {
+         start();
+      }
+   }
+
+private:
+   static bool enabled() {
+      return (adc_::control_status_a & _BV(adc_::enable_bit)) != 0;
+   }
+
+   static bool auto_triggered() {
+      uint8_t mask{_BV(adc_::enable_bit) | _BV(adc_::auto_trigger_enable_bit)};
+      return (adc_::control_status_a & mask) == mask;
+   }
+
+   static bool free_running() {
+      return auto_triggered() &&
+         (adc_::control_status_b & adc_::trigger_source_mask) == adc_::free_running_trigger;
+   }
+
+   /*! Catches up with writes to the registers: disabling the ADC aborts the conversion in progress, and
+   setting ADSC starts one. */
+   static void update() {
+      if (!enabled()) {
+         remaining = 0;
+         initialized = false;
+      } else if (remaining == 0 && (adc_::control_status_a & _BV(adc_::start_conversion_bit)) != 0) {
+         start();
+      }
+   }
+
+   static void start() {
+      adc_::control_status_a.set_bit(adc_::start_conversion_bit);
+      uint32_t adc_cycles{initialized ? adc_::conversion_cycles : adc_::first_conversion_cycles};
+      initialized = true;
+      // ADPSn = 0 divides by 2 as well.
+      auto prescaler_bits{static_cast<uint8_t>(adc_::control_status_a & adc_::prescaler_mask)};
+      remaining = adc_cycles << max(prescaler_bits, uint8_t{1});
+   }
+
+   static void complete() {
+      auto channel{static_cast<uint8_t>(adc_::multiplexer_selection & adc_::channel_mask)};
+      auto result{static_cast<uint16_t>((adc_input ? adc_input(channel) : 0) & 0x03ff)};
+      if ((adc_::multiplexer_selection & _BV(adc_::left_adjust_result_bit)) != 0) {
+         result = static_cast<uint16_t>(result << 6);
+      }
+      adc_::data = result;
+      adc_::control_status_a.set_bit(adc_::interrupt_flag_bit);
+      if (free_running()) {
+         start();
+      } else {
+         adc_::control_status_a.clear_bit(adc_::start_conversion_bit);
+      }
+   }
+
+private:
+   //! CPU cycles left to complete the conversion in progress, or 0 if none is.
+   static inline uint32_t remaining;
+   //! true if a conversion was started since the ADC was enabled, making later ones shorter.
+   static inline bool initialized;
+};
+#endif //ifdef ADCSRA
+
+}}} //namespace rawr::host::_pvt
+
+#ifdef EECR
+namespace rawr { namespace host { namespace _pvt {
+
+//! Contents of the simulated EEPROM; indexable like an array.
+struct eeprom_memory {
+   uint8_t bytes[hw::eeprom::size];
+
+   //! Starts out erased.
+   constexpr eeprom_memory() :
+      bytes{} {
+      for (auto & byte : bytes) {
+         byte = 0xff;
+      }
+   }
+
+   constexpr uint8_t & operator[](uint16_t address) {
+      return bytes[address];
+   }
+};
+
+}}} //namespace rawr::host::_pvt
+
+namespace rawr { namespace host {
+
+//! Contents of the EEPROM, which the test code can inspect, or change to simulate e.g. a previous run.
+inline _pvt::eeprom_memory eeprom;
+
+}} //namespace rawr::host
+
+namespace rawr { namespace host { namespace _pvt {
+
+//! Simulates reads and timed writes of the EEPROM; writes are always atomic, regardless of the EEPMn bits.
+class eeprom_model {
+private:
+   typedef hw::eeprom eeprom_;
+
+public:
+   //! Returns the number of CPU cycles until the write in progress completes, or never.
+   static uint32_t cycles_to_interrupt() {
+      if (remaining == 0 || (eeprom_::control & _BV(eeprom_::ready_interrupt_enable_bit)) == 0) {
+         return never;
+      }
+      return remaining;
+   }
+
+   //! Advances the write in progress by the specified number of CPU cycles, completing it if it’s due.
+   static void advance(uint32_t cycles) {
+      if (remaining == 0) {
+         return;
+      }
+      if (cycles < remaining) {
+         remaining -= cycles;
+         return;
+      }
+      remaining = 0;
+      eeprom[address] = value;
+      eeprom_::control.clear_bit(eeprom_::write_enable_bit);
+   }
+
+   //! Invokes the EEPROM ready vector if its interrupt is enabled and no write is in progress.
+   static bool dispatch_one() {
+      if (
+         (eeprom_::control & _BV(eeprom_::ready_interrupt_enable_bit)) != 0 &&
+         (eeprom_::control & _BV(eeprom_::write_enable_bit)) == 0
+      ) {
+   #ifdef EE_READY_vect
+         interrupt(&EE_READY_vect);
+   #else
+         interrupt(&EE_RDY_vect);
+   #endif
+         return true;
+      }
+      return false;
+   }
+
+   //! Performs the read or starts the write requested by setting EERE or EEPE.
+   static void strobe() {
+      if ((eeprom_::control & _BV(eeprom_::read_enable_bit)) != 0) {
+         eeprom_::control.clear_bit(eeprom_::read_enable_bit);
+         if (remaining == 0) {
+            eeprom_::data = eeprom[static_cast<uint16_t>(eeprom_::address % eeprom_::size)];
+         }
+      }
+      if ((eeprom_::control & _BV(eeprom_::write_enable_bit)) != 0 && remaining == 0) {
+         if ((eeprom_::control & _BV(eeprom_::master_write_enable_bit)) != 0) {
+            address = static_cast<uint16_t>(eeprom_::address % eeprom_::size);
+            value = eeprom_::data;
+            remaining = static_cast<uint32_t>(uint64_t{F_CPU} * eeprom_::write_time_us / 1000000);
+         } else {
+            eeprom_::control.clear_bit(eeprom_::write_enable_bit);
+         }
+      }
+      // Cleared by hardware 4 cycles after being set.
+      eeprom_::control.clear_bit(eeprom_::master_write_enable_bit);
+   }
+
+private:
+   //! CPU cycles left to complete the write in progress, or 0 if none is.
+   static inline uint32_t remaining;
+   //! Address and value latched by the write in progress.
+   static inline uint16_t address;
+   static inline uint8_t value;
+};
+
+}}} //namespace rawr::host::_pvt
+#endif //ifdef EECR
+
+namespace rawr { namespace host { namespace _pvt {
+
+/*! Simulates the counting unit of a timer/counter. Each event (the counter reaching the value of a
+comparator, or wrapping around) is simulated separately, so that an interrupt handler can be invoked after
+each of them, and see the counter at the value that triggered it. */
+template <int Index>
+class timer_counter_model {
+private:
+   typedef hw::timer_counter<Index> timer_counter_t;
+   typedef typename timer_counter_t::value_type value_type;
+   typedef timer_counter_overflow_source<Index> overflow_source;
+   typedef timer_counter_comparator_source<Index, 'A'> comparator_a_source;
+   typedef timer_counter_comparator_source<Index, 'B'> comparator_b_source;
+
+   static constexpr int layout{hw::timer_counter_control_registers_layout<Index>::layout};
+   static constexpr uint32_t max_value{static_cast<value_type>(~value_type{})};
+
+public:
+   /*! Returns the number of CPU cycles until the next event that will set an enabled interrupt’s flag, or
+   never if the timer is stopped or no interrupt for it is enabled. */
+   static uint32_t cycles_to_interrupt() {
+      auto prescaler_{prescaler()};
+      if (prescaler_ == 0) {
+         return never;
+      }
+      auto ticks{ticks_to_event(true)};
+      if (ticks == never) {
+         return never;
+      }
+      auto cycles{ticks * prescaler_};
+      // The prescaler might have been changed to a lower value, leaving more cycles than needed for a tick.
+      return cycles > prescaler_cycles ? cycles - prescaler_cycles : 1;
+   }
+
+   //! Advances the timer by the specified number of CPU cycles, setting flags for any events along the way.
+   static void advance(uint32_t cycles) {
+      auto prescaler_{prescaler()};
+      if (prescaler_ == 0) {
+         return;
+      }
+      uint64_t total_cycles{uint64_t{cycles} + prescaler_cycles};
+      auto ticks{static_cast<uint32_t>(total_cycles / prescaler_)};
+      prescaler_cycles = static_cast<uint16_t>(total_cycles % prescaler_);
+      while (ticks != 0) {
+         auto step{min(ticks, ticks_to_event(false))};
+         count(step);
+         ticks -= step;
+      }
+   }
+
+   //! Invokes the vector of one pending interrupt, if any; returns true if it did.
+   static bool dispatch_one() {
+      return dispatch_one<comparator_a_source>() || dispatch_one<comparator_b_source>() ||
+             dispatch_one<overflow_source>();
+   }
+
+private:
+   template <typename Source>
+   static bool dispatch_one() {
+      if constexpr (Source::present) {
+         auto & mask{timer_counter_t::interrupt_mask};
+         if (take_flag(Source::flags, Source::flag_bit, mask, Source::enable_bit)) {
+            interrupt(Source::vector);
+            return true;
+         }
+      }
+      return false;
+   }
+
+   //! Returns the prescaler selected by the Clock Select bits, or 0 if the timer is stopped.
+   static uint32_t prescaler() {
+      auto cs{timer_counter_t::control_registers.get_cs()};
+      constexpr auto & values{hw::timer_counter_prescaler_list<Index>::values};
+      // Values past the end of the list select an external clock source, which is not simulated.
+      return cs != 0 && cs <= RAWR_COUNTOF(values) ? values[cs - 1] : 0;
+   }
+
+   //! Returns the value of comparator Comparator’s register, or never if the comparator doesn’t exist.
+   template <char Comparator>
+   static uint32_t compare_value() {
+      if constexpr (timer_counter_comparator_source<Index, Comparator>::present) {
+         return static_cast<value_type>(timer_counter_t::template comparators<Comparator>::top);
+      } else {
+         return never;
+      }
+   }
+
+   //! Returns true if the Waveform Generation Mode is CTC, which suppresses the overflow flag at TOP.
+   static bool clear_timer_on_compare() {
+      auto wgm{timer_counter_t::control_registers.get_wgm()};
+      return layout == 3 ? wgm == 4 || wgm == 12 : wgm == 2;
+   }
+
+   //! Returns the TOP value for the current Waveform Generation Mode.
+   static uint32_t top_value() {
+      auto wgm{timer_counter_t::control_registers.get_wgm()};
+      if constexpr (layout == 3) {
+         switch (wgm) {
+            case 1: case 5:
+               return 0x00ff;
+            case 2: case 6:
+               return 0x01ff;
+            case 3: case 7:
+               return 0x03ff;
+            case 4: case 9: case 11: case 15:
+               return compare_value<'A'>();
+            case 8: case 10: case 12: case 14:
+               return static_cast<value_type>(hw::timer_counter_input_capture<Index>::value);
+            default:
+               return max_value;
+         }
+      } else {
+         // CTC, and PWM modes with OCRnA as TOP.
+         return wgm == 2 || wgm == 5 || wgm == 7 ? compare_value<'A'>() : max_value;
+      }
+   }
+
+   //! Returns the value after which the counter will wrap around to 0.
+   static uint32_t wrap_value(uint32_t value) {
+      auto top{top_value()};
+      // Past TOP, which can happen after writing TCNTn or OCRnA, the counter runs up to MAX.
+      return value <= top ? top : max_value;
+   }
+
+   //! Returns the number of ticks it takes the counter to get from value to target.
+   static uint32_t ticks_to(uint32_t target, uint32_t value, uint32_t wrap) {
+      if (target > wrap) {
+         return never;
+      }
+      return target > value ? target - value : target + wrap + 1 - value;
+   }
+
+   //! Returns true if the interrupt for Source is enabled.
+   template <typename Source>
+   static bool enabled() {
+      if constexpr (Source::present) {
+         return (timer_counter_t::interrupt_mask & _BV(Source::enable_bit)) != 0;
+      } else {
+         return false;
+      }
+   }
+
+   /*! Returns the number of ticks until the next event, or the next event that would trigger an enabled
+   interrupt if enabled_only is true. */
+   static uint32_t ticks_to_event(bool enabled_only) {
+      uint32_t value{static_cast<value_type>(timer_counter_t::value)};
+      auto wrap{wrap_value(value)};
+      auto ticks{never};
+      if (!enabled_only || enabled<overflow_source>()) {
+         ticks = wrap + 1 - value;
+      }
+      if (!enabled_only || enabled<comparator_a_source>() || triggers_adc<'A'>()) {
+         ticks = min(ticks, ticks_to(compare_value<'A'>(), value, wrap));
+      }
+      if (!enabled_only || enabled<comparator_b_source>() || triggers_adc<'B'>()) {
+         ticks = min(ticks, ticks_to(compare_value<'B'>(), value, wrap));
+      }
+      return ticks;
+   }
+
+   //! Advances the counter by up to the number of ticks to the next event, setting flags if it’s reached.
+   static void count(uint32_t ticks) {
+      uint32_t value{static_cast<value_type>(timer_counter_t::value)};
+      auto wrap{wrap_value(value)};
+      value += ticks;
+      if (value > wrap) {
+         value = 0;
+         if (wrap == max_value || !clear_timer_on_compare()) {
+            set_flag<overflow_source>();
+         }
+      }
+      timer_counter_t::value = static_cast<value_type>(value);
+      if (value == compare_value<'A'>()) {
+         set_compare_flag<'A'>();
+      }
+      if (value == compare_value<'B'>()) {
+         set_compare_flag<'B'>();
+      }
+   }
+
+   //! Returns true if comparator Comparator’s compare matches trigger ADC conversions.
+   template <char Comparator>
+   static bool triggers_adc() {
+#ifdef ADCSRA
+      return adc_model::triggered_by<Index, Comparator>();
+#else
+      return false;
+#endif
+   }
+
+   //! Sets the flag of comparator Comparator, which triggers an ADC conversion if it wasn’t already set.
+   template <char Comparator>
+   static void set_compare_flag() {
+      typedef timer_counter_comparator_source<Index, Comparator> source;
+      if constexpr (source::present) {
+         bool was_set{(source::flags & _BV(source::flag_bit)) != 0};
+         set_flag<source>();
+#ifdef ADCSRA
+         if (!was_set) {
+            adc_model::compare_match<Index, Comparator>();
+         }
+#else
+         static_cast<void>(was_set);
+#endif
+      }
+   }
+
+   template <typename Source>
+   static void set_flag() {
+      if constexpr (Source::present) {
+         Source::flags.set_bit(Source::flag_bit);
+      }
+   }
+
+private:
+   //! CPU cycles counted by the prescaler towards the next tick.
+   static inline uint16_t prescaler_cycles;
+};
+
+//! Vector of the pin change interrupt of each I/O port.
+template <char Port>
+struct pin_change_source {
+   static constexpr bool present{false};
+};
+
+#define _RAWR_SPECIALIZE_PIN_CHANGE_SOURCE(port, vect) \
+   template <> \
+   struct pin_change_source<port> { \
+      static constexpr bool present{true}; \
+      static constexpr vector_t vector{&vect}; \
+   };
+#ifdef PCINT_A_vect
+   _RAWR_SPECIALIZE_PIN_CHANGE_SOURCE('A', PCINT_A_vect)
+#endif
+#ifdef PCINT_B_vect
+   _RAWR_SPECIALIZE_PIN_CHANGE_SOURCE('B', PCINT_B_vect)
+#endif
+#ifdef PCINT_C_vect
+   _RAWR_SPECIALIZE_PIN_CHANGE_SOURCE('C', PCINT_C_vect)
+#endif
+#ifdef PCINT_D_vect
+   _RAWR_SPECIALIZE_PIN_CHANGE_SOURCE('D', PCINT_D_vect)
+#endif
+#undef _RAWR_SPECIALIZE_PIN_CHANGE_SOURCE
+
+//! Vectors of the interrupts of each USART.
+template <int Index>
+struct usart_source {
+   static constexpr bool present{false};
+};
+
+#define _RAWR_SPECIALIZE_USART_SOURCE(index, rx_vect, udre_vect) \
+   template <> \
+   struct usart_source<index> { \
+      static constexpr bool present{true}; \
+      static constexpr vector_t rx_vector{&rx_vect}; \
+      static constexpr vector_t udre_vector{&udre_vect}; \
+   }; \
+   /* The data register is always empty, for code polling it. Not inline, so that it’s initialized even if \
+   not referenced. */ \
+   static bool const usart_ ## index ## _data_register_empty{[] () { \
+      hw::usart<index>::control_status_a.set_bit(hw::usart<index>::data_register_empty_bit); \
+      return true; \
+   }()};
+#if defined(USART0_RX_vect)
+   _RAWR_SPECIALIZE_USART_SOURCE(0, USART0_RX_vect, USART0_UDRE_vect)
+#elif defined(USART_RX_vect)
+   _RAWR_SPECIALIZE_USART_SOURCE(0, USART_RX_vect, USART_UDRE_vect)
+#endif
+#ifdef USART1_RX_vect
+   _RAWR_SPECIALIZE_USART_SOURCE(1, USART1_RX_vect, USART1_UDRE_vect)
+#endif
+#undef _RAWR_SPECIALIZE_USART_SOURCE
+
+}}} //namespace rawr::host::_pvt
+
+namespace rawr { namespace host {
+
+/*! Invoked with each byte transmitted by a USART’s Data Register Empty interrupt handler; bytes written to
+the data register outside of it, e.g. by abort_reporter, are not seen. */
+inline void (* usart_transmit_handler)(int index, uint8_t byte) = nullptr;
+
+}} //namespace rawr::host
+
+namespace rawr { namespace host { namespace _pvt {
+
+/*! Invokes the Receive Complete vector of the USART if its interrupt is pending, or else the Data Register
+Empty one if enabled, since the data register is always empty; returns true if it invoked either. */
+template <int Index>
+inline bool dispatch_usart() {
+   if constexpr (usart_source<Index>::present) {
+      typedef hw::usart<Index> usart_;
+      if (take_flag(
+         usart_::control_status_a, usart_::receive_complete_bit,
+         usart_::control_status_b, usart_::receive_complete_interrupt_enable_bit
+      )) {
+         interrupt(usart_source<Index>::rx_vector);
+         return true;
+      }
+      if ((usart_::control_status_b & _BV(usart_::data_register_empty_interrupt_enable_bit)) != 0) {
+         interrupt(usart_source<Index>::udre_vector);
+         if (usart_transmit_handler) {
+            usart_transmit_handler(Index, usart_::data);
+         }
+         return true;
+      }
+   }
+   return false;
+}
+
+//! Invokes the pin change vector for the port if its interrupt is pending; returns true if it did.
+template <char Port>
+inline bool dispatch_pin_change() {
+   if constexpr (pin_change_source<Port>::present) {
+      typedef hw::io_port<Port> io_port_;
+      if (take_flag(PCIFR, io_port_::pcint_flag_bit, PCICR, io_port_::pcint_enable_bit)) {
+         interrupt(pin_change_source<Port>::vector);
+         return true;
+      }
+   }
+   return false;
+}
+
+//! Simulates the interrupt mode of the watchdog timer.
+class watchdog_timer_model {
+public:
+   /*! Returns the number of CPU cycles until the watchdog timer expires, or never if its interrupt is not
+   enabled. */
+   static uint32_t cycles_to_interrupt() {
+      if (!enabled()) {
+         return never;
+      }
+      // The prescaler might have been changed to a shorter period than already elapsed.
+      auto period_{period()};
+      return elapsed < period_ ? period_ - elapsed : 1;
+   }
+
+   //! Advances the watchdog timer by the specified number of CPU cycles, setting its flag if it expires.
+   static void advance(uint32_t cycles) {
+      if (!enabled()) {
+         return;
+      }
+      uint64_t total{uint64_t{elapsed} + cycles};
+      auto period_{period()};
+      if (total >= period_) {
+         WDTCR.set_bit(WDIF);
+         total %= period_;
+      }
+      elapsed = static_cast<uint32_t>(total);
+   }
+
+   //! Invokes the watchdog timeout vector if its interrupt is pending; returns true if it did.
+   static bool dispatch_one() {
+#if defined(WDT_vect) || defined(WATCHDOG_vect)
+      if (take_flag(WDTCR, WDIF, WDTCR, WDIE)) {
+   #ifdef WDT_vect
+         interrupt(&WDT_vect);
+   #else
+         interrupt(&WATCHDOG_vect);
+   #endif
+         return true;
+      }
+#endif
+      return false;
+   }
+
+   //! Restarts the current period; invoked by wdt_reset().
+   static void reset() {
+      elapsed = 0;
+   }
+
+private:
+   static bool enabled() {
+      return (WDTCR & _BV(WDIE)) != 0;
+   }
+
+   //! Returns the length of the period selected by the prescaler bits, in CPU cycles.
+   static uint32_t period() {
+      uint8_t wdtcr{WDTCR};
+      auto prescaler_bits{static_cast<uint8_t>(wdtcr & (_BV(WDP2) | _BV(WDP1) | _BV(WDP0)))};
+#ifdef WDP3
+      if ((wdtcr & _BV(WDP3)) != 0) {
+         prescaler_bits = static_cast<uint8_t>(prescaler_bits | 0x08);
+      }
+#endif
+      // 2048 << prescaler_bits cycles of the watchdog oscillator, i.e. 16 << prescaler_bits ms.
+      return static_cast<uint32_t>(F_CPU / 1000 * (uint32_t{16} << prescaler_bits));
+   }
+
+private:
+   //! CPU cycles elapsed in the current period.
+   static inline uint32_t elapsed;
+};
+
+/*! Invokes the vector of one pending interrupt, if any; returns true if it did. Sources are checked in a
+fixed order, which approximates the priority given by the vector table of most MCUs. */
+inline bool dispatch_one() {
+   return
+      dispatch_pin_change<'A'>() || dispatch_pin_change<'B'>() ||
+      dispatch_pin_change<'C'>() || dispatch_pin_change<'D'>() ||
+#ifdef TCNT2
+      timer_counter_model<2>::dispatch_one() ||
+#endif
+#ifdef TCNT1
+      timer_counter_model<1>::dispatch_one() ||
+#endif
+#ifdef TCNT0
+      timer_counter_model<0>::dispatch_one() ||
+#endif
+      dispatch_usart<0>() ||
+#ifdef UDR1
+      dispatch_usart<1>() ||
+#endif
+#ifdef ADCSRA
+      adc_model::dispatch_one() ||
+#endif
+#ifdef EECR
+      eeprom_model::dispatch_one() ||
+#endif
+      watchdog_timer_model::dispatch_one();
+}
+
+//! Returns the number of CPU cycles until an enabled interrupt’s flag is set, or never.
+inline uint32_t cycles_to_interrupt() {
+   auto cycles{never};
+#ifdef TCNT0
+   cycles = min(cycles, timer_counter_model<0>::cycles_to_interrupt());
+#endif
+#ifdef TCNT1
+   cycles = min(cycles, timer_counter_model<1>::cycles_to_interrupt());
+#endif
+#ifdef TCNT2
+   cycles = min(cycles, timer_counter_model<2>::cycles_to_interrupt());
+#endif
+#ifdef ADCSRA
+   cycles = min(cycles, adc_model::cycles_to_interrupt());
+#endif
+#ifdef EECR
+   cycles = min(cycles, eeprom_model::cycles_to_interrupt());
+#endif
+   cycles = min(cycles, watchdog_timer_model::cycles_to_interrupt());
+   return cycles;
+}
+
+/*! Advances all timers, the ADC, the EEPROM and the watchdog timer, by the specified number of CPU cycles.
+The ADC goes first, so that a conversion triggered by a timer/counter at the end of the step doesn’t count the
+step too. */
+inline void advance_timers(uint32_t cycles) {
+#ifdef ADCSRA
+   adc_model::advance(cycles);
+#endif
+#ifdef EECR
+   eeprom_model::advance(cycles);
+#endif
+#ifdef TCNT0
+   timer_counter_model<0>::advance(cycles);
+#endif
+#ifdef TCNT1
+   timer_counter_model<1>::advance(cycles);
+#endif
+#ifdef TCNT2
+   timer_counter_model<2>::advance(cycles);
+#endif
+   watchdog_timer_model::advance(cycles);
+}
+
+}}} //namespace rawr::host::_pvt
+
+namespace rawr { namespace host {
+
+/*! Services pending interrupts, if interrupts are enabled; returns true if any was serviced. Invoked after
+every change to the simulated state that could set an interrupt flag. */
+inline bool dispatch_interrupts() {
+   bool serviced{false};
+   while ((SREG & _BV(SREG_I)) != 0 && _pvt::dispatch_one()) {
+      serviced = true;
+   }
+   return serviced;
+}
+
+//! Returns the time elapsed on the virtual clock, in CPU cycles.
+inline uint64_t elapsed_cycles() {
+   return _pvt::elapsed_cycles;
+}
+
+//! Advances the virtual clock by the specified number of CPU cycles, servicing interrupts as they occur.
+inline void advance_cycles(uint64_t cycles) {
+   while (cycles != 0) {
+      auto step{static_cast<uint32_t>(min(cycles, uint64_t{_pvt::cycles_to_interrupt()}))};
+      _pvt::advance_timers(step);
+      _pvt::elapsed_cycles += step;
+      cycles -= step;
+      dispatch_interrupts();
+   }
+}
+
+//! Advances the virtual clock by the specified time, servicing interrupts as they occur.
+template <typename Int, Int Scale>
+inline void advance(chrono::time_unit<Int, Scale> duration) {
+   advance_cycles(static_cast<uint64_t>(duration.count()) * F_CPU / Scale);
+}
+
+/*! Advances the virtual clock until an interrupt is serviced, like a sleeping CPU would. Resets the device if
+that can never happen, because interrupts are disabled or no enabled interrupt source is running. */
+inline void advance_until_interrupt() {
+   auto serviced_interrupts{_pvt::serviced_interrupts};
+   dispatch_interrupts();
+   while (serviced_interrupts == _pvt::serviced_interrupts) {
+      auto cycles{_pvt::cycles_to_interrupt()};
+      if ((SREG & _BV(SREG_I)) == 0 || cycles == _pvt::never) {
+         reset();
+      }
+      advance_cycles(cycles);
+   }
+}
+
+/*! Sets the value of the pins of an I/O port, as if driven by external circuitry, raising the port’s pin
+change interrupt if any pin that changed has it enabled. */
+template <char Port>
+inline void set_pins(uint8_t value) {
+   typedef hw::io_port<Port> io_port_;
+   auto changed{static_cast<uint8_t>(io_port_::pins ^ value)};
+   // Via ref(), since with RAWR_HOST_PINS_TOGGLE_DATA writing pins would toggle PORTx instead.
+   io_port_::pins.ref() = value;
+   if constexpr (io_port_::has_pcint) {
+      if ((changed & io_port_::pcint_mask) != 0) {
+         PCIFR.set_bit(io_port_::pcint_flag_bit);
+         dispatch_interrupts();
+      }
+   }
+}
+
+/*! Makes a USART receive a byte, as if sent by external circuitry, raising its Receive Complete interrupt if
+enabled. */
+template <int Index>
+inline void receive(uint8_t byte) {
+   typedef hw::usart<Index> usart_;
+   usart_::data = byte;
+   usart_::control_status_a.set_bit(usart_::receive_complete_bit);
+   dispatch_interrupts();
+}
+
+//! Sets the value of a single pin of an I/O port; see set_pins().
+template <char Port>
+inline void set_pin(uint8_t bit, bool value) {
+   uint8_t pins{hw::io_port<Port>::pins};
+   set_pins<Port>(static_cast<uint8_t>(value ? pins | _BV(bit) : pins & ~_BV(bit)));
+}
+
+#ifdef EECR
+/*! Performs the EEPROM read or starts the EEPROM write requested by setting EERE or EEPE, which writes to the
+simulated registers can’t do by themselves; code accessing the EEPROM must invoke this right after. */
+inline void strobe_eeprom() {
+   _pvt::eeprom_model::strobe();
+}
+#endif
+
+}} //namespace rawr::host
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Replacements for avr-libc macros that expand to AVR instructions.
+
+// <avr/interrupt.h>
+
+inline void cli() {
+   SREG.clear_bit(SREG_I);
+}
+
+inline void sei() {
+   SREG.set_bit(SREG_I);
+   rawr::host::dispatch_interrupts();
+}
+
+// <avr/pgmspace.h>
+
+#define PROGMEM
+#define PSTR(s) (s)
+
+inline uint8_t pgm_read_byte(void const * addr) {
+   return *static_cast<uint8_t const *>(addr);
+}
+
+inline uint16_t pgm_read_word(void const * addr) {
+   return *static_cast<uint16_t const *>(addr);
+}
+
+// <avr/sleep.h>
+
+inline void sleep_enable() {
+   rawr::host::_pvt::sleep_control.set_bit(SE);
+   rawr::host::_pvt::serviced_interrupts_at_sleep_enable = rawr::host::_pvt::serviced_interrupts;
+}
+
+inline void sleep_disable() {
+   rawr::host::_pvt::sleep_control.clear_bit(SE);
+}
+
+/*! Advances the virtual clock until an interrupt wakes the CPU up. Since sei() services pending interrupts
+right away instead of after the next instruction, an interrupt serviced after sleep_enable() is treated as one
+that woke the CPU up as soon as it went to sleep, so that the usual “sleep_enable(); sei(); sleep_cpu();”
+sequence doesn’t miss it. */
+inline void sleep_cpu() {
+   using namespace rawr::host::_pvt;
+   if ((sleep_control & _BV(SE)) != 0 && serviced_interrupts == serviced_interrupts_at_sleep_enable) {
+      rawr::host::advance_until_interrupt();
+   }
+}
+
+// <avr/wdt.h>
+
+inline void wdt_enable(uint8_t timeout) {
+#ifdef WDP3
+   WDTCR = static_cast<uint8_t>(_BV(WDE) | (timeout & 0x07) | ((timeout & 0x08) != 0 ? _BV(WDP3) : 0));
+#else
+   WDTCR = static_cast<uint8_t>(_BV(WDE) | (timeout & 0x07));
+#endif
+}
+
+inline void wdt_disable() {
+   WDTCR = 0;
+}
+
+inline void wdt_reset() {
+   rawr::host::_pvt::watchdog_timer_model::reset();
+}
@@ -0,0 +1,122 @@
+/* -*- coding: utf-8; mode: c++; tab-width: 3; indent-tabs-mode: nil -*-
+
+Copyright 2022 Raffaello D. Di Napoli
+
+This file is part of RAWR.
+
+RAWR is free software: you can redistribute it and/or modify it under the terms of version 2.1 of the GNU
+Lesser General Public License as published by the Free Software Foundation.
+
+RAWR is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for
+more details.
+------------------------------------------------------------------------------------------------------------*/
+
+#pragma once
+
+#include <rawr/hw/io.hxx>
+#include <rawr/misc.hxx>
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace rawr { namespace hw {
+
+#ifdef ADCSRA
+
+//! Analog-to-digital converter abstraction; AVR MCUs have at most one ADC, multiplexed among its channels.
+struct adc {
+   static constexpr decltype(ADMUX) multiplexer_selection{};
+   static constexpr decltype(ADCSRA) control_status_a{};
+   static constexpr decltype(ADCSRB) control_status_b{};
+   //! Conversion result; accessed as a 16-bit register, which reads ADCL before ADCH as required.
+   static constexpr decltype(ADC) data{};
+   static constexpr decltype(DIDR0) digital_input_disable{};
+
+   // ADMUX
+   static constexpr uint8_t left_adjust_result_bit{ADLAR};
+   static constexpr uint8_t channel_mask{_BV(MUX3) | _BV(MUX2) | _BV(MUX1) | _BV(MUX0)};
+   // ADCSRA
+   static constexpr uint8_t enable_bit{ADEN};
+   static constexpr uint8_t start_conversion_bit{ADSC};
+   static constexpr uint8_t auto_trigger_enable_bit{ADATE};
+   static constexpr uint8_t interrupt_flag_bit{ADIF};
+   static constexpr uint8_t interrupt_enable_bit{ADIE};
+   static constexpr uint8_t prescaler_mask{_BV(ADPS2) | _BV(ADPS1) | _BV(ADPS0)};
+   // ADCSRB
+   static constexpr uint8_t trigger_source_mask{_BV(ADTS2) | _BV(ADTS1) | _BV(ADTS0)};
+   //! ADTS bits selecting free running mode, in which each conversion starts as soon as the previous ends.
+   static constexpr uint8_t free_running_trigger{0};
+
+   //! Length of a conversion, in ADC clock cycles.
+   static constexpr uint8_t conversion_cycles{13};
+   //! Length of the first conversion after enabling the ADC, which also initializes its analog circuitry.
+   static constexpr uint8_t first_conversion_cycles{25};
+};
+
+/*! Values of the REFSn bits of ADMUX for the voltage references of the ADC. avr-libc doesn’t define these,
+and the same bits select different references on different MCUs, so they need to be specialized for each MCU.
+*/
+struct adc_references;
+
+#define _RAWR_SPECIALIZE_ADC_REFERENCES(vcc_bits, external_bits, internal_1v1_bits) \
+   struct adc_references { \
+      static constexpr uint8_t vcc{vcc_bits}; \
+      static constexpr uint8_t external{external_bits}; \
+      static constexpr uint8_t internal_1v1{internal_1v1_bits}; \
+   };
+
+/*! ADTS bits selecting a timer/counter comparator’s compare match as auto trigger source for the ADC, or -1
+if it can’t be used as such. Specialized for each MCU, like adc_references. */
+template <int Index, char Comparator>
+struct adc_timer_counter_trigger {
+   static constexpr int8_t bits{-1};
+};
+
+#define _RAWR_SPECIALIZE_ADC_TIMER_COUNTER_TRIGGER(index, comparator, adts_bits) \
+   template <> \
+   struct adc_timer_counter_trigger<index, comparator> { \
+      static constexpr int8_t bits{adts_bits}; \
+   };
+#if defined(__AVR_ATmega48__) || defined(__AVR_ATmega48A__) || defined(__AVR_ATmega48P__) || \
+    defined(__AVR_ATmega48PA__) || defined(__AVR_ATmega88__) || defined(__AVR_ATmega88A__) || \
+    defined(__AVR_ATmega88P__) || defined(__AVR_ATmega88PA__) || defined(__AVR_ATmega168__) || \
+    defined(__AVR_ATmega168A__) || defined(__AVR_ATmega168P__) || defined(__AVR_ATmega168PA__) || \
+    defined(__AVR_ATmega328__) || defined(__AVR_ATmega328P__)
+   // AVcc, AREF pin, internal 1.1 V.
+   _RAWR_SPECIALIZE_ADC_REFERENCES(_BV(REFS0), 0, _BV(REFS1) | _BV(REFS0))
+   _RAWR_SPECIALIZE_ADC_TIMER_COUNTER_TRIGGER(0, 'A', 0b011)
+   _RAWR_SPECIALIZE_ADC_TIMER_COUNTER_TRIGGER(1, 'B', 0b101)
+#elif defined(__AVR_ATtiny25__) || defined(__AVR_ATtiny45__) || defined(__AVR_ATtiny85__)
+   // Vcc, AREF pin (PB0), internal 1.1 V.
+   _RAWR_SPECIALIZE_ADC_REFERENCES(0, _BV(REFS0), _BV(REFS1))
+   _RAWR_SPECIALIZE_ADC_TIMER_COUNTER_TRIGGER(0, 'A', 0b011)
+   _RAWR_SPECIALIZE_ADC_TIMER_COUNTER_TRIGGER(0, 'B', 0b101)
+#endif
+#undef _RAWR_SPECIALIZE_ADC_TIMER_COUNTER_TRIGGER
+#undef _RAWR_SPECIALIZE_ADC_REFERENCES
+
+/*! Computes at compile time the ADPSn bits of ADCSRA selecting the fastest ADC clock not above MaxFrequency,
+given F_CPU. The ADC needs a clock between 50 and 200 kHz to give its full 10-bit resolution; faster clocks
+trade some of it for a higher sample rate. */
+template <uint32_t MaxFrequency = 200000>
+class adc_prescaler {
+private:
+   static constexpr uint32_t f_cpu{static_cast<uint32_t>(F_CPU)};
+
+   //! Returns the first prescaler selection, starting from bits, whose clock is not faster than MaxFrequency.
+   static constexpr uint8_t select(uint8_t bits) {
+      return bits == 7 || (f_cpu >> bits) <= MaxFrequency ? bits : select(static_cast<uint8_t>(bits + 1));
+   }
+
+public:
+   //! Value for the ADPSn bits; 0 divides by 2 like 1 does, so it’s never selected.
+   static constexpr uint8_t bits{select(1)};
+   //! Resulting ADC clock frequency, in Hz.
+   static constexpr uint32_t frequency{f_cpu >> bits};
+
+   static_assert(frequency <= MaxFrequency, "F_CPU too high for the requested ADC clock");
+};
+
+#endif //ifdef ADCSRA
+
+}} //namespace rawr::hw
@@ -52,7 +52,12 @@ public:
    }
 
    void toggle() {
-      io_port_::data.toggle_bit(Bit);
+      if constexpr (io_port_::pins_toggle_data) {
+         // A single write, so it can’t race with interrupt handlers changing other pins of the port.
+         io_port_::pins = _BV(Bit);
+      } else {
+         io_port_::data.toggle_bit(Bit);
+      }
    }
 };
 
@@ -0,0 +1,61 @@
+/* -*- coding: utf-8; mode: c++; tab-width: 3; indent-tabs-mode: nil -*-
+
+Copyright 2022 Raffaello D. Di Napoli
+
+This file is part of RAWR.
+
+RAWR is free software: you can redistribute it and/or modify it under the terms of version 2.1 of the GNU
+Lesser General Public License as published by the Free Software Foundation.
+
+RAWR is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for
+more details.
+------------------------------------------------------------------------------------------------------------*/
+
+#pragma once
+
+#include <rawr/hw/io.hxx>
+#include <rawr/misc.hxx>
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace rawr { namespace hw {
+
+#ifdef EECR
+
+//! Data EEPROM abstraction.
+struct eeprom {
+   static constexpr decltype(EECR) control{};
+   static constexpr decltype(EEDR) data{};
+#ifdef EEAR
+   static constexpr decltype(EEAR) address{};
+#else
+   static constexpr decltype(EEARL) address{};
+#endif
+
+   // EECR
+   static constexpr uint8_t read_enable_bit{EERE};
+#ifdef EEPE
+   static constexpr uint8_t write_enable_bit{EEPE};
+   static constexpr uint8_t master_write_enable_bit{EEMPE};
+#else
+   static constexpr uint8_t write_enable_bit{EEWE};
+   static constexpr uint8_t master_write_enable_bit{EEMWE};
+#endif
+   static constexpr uint8_t ready_interrupt_enable_bit{EERIE};
+#ifdef EEPM0
+   //! EEPMn bits; 0 selects atomic operation, i.e. erase and write in one operation.
+   static constexpr uint8_t programming_mode_mask{_BV(EEPM1) | _BV(EEPM0)};
+#else
+   static constexpr uint8_t programming_mode_mask{0};
+#endif
+
+   //! Size of the EEPROM, in bytes.
+   static constexpr uint16_t size{E2END + 1};
+   //! Typical length of an atomic erase and write of one byte, in µs.
+   static constexpr uint16_t write_time_us{3400};
+};
+
+#endif //ifdef EECR
+
+}} //namespace rawr::hw
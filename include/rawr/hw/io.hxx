@@ -35,6 +35,17 @@ for GIMSK (only used in a handful of µCUs). */
 
 #include <avr/sfr_defs.h>
 
+#ifdef RAWR_HOST
+namespace rawr { namespace host {
+
+/*! Simulated I/O memory backing all io_mem_reg instances in host builds, i.e. when RAWR_HOST is defined;
+large enough for the extended I/O space of any supported MCU. See <rawr/host.hxx> for the rest of the
+simulation. */
+alignas(uint32_t) inline uint8_t register_file[0x200];
+
+}} //namespace rawr::host
+#endif
+
 namespace rawr { namespace hw {
 
 /*! In this unusual class, every method is const because instances are supposed to be declared constexpr so
@@ -42,7 +53,9 @@ that they can be defined within a class declaration, and they won’t allocate a
 storage is an I/O memory register).
 
 Note: Addr is 16-bit wide because _SFR_MEM_ADDR() has a cast to uint16_t, implying that on some MCUs, there
-are registers with address > 0xff. */
+are registers with address > 0xff.
+
+In host builds, Addr is an offset into rawr::host::register_file instead of an address. */
 template <uint16_t Addr, typename T>
 struct io_mem_reg {
    //! Used when we need just the address as a number. So far, only the redefined _SFR_MEM_ADDR() uses it.
@@ -60,7 +73,12 @@ struct io_mem_reg {
    }
 
    constexpr T volatile & ref() const {
+#ifdef RAWR_HOST
+      static_assert(Addr + sizeof(T) <= sizeof host::register_file, "register outside simulated I/O memory");
+      return *reinterpret_cast<T volatile *>(&host::register_file[Addr]);
+#else
       return *reinterpret_cast<T volatile *>(Addr);
+#endif
    }
 
    io_mem_reg const & clear_bit(uint8_t bit) const {
@@ -131,6 +149,10 @@ struct io_mem_reg {
    #define TIMER0_COMPB_vect TIM0_COMPB_vect
 #endif
 
+#if !defined(TIMER0_OVF_vect) && defined(TIM0_OVF_vect)
+   #define TIMER0_OVF_vect TIM0_OVF_vect
+#endif
+
 #if !defined(TIMER1_COMPA_vect) && defined(TIMER1_COMP_vect)
    #define TIMER1_COMPA_vect TIMER1_COMP_vect
 #endif
@@ -141,6 +163,10 @@ struct io_mem_reg {
    #define TIMER1_COMPB_vect TIM1_COMPB_vect
 #endif
 
+#if !defined(TIMER1_OVF_vect) && defined(TIM1_OVF_vect)
+   #define TIMER1_OVF_vect TIM1_OVF_vect
+#endif
+
 #if !defined(TIMER2_COMPA_vect) && defined(TIMER2_COMP_vect)
    #define TIMER2_COMPA_vect TIMER2_COMP_vect
 #endif
@@ -151,6 +177,10 @@ struct io_mem_reg {
    #define TIMER2_COMPB_vect TIM2_COMPB_vect
 #endif
 
+#if !defined(TIMER2_OVF_vect) && defined(TIM2_OVF_vect)
+   #define TIMER2_OVF_vect TIM2_OVF_vect
+#endif
+
 #if !defined(WDTCR) && defined(WDTCSR)
    #define WDTCR WDTCSR
 #endif
@@ -111,6 +111,24 @@ struct io_port_pcint_members {
 #endif
 #undef _RAWR_SPECIALIZE_IO_PORT_PCINT_MEMBERS
 
+#if defined(RAWR_HOST) && defined(RAWR_HOST_PINS_TOGGLE_DATA)
+/*! PINx in host builds with RAWR_HOST_PINS_TOGGLE_DATA: reads return the simulated pin values like any other
+register, but writes toggle the bits of PORTx written as 1, as the MCU does. */
+template <typename PinsReg, typename DataReg>
+struct toggling_pins_reg : PinsReg {
+   toggling_pins_reg const & operator=(uint8_t src) const {
+      DataReg{}.ref() = static_cast<uint8_t>(DataReg{}.ref() ^ src);
+      return *this;
+   }
+
+   //! Like the sbi instruction, only writes a 1 to the one bit.
+   toggling_pins_reg const & set_bit(uint8_t bit) const {
+      DataReg{}.toggle_bit(bit);
+      return *this;
+   }
+};
+#endif
+
 }}} //namespace rawr::hw::_pvt
 
 namespace rawr { namespace hw {
@@ -129,14 +147,34 @@ struct io_port_pin {
    static_assert(!Port, "the selected MCU does not seem to have this port");
 };
 
+/* Writing 1 to PINxn toggles PORTxn on all but the oldest MCUs; host builds only simulate it if
+RAWR_HOST_PINS_TOGGLE_DATA is defined (see <rawr/host.hxx>). */
+#if (defined(RAWR_HOST) && !defined(RAWR_HOST_PINS_TOGGLE_DATA)) || \
+   defined(__AVR_ATmega8__) || defined(__AVR_ATmega16__) || defined(__AVR_ATmega32__) || \
+   defined(__AVR_ATmega64__) || defined(__AVR_ATmega128__) || defined(__AVR_ATmega162__) || \
+   defined(__AVR_ATmega8515__) || defined(__AVR_ATmega8535__) || defined(__AVR_ATtiny26__)
+   #define _RAWR_IO_PORT_PINS_TOGGLE_DATA false
+   #define _RAWR_IO_PORT_PINS_TYPE(port_unquoted) decltype(RAWR_CPP_CAT2(PIN, port_unquoted))
+#else
+   #define _RAWR_IO_PORT_PINS_TOGGLE_DATA true
+   #ifdef RAWR_HOST
+      #define _RAWR_IO_PORT_PINS_TYPE(port_unquoted) _pvt::toggling_pins_reg< \
+         decltype(RAWR_CPP_CAT2(PIN, port_unquoted)), decltype(RAWR_CPP_CAT2(PORT, port_unquoted)) \
+      >
+   #else
+      #define _RAWR_IO_PORT_PINS_TYPE(port_unquoted) decltype(RAWR_CPP_CAT2(PIN, port_unquoted))
+   #endif
+#endif
 #define _RAWR_SPECIALIZE_IO_PORT(port_quoted, port_unquoted, defined_pins) \
    template <> \
    struct io_port<port_quoted> : _pvt::io_port_pcint_members<port_quoted> { \
       static constexpr char name = port_quoted; \
       static constexpr decltype(RAWR_CPP_CAT2(DDR, port_unquoted)) data_direction{}; \
       static constexpr decltype(RAWR_CPP_CAT2(PORT, port_unquoted)) data{}; \
-      static constexpr decltype(RAWR_CPP_CAT2(PIN, port_unquoted)) pins{}; \
+      static constexpr _RAWR_IO_PORT_PINS_TYPE(port_unquoted) pins{}; \
       static constexpr unsigned bit_size{defined_pins}; \
+      /* true if writing 1 to a bit of pins toggles the same bit of data, leaving the other bits alone. */ \
+      static constexpr bool pins_toggle_data{_RAWR_IO_PORT_PINS_TOGGLE_DATA}; \
    }; \
    \
    template <int Pin> \
@@ -353,5 +391,7 @@ struct io_port_pin {
    #undef _RAWR_DEFINED_IO_PORT_PINS
 #endif
 #undef _RAWR_SPECIALIZE_IO_PORT
+#undef _RAWR_IO_PORT_PINS_TOGGLE_DATA
+#undef _RAWR_IO_PORT_PINS_TYPE
 
 }} //namespace rawr::hw
@@ -15,6 +15,7 @@ more details.
 #pragma once
 
 #include <rawr/hw/io.hxx>
+#include <rawr/hw/io_port.hxx>
 
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -96,10 +97,40 @@ struct timer_counter_control_registers;
    TCCRnA  FOCnA WGMn[0] COMnA[1:0] WGMn[1] CSn[2:0] */
 template <int Index, uint8_t Mask_cs>
 struct timer_counter_control_registers<Index, Mask_cs, 1> : timer_counter_control_registers_raw<Index> {
+   //! Returns the Clock Select bits.
+   static uint8_t get_cs() {
+      return static_cast<uint8_t>(timer_counter_control_registers_raw<Index>::a & Mask_cs);
+   }
+
    static void set_cs(uint8_t cs) {
       timer_counter_control_registers_raw<Index>::a =
          (timer_counter_control_registers_raw<Index>::a & static_cast<uint8_t>(~Mask_cs)) | cs;
    }
+
+   //! Sets the Compare Output Mode bits for the specified comparator.
+   template <char Comparator>
+   static void set_com(uint8_t com) {
+      static_assert(Comparator == 'A', "layout 1 only has comparator A");
+      timer_counter_control_registers_raw<Index>::a = static_cast<uint8_t>(
+         (timer_counter_control_registers_raw<Index>::a & 0b11001111) | (com << 4)
+      );
+   }
+
+   //! Returns the Waveform Generation Mode bits.
+   static uint8_t get_wgm() {
+      return static_cast<uint8_t>(
+         ((timer_counter_control_registers_raw<Index>::a >> 6) & 0b01) |
+         ((timer_counter_control_registers_raw<Index>::a >> 2) & 0b10)
+      );
+   }
+
+   //! Sets the Waveform Generation Mode bits.
+   static void set_wgm(uint8_t wgm) {
+      timer_counter_control_registers_raw<Index>::a = static_cast<uint8_t>(
+         (timer_counter_control_registers_raw<Index>::a & 0b10110111) |
+         ((wgm & 0b01) << 6) | ((wgm & 0b10) << 2)
+      );
+   }
 };
 
 /* TCCR layout 2: two Output Compare Units, three WGM bits:
@@ -107,10 +138,43 @@ struct timer_counter_control_registers<Index, Mask_cs, 1> : timer_counter_contro
    TCCRnB  FOCnA FOCnB - - WGMn[2] CSn[2:0] */
 template <int Index, uint8_t Mask_cs>
 struct timer_counter_control_registers<Index, Mask_cs, 2> : timer_counter_control_registers_raw<Index> {
+   //! Returns the Clock Select bits.
+   static uint8_t get_cs() {
+      return static_cast<uint8_t>(timer_counter_control_registers_raw<Index>::b & Mask_cs);
+   }
+
    static void set_cs(uint8_t cs) {
       timer_counter_control_registers_raw<Index>::b =
          (timer_counter_control_registers_raw<Index>::b & static_cast<uint8_t>(~Mask_cs)) | cs;
    }
+
+   //! Sets the Compare Output Mode bits for the specified comparator.
+   template <char Comparator>
+   static void set_com(uint8_t com) {
+      static_assert(Comparator == 'A' || Comparator == 'B', "layout 2 only has comparators A and B");
+      constexpr uint8_t shift{Comparator == 'A' ? 6 : 4};
+      timer_counter_control_registers_raw<Index>::a = static_cast<uint8_t>(
+         (timer_counter_control_registers_raw<Index>::a & ~(0b11 << shift)) | (com << shift)
+      );
+   }
+
+   //! Returns the Waveform Generation Mode bits.
+   static uint8_t get_wgm() {
+      return static_cast<uint8_t>(
+         (timer_counter_control_registers_raw<Index>::a & 0b011) |
+         ((timer_counter_control_registers_raw<Index>::b >> 1) & 0b100)
+      );
+   }
+
+   //! Sets the Waveform Generation Mode bits.
+   static void set_wgm(uint8_t wgm) {
+      timer_counter_control_registers_raw<Index>::a = static_cast<uint8_t>(
+         (timer_counter_control_registers_raw<Index>::a & 0b11111100) | (wgm & 0b011)
+      );
+      timer_counter_control_registers_raw<Index>::b = static_cast<uint8_t>(
+         (timer_counter_control_registers_raw<Index>::b & 0b11110111) | ((wgm & 0b100) << 1)
+      );
+   }
 };
 
 /* TCCR layout 3: two Output Compare Units + one Input Capture Unit, four WGM bits:
@@ -119,12 +183,91 @@ struct timer_counter_control_registers<Index, Mask_cs, 2> : timer_counter_contro
    TCCRnC  FOCnA FOCnB - - - - - - */
 template <int Index, uint8_t Mask_cs>
 struct timer_counter_control_registers<Index, Mask_cs, 3> : timer_counter_control_registers_raw<Index> {
+   //! Returns the Clock Select bits.
+   static uint8_t get_cs() {
+      return static_cast<uint8_t>(timer_counter_control_registers_raw<Index>::b & Mask_cs);
+   }
+
    static void set_cs(uint8_t cs) {
       timer_counter_control_registers_raw<Index>::b =
          (timer_counter_control_registers_raw<Index>::b & static_cast<uint8_t>(~Mask_cs)) | cs;
    }
+
+   //! Sets the Compare Output Mode bits for the specified comparator.
+   template <char Comparator>
+   static void set_com(uint8_t com) {
+      static_assert(Comparator == 'A' || Comparator == 'B', "layout 3 only has comparators A and B");
+      constexpr uint8_t shift{Comparator == 'A' ? 6 : 4};
+      timer_counter_control_registers_raw<Index>::a = static_cast<uint8_t>(
+         (timer_counter_control_registers_raw<Index>::a & ~(0b11 << shift)) | (com << shift)
+      );
+   }
+
+   //! Returns the Waveform Generation Mode bits.
+   static uint8_t get_wgm() {
+      return static_cast<uint8_t>(
+         (timer_counter_control_registers_raw<Index>::a & 0b0011) |
+         ((timer_counter_control_registers_raw<Index>::b >> 1) & 0b1100)
+      );
+   }
+
+   //! Sets the Waveform Generation Mode bits.
+   static void set_wgm(uint8_t wgm) {
+      timer_counter_control_registers_raw<Index>::a = static_cast<uint8_t>(
+         (timer_counter_control_registers_raw<Index>::a & 0b11111100) | (wgm & 0b0011)
+      );
+      timer_counter_control_registers_raw<Index>::b = static_cast<uint8_t>(
+         (timer_counter_control_registers_raw<Index>::b & 0b11100111) | ((wgm & 0b1100) << 1)
+      );
+   }
+};
+
+/*! Prescalers available for each timer/counter, listed in order of CSn[2:0] value starting from 0b001, so
+that the CSn[2:0] bits for values[i] are i + 1. Allows to search for a prescaler at run time. */
+template <int Index>
+struct timer_counter_prescaler_list;
+
+//! Input Capture Unit of timer/counters that have one; ICRn can also be used as TOP for PWM.
+template <int Index>
+struct timer_counter_input_capture {
+   // Check for just any value known to be false.
+   static_assert(Index < 0, "the selected MCU does not seem to have an input capture unit for this timer");
 };
 
+/*! Pin driven by each Output Compare Unit. avr-libc doesn’t define these, so they need to be specialized for
+each MCU. */
+template <int Index, char Comparator>
+struct timer_counter_output_compare_pin {
+   // Check for just any value known to be false.
+   static_assert(!Comparator, "unknown output compare pin for the selected MCU and timer/comparator");
+};
+
+#define _RAWR_SPECIALIZE_TIMER_COUNTER_OUTPUT_COMPARE_PIN(index, comparator, port, pin) \
+   template <> \
+   struct timer_counter_output_compare_pin<index, comparator> : io_port_pin<port, pin> { \
+   };
+#if defined(__AVR_ATmega48__) || defined(__AVR_ATmega48A__) || defined(__AVR_ATmega48P__) || \
+    defined(__AVR_ATmega48PA__) || defined(__AVR_ATmega88__) || defined(__AVR_ATmega88A__) || \
+    defined(__AVR_ATmega88P__) || defined(__AVR_ATmega88PA__) || defined(__AVR_ATmega168__) || \
+    defined(__AVR_ATmega168A__) || defined(__AVR_ATmega168P__) || defined(__AVR_ATmega168PA__) || \
+    defined(__AVR_ATmega328__) || defined(__AVR_ATmega328P__)
+   _RAWR_SPECIALIZE_TIMER_COUNTER_OUTPUT_COMPARE_PIN(0, 'A', 'D', 6)
+   _RAWR_SPECIALIZE_TIMER_COUNTER_OUTPUT_COMPARE_PIN(0, 'B', 'D', 5)
+   _RAWR_SPECIALIZE_TIMER_COUNTER_OUTPUT_COMPARE_PIN(1, 'A', 'B', 1)
+   _RAWR_SPECIALIZE_TIMER_COUNTER_OUTPUT_COMPARE_PIN(1, 'B', 'B', 2)
+   _RAWR_SPECIALIZE_TIMER_COUNTER_OUTPUT_COMPARE_PIN(2, 'A', 'B', 3)
+   _RAWR_SPECIALIZE_TIMER_COUNTER_OUTPUT_COMPARE_PIN(2, 'B', 'D', 3)
+#elif defined(__AVR_ATtiny2313__) || defined(__AVR_ATtiny2313A__) || defined(__AVR_ATtiny4313__)
+   _RAWR_SPECIALIZE_TIMER_COUNTER_OUTPUT_COMPARE_PIN(0, 'A', 'B', 2)
+   _RAWR_SPECIALIZE_TIMER_COUNTER_OUTPUT_COMPARE_PIN(0, 'B', 'D', 5)
+   _RAWR_SPECIALIZE_TIMER_COUNTER_OUTPUT_COMPARE_PIN(1, 'A', 'B', 3)
+   _RAWR_SPECIALIZE_TIMER_COUNTER_OUTPUT_COMPARE_PIN(1, 'B', 'B', 4)
+#elif defined(__AVR_ATtiny25__) || defined(__AVR_ATtiny45__) || defined(__AVR_ATtiny85__)
+   _RAWR_SPECIALIZE_TIMER_COUNTER_OUTPUT_COMPARE_PIN(0, 'A', 'B', 0)
+   _RAWR_SPECIALIZE_TIMER_COUNTER_OUTPUT_COMPARE_PIN(0, 'B', 'B', 1)
+#endif
+#undef _RAWR_SPECIALIZE_TIMER_COUNTER_OUTPUT_COMPARE_PIN
+
 //! Timer/counter abstraction; provides a uniform interface for all timer/counter units on AVR MCUs.
 template <int Index>
 struct timer_counter {
@@ -132,11 +275,16 @@ struct timer_counter {
    static_assert(Index < 0, "the selected MCU does not seem to have this timer");
 };
 
-#define _RAWR_SPECIALIZE_TIMER_COUNTER(index) \
+#define _RAWR_SPECIALIZE_TIMER_COUNTER(index, timsk, tifr) \
    template <> \
    struct timer_counter<index> { \
       static constexpr decltype(RAWR_CPP_CAT2(TCNT, index)) value{}; \
       using value_type = decltype(value)::type; \
+      /* Some MCUs have one TIMSKn/TIFRn per timer/counter, others a single TIMSK/TIFR shared by all. */ \
+      static constexpr decltype(timsk) interrupt_mask{}; \
+      static constexpr decltype(tifr) interrupt_flags{}; \
+      static constexpr uint8_t overflow_interrupt_enable_bit{RAWR_CPP_CAT2(TOIE, index)}; \
+      static constexpr uint8_t overflow_flag_bit{RAWR_CPP_CAT2(TOV, index)}; \
       static constexpr timer_counter_control_registers< \
          index, \
          _BV(RAWR_CPP_CAT3(CS, index, 2)) | _BV(RAWR_CPP_CAT3(CS, index, 1)) | _BV(RAWR_CPP_CAT3(CS, index, 0)) \
@@ -158,6 +306,7 @@ struct timer_counter {
    template <> \
    struct timer_counter<index>::comparators<comparator> { \
       static constexpr uint8_t interrupt_enable_bit = RAWR_CPP_CAT3(OCIE, index, comp_unquoted); \
+      static constexpr uint8_t flag_bit = RAWR_CPP_CAT3(OCF, index, comp_unquoted); \
       static constexpr decltype(RAWR_CPP_CAT3(OCR, index, comp_unquoted)) top{}; \
    };
 #define _RAWR_SPECIALIZE_TIMER_COUNTER_PRESCALER(index, prescaler, cr_bits) \
@@ -165,6 +314,16 @@ struct timer_counter {
    struct timer_counter<index>::prescalers<prescaler> { \
       static constexpr uint8_t control_register_bits = cr_bits; \
    };
+#define _RAWR_SPECIALIZE_TIMER_COUNTER_PRESCALER_LIST(index, ...) \
+   template <> \
+   struct timer_counter_prescaler_list<index> { \
+      static constexpr uint16_t values[]{__VA_ARGS__}; \
+   };
+#define _RAWR_SPECIALIZE_TIMER_COUNTER_INPUT_CAPTURE(index) \
+   template <> \
+   struct timer_counter_input_capture<index> { \
+      static constexpr decltype(RAWR_CPP_CAT2(ICR, index)) value{}; \
+   };
 #ifdef TCNT0
    #ifdef OCR0A
       #ifdef OCR0B
@@ -179,13 +338,20 @@ struct timer_counter {
    #else
       #error "unknown TCCR layout for timer/counter 0"
    #endif
-   _RAWR_SPECIALIZE_TIMER_COUNTER(0)
+   #ifdef TIMSK0
+      _RAWR_SPECIALIZE_TIMER_COUNTER(0, TIMSK0, TIFR0)
+   #else
+      _RAWR_SPECIALIZE_TIMER_COUNTER(0, TIMSK, TIFR)
+   #endif
    #ifdef OCR0A
       _RAWR_SPECIALIZE_TIMER_COUNTER_COMPARATOR(0, 'A', A)
    #endif
    #ifdef OCR0B
       _RAWR_SPECIALIZE_TIMER_COUNTER_COMPARATOR(0, 'B', B)
    #endif
+   #ifdef ICR0
+      _RAWR_SPECIALIZE_TIMER_COUNTER_INPUT_CAPTURE(0)
+   #endif
    #ifdef T0_PIN
       _RAWR_SPECIALIZE_TIMER_COUNTER_PRESCALER(0,    1,        0  |        0  | _BV(CS00))
       _RAWR_SPECIALIZE_TIMER_COUNTER_PRESCALER(0,    8,        0  | _BV(CS01) |        0 )
@@ -193,6 +359,7 @@ struct timer_counter {
       _RAWR_SPECIALIZE_TIMER_COUNTER_PRESCALER(0,  256, _BV(CS02) |        0  |        0 )
       _RAWR_SPECIALIZE_TIMER_COUNTER_PRESCALER(0, 1024, _BV(CS02) |        0  | _BV(CS00))
       // 110 and 111 use T0 as clock source.
+      _RAWR_SPECIALIZE_TIMER_COUNTER_PRESCALER_LIST(0, 1, 8, 64, 256, 1024)
    #else
       _RAWR_SPECIALIZE_TIMER_COUNTER_PRESCALER(0,    1,        0  |        0  | _BV(CS00))
       _RAWR_SPECIALIZE_TIMER_COUNTER_PRESCALER(0,    8,        0  | _BV(CS01) |        0 )
@@ -201,6 +368,7 @@ struct timer_counter {
       _RAWR_SPECIALIZE_TIMER_COUNTER_PRESCALER(0,  128, _BV(CS02) |        0  | _BV(CS00))
       _RAWR_SPECIALIZE_TIMER_COUNTER_PRESCALER(0,  256, _BV(CS02) | _BV(CS01) |        0 )
       _RAWR_SPECIALIZE_TIMER_COUNTER_PRESCALER(0, 1024, _BV(CS02) | _BV(CS01) | _BV(CS00))
+      _RAWR_SPECIALIZE_TIMER_COUNTER_PRESCALER_LIST(0, 1, 8, 32, 64, 128, 256, 1024)
    #endif
 #endif
 #ifdef TCNT1
@@ -217,13 +385,20 @@ struct timer_counter {
    #else
       #error "unknown TCCR layout for timer/counter 1"
    #endif
-   _RAWR_SPECIALIZE_TIMER_COUNTER(1)
+   #ifdef TIMSK1
+      _RAWR_SPECIALIZE_TIMER_COUNTER(1, TIMSK1, TIFR1)
+   #else
+      _RAWR_SPECIALIZE_TIMER_COUNTER(1, TIMSK, TIFR)
+   #endif
    #ifdef OCR1A
       _RAWR_SPECIALIZE_TIMER_COUNTER_COMPARATOR(1, 'A', A)
    #endif
    #ifdef OCR1B
       _RAWR_SPECIALIZE_TIMER_COUNTER_COMPARATOR(1, 'B', B)
    #endif
+   #ifdef ICR1
+      _RAWR_SPECIALIZE_TIMER_COUNTER_INPUT_CAPTURE(1)
+   #endif
    #ifdef T1_PIN
       _RAWR_SPECIALIZE_TIMER_COUNTER_PRESCALER(1,    1,        0  |        0  | _BV(CS10))
       _RAWR_SPECIALIZE_TIMER_COUNTER_PRESCALER(1,    8,        0  | _BV(CS11) |        0 )
@@ -231,6 +406,7 @@ struct timer_counter {
       _RAWR_SPECIALIZE_TIMER_COUNTER_PRESCALER(1,  256, _BV(CS12) |        0  |        0 )
       _RAWR_SPECIALIZE_TIMER_COUNTER_PRESCALER(1, 1024, _BV(CS12) |        0  | _BV(CS10))
       // 110 and 111 use T1 as clock source.
+      _RAWR_SPECIALIZE_TIMER_COUNTER_PRESCALER_LIST(1, 1, 8, 64, 256, 1024)
    #else
       _RAWR_SPECIALIZE_TIMER_COUNTER_PRESCALER(1,    1,        0  |        0  | _BV(CS10))
       _RAWR_SPECIALIZE_TIMER_COUNTER_PRESCALER(1,    8,        0  | _BV(CS11) |        0 )
@@ -239,6 +415,7 @@ struct timer_counter {
       _RAWR_SPECIALIZE_TIMER_COUNTER_PRESCALER(1,  128, _BV(CS12) |        0  | _BV(CS10))
       _RAWR_SPECIALIZE_TIMER_COUNTER_PRESCALER(1,  256, _BV(CS12) | _BV(CS11) |        0 )
       _RAWR_SPECIALIZE_TIMER_COUNTER_PRESCALER(1, 1024, _BV(CS12) | _BV(CS11) | _BV(CS10))
+      _RAWR_SPECIALIZE_TIMER_COUNTER_PRESCALER_LIST(1, 1, 8, 32, 64, 128, 256, 1024)
    #endif
 #endif
 #ifdef TCNT2
@@ -255,13 +432,20 @@ struct timer_counter {
    #else
       #error "unknown TCCR layout for timer/counter 2"
    #endif
-   _RAWR_SPECIALIZE_TIMER_COUNTER(2)
+   #ifdef TIMSK2
+      _RAWR_SPECIALIZE_TIMER_COUNTER(2, TIMSK2, TIFR2)
+   #else
+      _RAWR_SPECIALIZE_TIMER_COUNTER(2, TIMSK, TIFR)
+   #endif
    #ifdef OCR2A
       _RAWR_SPECIALIZE_TIMER_COUNTER_COMPARATOR(2, 'A', A)
    #endif
    #ifdef OCR2B
       _RAWR_SPECIALIZE_TIMER_COUNTER_COMPARATOR(2, 'B', B)
    #endif
+   #ifdef ICR2
+      _RAWR_SPECIALIZE_TIMER_COUNTER_INPUT_CAPTURE(2)
+   #endif
    #ifdef T2_PIN
       _RAWR_SPECIALIZE_TIMER_COUNTER_PRESCALER(2,    1,        0  |        0  | _BV(CS20))
       _RAWR_SPECIALIZE_TIMER_COUNTER_PRESCALER(2,    8,        0  | _BV(CS21) |        0 )
@@ -269,6 +453,7 @@ struct timer_counter {
       _RAWR_SPECIALIZE_TIMER_COUNTER_PRESCALER(2,  256, _BV(CS22) |        0  |        0 )
       _RAWR_SPECIALIZE_TIMER_COUNTER_PRESCALER(2, 1024, _BV(CS22) |        0  | _BV(CS20))
       // 110 and 111 use T2 as clock source.
+      _RAWR_SPECIALIZE_TIMER_COUNTER_PRESCALER_LIST(2, 1, 8, 64, 256, 1024)
    #else
       _RAWR_SPECIALIZE_TIMER_COUNTER_PRESCALER(2,    1,        0  |        0  | _BV(CS20))
       _RAWR_SPECIALIZE_TIMER_COUNTER_PRESCALER(2,    8,        0  | _BV(CS21) |        0 )
@@ -277,6 +462,7 @@ struct timer_counter {
       _RAWR_SPECIALIZE_TIMER_COUNTER_PRESCALER(2,  128, _BV(CS22) |        0  | _BV(CS20))
       _RAWR_SPECIALIZE_TIMER_COUNTER_PRESCALER(2,  256, _BV(CS22) | _BV(CS21) |        0 )
       _RAWR_SPECIALIZE_TIMER_COUNTER_PRESCALER(2, 1024, _BV(CS22) | _BV(CS21) | _BV(CS20))
+      _RAWR_SPECIALIZE_TIMER_COUNTER_PRESCALER_LIST(2, 1, 8, 32, 64, 128, 256, 1024)
    #endif
 #endif
 
@@ -289,5 +475,7 @@ struct timer_counter {
 #undef _RAWR_SPECIALIZE_TIMER_COUNTER_CONTROL_REGISTERS_AB
 #undef _RAWR_SPECIALIZE_TIMER_COUNTER_CONTROL_REGISTERS_ABC
 #undef _RAWR_SPECIALIZE_TIMER_COUNTER_PRESCALER
+#undef _RAWR_SPECIALIZE_TIMER_COUNTER_PRESCALER_LIST
+#undef _RAWR_SPECIALIZE_TIMER_COUNTER_INPUT_CAPTURE
 
 }} //namespace rawr::hw
@@ -0,0 +1,108 @@
+/* -*- coding: utf-8; mode: c++; tab-width: 3; indent-tabs-mode: nil -*-
+
+Copyright 2022 Raffaello D. Di Napoli
+
+This file is part of RAWR.
+
+RAWR is free software: you can redistribute it and/or modify it under the terms of version 2.1 of the GNU
+Lesser General Public License as published by the Free Software Foundation.
+
+RAWR is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for
+more details.
+------------------------------------------------------------------------------------------------------------*/
+
+#pragma once
+
+#include <rawr/hw/io.hxx>
+#include <rawr/misc.hxx>
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace rawr { namespace hw {
+
+/*! USART abstraction; provides a uniform interface for the USARTs of AVR MCUs, whether their registers and
+bits are numbered (UCSR0A, U2X0) or not (UCSRA, U2X, on MCUs with a single USART). */
+template <int Index>
+struct usart {
+   // Check for just any value known to be false.
+   static_assert(Index < 0, "the selected MCU does not seem to have this USART");
+};
+
+// Specializations need to be done via macro due to register names; suffix is empty for unnumbered USARTs.
+#define _RAWR_SPECIALIZE_USART(index, suffix) \
+   template <> \
+   struct usart<index> { \
+      static constexpr decltype(RAWR_CPP_CAT3(UCSR, suffix, A)) control_status_a{}; \
+      static constexpr decltype(RAWR_CPP_CAT3(UCSR, suffix, B)) control_status_b{}; \
+      /* Not necessarily adjacent to the low byte, so not accessed as a single 16-bit register. */ \
+      static constexpr decltype(RAWR_CPP_CAT3(UBRR, suffix, H)) baud_rate_high{}; \
+      static constexpr decltype(RAWR_CPP_CAT3(UBRR, suffix, L)) baud_rate_low{}; \
+      static constexpr decltype(RAWR_CPP_CAT2(UDR, suffix)) data{}; \
+      \
+      /* UCSRnA */ \
+      static constexpr uint8_t receive_complete_bit{RAWR_CPP_CAT2(RXC, suffix)}; \
+      static constexpr uint8_t transmit_complete_bit{RAWR_CPP_CAT2(TXC, suffix)}; \
+      static constexpr uint8_t data_register_empty_bit{RAWR_CPP_CAT2(UDRE, suffix)}; \
+      static constexpr uint8_t frame_error_bit{RAWR_CPP_CAT2(FE, suffix)}; \
+      static constexpr uint8_t data_overrun_bit{RAWR_CPP_CAT2(DOR, suffix)}; \
+      static constexpr uint8_t double_speed_bit{RAWR_CPP_CAT2(U2X, suffix)}; \
+      /* UCSRnB */ \
+      static constexpr uint8_t receive_complete_interrupt_enable_bit{RAWR_CPP_CAT2(RXCIE, suffix)}; \
+      static constexpr uint8_t data_register_empty_interrupt_enable_bit{RAWR_CPP_CAT2(UDRIE, suffix)}; \
+      static constexpr uint8_t receiver_enable_bit{RAWR_CPP_CAT2(RXEN, suffix)}; \
+      static constexpr uint8_t transmitter_enable_bit{RAWR_CPP_CAT2(TXEN, suffix)}; \
+   };
+#if defined(UDR0)
+   _RAWR_SPECIALIZE_USART(0, 0)
+#elif defined(UDR)
+   _RAWR_SPECIALIZE_USART(0, )
+#endif
+#ifdef UDR1
+   _RAWR_SPECIALIZE_USART(1, 1)
+#endif
+#ifdef UDR2
+   _RAWR_SPECIALIZE_USART(2, 2)
+#endif
+#ifdef UDR3
+   _RAWR_SPECIALIZE_USART(3, 3)
+#endif
+#undef _RAWR_SPECIALIZE_USART
+
+/*! Computes at compile time the UBRRn value and U2Xn bit for a baud rate, given F_CPU. Double speed is only
+used if normal speed can’t get within max_error_permille of Baud, since it halves the receiver’s tolerance to
+clock mismatches; if neither can, compilation fails. */
+template <uint32_t Baud>
+class usart_baud_rate {
+private:
+   static constexpr uint32_t f_cpu{static_cast<uint32_t>(F_CPU)};
+
+   //! Returns the UBRRn value giving the baud rate closest to Baud, with the specified samples per bit.
+   static constexpr uint32_t ubrr(uint32_t samples) {
+      auto divisor{int_round_div(f_cpu, samples * Baud)};
+      return divisor > 0 ? divisor - 1 : 0;
+   }
+
+   //! Returns the deviation of the actual baud rate from Baud, in thousandths.
+   static constexpr uint32_t error_permille(uint32_t samples) {
+      auto actual{f_cpu / (samples * (ubrr(samples) + 1))};
+      return (actual > Baud ? actual - Baud : Baud - actual) * 1000 / Baud;
+   }
+
+public:
+   //! Maximum deviation from Baud accepted, in thousandths; ±2% is what both ends together can tolerate.
+   static constexpr uint32_t max_error_permille{20};
+   //! true if U2Xn needs to be set.
+   static constexpr bool double_speed{
+      error_permille(16) > max_error_permille && error_permille(8) < error_permille(16)
+   };
+   //! Value for UBRRn.
+   static constexpr uint16_t ubrr_value{static_cast<uint16_t>(ubrr(double_speed ? 8 : 16))};
+
+   static_assert(ubrr(double_speed ? 8 : 16) <= 0x0fff, "baud rate too low for F_CPU");
+   static_assert(
+      error_permille(double_speed ? 8 : 16) <= max_error_permille, "baud rate can’t be generated from F_CPU"
+   );
+};
+
+}} //namespace rawr::hw
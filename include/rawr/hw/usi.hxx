@@ -0,0 +1,59 @@
+/* -*- coding: utf-8; mode: c++; tab-width: 3; indent-tabs-mode: nil -*-
+
+Copyright 2022 Raffaello D. Di Napoli
+
+This file is part of RAWR.
+
+RAWR is free software: you can redistribute it and/or modify it under the terms of version 2.1 of the GNU
+Lesser General Public License as published by the Free Software Foundation.
+
+RAWR is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for
+more details.
+------------------------------------------------------------------------------------------------------------*/
+
+#pragma once
+
+#include <rawr/hw/io.hxx>
+#include <rawr/hw/io_port.hxx>
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace rawr { namespace hw {
+
+//! Universal Serial Interface abstraction. Index is always 0, since no AVR MCU has more than one USI.
+template <int Index>
+struct usi {
+   // Check for just any value known to be false.
+   static_assert(Index < 0, "the selected MCU does not seem to have this USI, or its pins are unknown");
+};
+
+/* Specializations need to be done via macro, since avr-libc doesn’t define the pins used by the USI, so they
+need to be specified for each MCU. */
+#define _RAWR_SPECIALIZE_USI(do_port, do_pin) \
+   template <> \
+   struct usi<0> { \
+      static constexpr decltype(USICR) control{}; \
+      static constexpr decltype(USISR) status{}; \
+      static constexpr decltype(USIDR) data{}; \
+      \
+      /* USICR */ \
+      static constexpr uint8_t overflow_interrupt_enable_bit{USIOIE}; \
+      static constexpr uint8_t wire_mode_0_bit{USIWM0}; \
+      static constexpr uint8_t clock_select_0_bit{USICS0}; \
+      /* USISR */ \
+      static constexpr uint8_t overflow_flag_bit{USIOIF}; \
+      \
+      /* Data output (DO) pin in three-wire mode. */ \
+      typedef io_port_pin<do_port, do_pin> data_output_pin; \
+   };
+#if defined(__AVR_ATtiny25__) || defined(__AVR_ATtiny45__) || defined(__AVR_ATtiny85__)
+   _RAWR_SPECIALIZE_USI('B', 1)
+#elif defined(__AVR_ATtiny24__) || defined(__AVR_ATtiny44__) || defined(__AVR_ATtiny84__)
+   _RAWR_SPECIALIZE_USI('A', 5)
+#elif defined(__AVR_ATtiny2313__) || defined(__AVR_ATtiny2313A__) || defined(__AVR_ATtiny4313__)
+   _RAWR_SPECIALIZE_USI('B', 6)
+#endif
+#undef _RAWR_SPECIALIZE_USI
+
+}} //namespace rawr::hw
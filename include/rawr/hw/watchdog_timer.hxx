@@ -15,7 +15,11 @@ more details.
 #pragma once
 
 #include <rawr/hw/io.hxx>
-#include <avr/wdt.h>
+#ifdef RAWR_HOST
+   #include <rawr/host.hxx>
+#else
+   #include <avr/wdt.h>
+#endif
 
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
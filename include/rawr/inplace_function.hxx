@@ -0,0 +1,191 @@
+/* -*- coding: utf-8; mode: c++; tab-width: 3; indent-tabs-mode: nil -*-
+
+Copyright 2022 Raffaello D. Di Napoli
+
+This file is part of RAWR.
+
+RAWR is free software: you can redistribute it and/or modify it under the terms of version 2.1 of the GNU
+Lesser General Public License as published by the Free Software Foundation.
+
+RAWR is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for
+more details.
+------------------------------------------------------------------------------------------------------------*/
+
+#pragma once
+
+#include <inttypes.h>
+#include <rawr/misc.hxx>
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace rawr {
+
+/*! Alternative to rawr::function that stores lambdas of up to Capacity bytes, so that each use site can be
+sized for the lambdas it actually gets, instead of every rawr::function in the binary being sized for the
+largest one.
+
+There’s no vtable: each instance stores a pointer to an invoker function, and a pointer to a manager function
+that copies, moves and destructs the lambda. For lambdas that are trivially copyable and destructible, which
+includes any lambda only capturing references or pointers, the manager pointer is nullptr and copies are done
+byte by byte, so the invoker is the only function generated for them. */
+template <typename F, unsigned Capacity = sizeof(void *)>
+class inplace_function;
+
+template <typename Ret, typename... Args, unsigned Capacity>
+class inplace_function<Ret (Args...), Capacity> {
+private:
+   enum class operation : uint8_t {
+      copy,
+      move,
+      destruct
+   };
+
+   typedef Ret (* invoker_t)(void const * storage, Args... args);
+   typedef void (* manager_t)(operation op, void * dst_storage, void * src_storage);
+
+   template <typename L>
+   struct lambda_ops {
+      static Ret invoke(void const * storage, Args... args) {
+         return (*static_cast<L const *>(storage))(args...);
+      }
+
+      static void manage(operation op, void * dst_storage, void * src_storage) {
+         auto lambda{static_cast<L *>(src_storage)};
+         switch (op) {
+            case operation::copy:
+               new(dst_storage) L{*lambda};
+               break;
+            case operation::move:
+               new(dst_storage) L{rawr::move(*lambda)};
+               lambda->~L();
+               break;
+            case operation::destruct:
+               lambda->~L();
+               break;
+         }
+      }
+
+      static constexpr bool trivial{__is_trivially_copyable(L) && __has_trivial_destructor(L)};
+   };
+
+public:
+   constexpr inplace_function() :
+      invoker{nullptr},
+      manager{nullptr} {
+   }
+
+   constexpr inplace_function(decltype(nullptr)) :
+      inplace_function{} {
+   }
+
+   inplace_function(inplace_function && src) :
+      invoker{src.invoker},
+      manager{src.manager} {
+      move_from(src);
+   }
+
+   inplace_function(inplace_function const & src) :
+      invoker{src.invoker},
+      manager{src.manager} {
+      copy_from(src);
+   }
+
+   template <
+      typename L,
+      typename LT = typename remove_cv<typename remove_reference<L>::type>::type,
+      typename = typename enable_if<!__is_same(LT, inplace_function)>::type
+   >
+   /*implicit*/ inplace_function(L && lambda) :
+      invoker{&lambda_ops<LT>::invoke},
+      manager{lambda_ops<LT>::trivial ? nullptr : &lambda_ops<LT>::manage} {
+      static_assert(sizeof(LT) <= Capacity, "lambda exceeds the capacity of this inplace_function");
+      static_assert(alignof(LT) <= __BIGGEST_ALIGNMENT__, "lambda is over-aligned for inplace_function");
+      new(storage) LT{forward<L>(lambda)};
+   }
+
+   ~inplace_function() {
+      destruct();
+   }
+
+   inplace_function & operator=(inplace_function && src) {
+      if (&src != this) {
+         destruct();
+         invoker = src.invoker;
+         manager = src.manager;
+         move_from(src);
+      }
+      return *this;
+   }
+
+   inplace_function & operator=(inplace_function const & src) {
+      if (&src != this) {
+         destruct();
+         invoker = src.invoker;
+         manager = src.manager;
+         copy_from(src);
+      }
+      return *this;
+   }
+
+   inplace_function & operator=(decltype(nullptr)) {
+      destruct();
+      invoker = nullptr;
+      manager = nullptr;
+      return *this;
+   }
+
+   explicit constexpr operator bool() const {
+      return invoker != nullptr;
+   }
+
+   constexpr bool operator==(decltype(nullptr)) const {
+      return invoker == nullptr;
+   }
+
+   constexpr bool operator!=(decltype(nullptr)) const {
+      return invoker != nullptr;
+   }
+
+   Ret operator()(Args... args) const {
+      return invoker(storage, args...);
+   }
+
+private:
+   //! Copies the lambda from src; invoker and manager must have already been copied.
+   void copy_from(inplace_function const & src) {
+      if (manager) {
+         manager(operation::copy, storage, const_cast<uint8_t *>(src.storage));
+      } else if (invoker) {
+         trivial_copy<Capacity>(src.storage, storage);
+      }
+   }
+
+   //! Moves the lambda from src, leaving it empty; invoker and manager must have already been copied.
+   void move_from(inplace_function & src) {
+      if (manager) {
+         manager(operation::move, storage, src.storage);
+      } else if (invoker) {
+         trivial_copy<Capacity>(src.storage, storage);
+      }
+      src.invoker = nullptr;
+      src.manager = nullptr;
+   }
+
+   //! Destructs the lambda, if it needs that; leaves invoker and manager unchanged.
+   void destruct() {
+      if (manager) {
+         manager(operation::destruct, nullptr, storage);
+      }
+   }
+
+private:
+   //! Calls the lambda; nullptr if *this is empty.
+   invoker_t invoker;
+   //! Copies, moves or destructs the lambda; nullptr if it’s empty or trivial.
+   manager_t manager;
+   //! Aligned for any lambda; on AVR this is 1, so it costs nothing.
+   alignas(__BIGGEST_ALIGNMENT__) uint8_t storage[Capacity];
+};
+
+} //namespace rawr
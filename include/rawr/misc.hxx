@@ -14,6 +14,8 @@ more details.
 
 #pragma once
 
+#include <inttypes.h>
+
 #define _RAWR_TOSTRING(x) #x
 #define RAWR_TOSTRING(x) _RAWR_TOSTRING(x)
 
@@ -47,6 +49,10 @@ more details.
 
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+#ifdef RAWR_HOST
+   // The host’s C++ library has these, and test code may well pull them in.
+   #include <new>
+#else
 // Placement new and delete (C++11 § 18.6.1.3 “Placement forms”).
 inline void * operator new(decltype(sizeof 0), void * p) {
    return p;
@@ -61,6 +67,7 @@ inline void operator delete(void *, void *) {
 
 inline void operator delete[](void *, void *) {
 }
+#endif
 
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -257,6 +264,16 @@ inline constexpr T1 int_round_div(T1 dividend, T2 divisor) {
    return (dividend + divisor / 2) / divisor;
 }
 
+//! Returns the greatest common divisor of a and b.
+inline constexpr uint32_t gcd(uint32_t a, uint32_t b) {
+   return b == 0 ? a : gcd(b, a % b);
+}
+
+//! Returns the base-2 logarithm of n, rounded down; n must not be 0.
+inline constexpr uint8_t int_log2(uint32_t n) {
+   return n <= 1 ? 0 : static_cast<uint8_t>(1 + int_log2(n >> 1));
+}
+
 template <unsigned Size>
 inline void trivial_copy(void const * src_v, void * dst_v) {
    auto dst{static_cast<uint8_t *>(dst_v)}, dst_end{dst + Size};
@@ -0,0 +1,326 @@
+/* -*- coding: utf-8; mode: c++; tab-width: 3; indent-tabs-mode: nil -*-
+
+Copyright 2022 Raffaello D. Di Napoli
+
+This file is part of RAWR.
+
+RAWR is free software: you can redistribute it and/or modify it under the terms of version 2.1 of the GNU
+Lesser General Public License as published by the Free Software Foundation.
+
+RAWR is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for
+more details.
+------------------------------------------------------------------------------------------------------------*/
+
+#pragma once
+
+#include <rawr/alias.hxx>
+#include <rawr/binary_output_pin_aggregator.hxx>
+#include <rawr/chrono.hxx>
+#include <rawr/hw/timer_counter.hxx>
+#include <rawr/power_manager.hxx>
+#include <rawr/pwm_output.hxx>
+#include <rawr/seven_segment_display.hxx>
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace rawr { namespace _pvt {
+
+template <int Index, char Comparator>
+struct seven_segment_scan_asm;
+
+#define _RAWR_SPECIALIZE_SEVEN_SEGMENT_SCAN_ASM_IMPL(index, comparator_ascii, vector, prefix) \
+   template <> \
+   struct seven_segment_scan_asm<index, comparator_ascii> { \
+      static void emit() { \
+         RAWR_ALIAS(RAWR_TOSTRING(vector), prefix "EE8__vectorEv"); \
+      } \
+   };
+#define _RAWR_SPECIALIZE_SEVEN_SEGMENT_SCAN_ASM(index, comparator_ascii, vector) \
+   _RAWR_SPECIALIZE_SEVEN_SEGMENT_SCAN_ASM_IMPL( \
+      index, comparator_ascii, vector, \
+      "_ZN4rawr4_pvt25seven_segment_scan_vectorILi" RAWR_TOSTRING(index) \
+         "ELc" RAWR_TOSTRING(comparator_ascii) \
+   )
+#ifdef TIMER0_COMPA_vect
+   _RAWR_SPECIALIZE_SEVEN_SEGMENT_SCAN_ASM(0, 65 /*A*/, TIMER0_COMPA_vect)
+#endif
+#ifdef TIMER0_COMPB_vect
+   _RAWR_SPECIALIZE_SEVEN_SEGMENT_SCAN_ASM(0, 66 /*B*/, TIMER0_COMPB_vect)
+#endif
+#ifdef TIMER1_COMPA_vect
+   _RAWR_SPECIALIZE_SEVEN_SEGMENT_SCAN_ASM(1, 65 /*A*/, TIMER1_COMPA_vect)
+#endif
+#ifdef TIMER1_COMPB_vect
+   _RAWR_SPECIALIZE_SEVEN_SEGMENT_SCAN_ASM(1, 66 /*B*/, TIMER1_COMPB_vect)
+#endif
+#ifdef TIMER2_COMPA_vect
+   _RAWR_SPECIALIZE_SEVEN_SEGMENT_SCAN_ASM(2, 65 /*A*/, TIMER2_COMPA_vect)
+#endif
+#ifdef TIMER2_COMPB_vect
+   _RAWR_SPECIALIZE_SEVEN_SEGMENT_SCAN_ASM(2, 66 /*B*/, TIMER2_COMPB_vect)
+#endif
+#undef _RAWR_SPECIALIZE_SEVEN_SEGMENT_SCAN_ASM
+#undef _RAWR_SPECIALIZE_SEVEN_SEGMENT_SCAN_ASM_IMPL
+
+/*! Tag type used to find, via ADL, the interrupt handlers of the multiplexed display driven by a
+timer/counter. The functions are only declared here, and defined by the one
+multiplexed_seven_segment_display_impl instantiated for the timer/counter; this allows the interrupt vectors
+to have names that don’t depend on the pins or the number of digits. */
+template <int Index>
+struct seven_segment_scan_tag {
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wnon-template-friend"
+   //! Invoked on compare match A, at the start of each digit’s time slot.
+   friend void seven_segment_scan_next_digit(seven_segment_scan_tag);
+   //! Invoked on compare match B, to end the current digit’s time slot early and dim the display.
+   friend void seven_segment_scan_blank(seven_segment_scan_tag);
+#pragma GCC diagnostic pop
+};
+
+template <int Index, char Comparator>
+class seven_segment_scan_vector {
+private:
+   // Weird name to work around g++ name check for interrupt vectors.
+   static __attribute__((signal, used)) void __vector() {
+      seven_segment_scan_asm<Index, Comparator>::emit();
+      if constexpr (Comparator == 'A') {
+         seven_segment_scan_next_digit(seven_segment_scan_tag<Index>{});
+      } else {
+         seven_segment_scan_blank(seven_segment_scan_tag<Index>{});
+      }
+   }
+};
+
+/*! Frame buffers and interrupt handlers of rawr::multiplexed_seven_segment_display. Everything is static,
+since it’s accessed by the interrupt handlers, and there can only be one display per timer/counter. */
+template <int TimerIndex, typename SegmentPins, typename DigitPins, bool CommonAnode>
+class multiplexed_seven_segment_display_impl :
+   private seven_segment_scan_vector<TimerIndex, 'A'>, private seven_segment_scan_vector<TimerIndex, 'B'> {
+protected:
+   typedef hw::timer_counter<TimerIndex> timer_counter_t;
+   typedef typename timer_counter_t::template comparators<'B'> tc_comp_b;
+   typedef typename DigitPins::word_type digit_word_type;
+
+   static constexpr uint8_t digits_size{DigitPins::word_size};
+   //! Word to write to the digit pins to turn all digits off.
+   static constexpr digit_word_type all_digits_off{
+      static_cast<digit_word_type>(CommonAnode ? 0 : ~digit_word_type{})
+   };
+
+   //! Turns off the current digit, and displays the next one from the front buffer.
+   friend void seven_segment_scan_next_digit(seven_segment_scan_tag<TimerIndex>) {
+      DigitPins{}.set(all_digits_off);
+      auto digit{static_cast<uint8_t>(curr_digit + 1)};
+      if (digit == digits_size) {
+         digit = 0;
+      }
+      curr_digit = digit;
+      if (lit) {
+         auto segments{frames[front][digit]};
+         SegmentPins{}.set(static_cast<uint8_t>(CommonAnode ? ~segments : segments));
+         // The first pin of an aggregator maps to the most significant bit.
+         auto digit_bit{static_cast<digit_word_type>(digit_word_type{1} << (digits_size - 1 - digit))};
+         DigitPins{}.set(static_cast<digit_word_type>(CommonAnode ? digit_bit : ~digit_bit));
+      }
+   }
+
+   //! Turns off the current digit for the rest of its time slot.
+   friend void seven_segment_scan_blank(seven_segment_scan_tag<TimerIndex>) {
+      DigitPins{}.set(all_digits_off);
+   }
+
+protected:
+   //! Front (displayed) and back (written by the application) buffers, holding segments for each digit.
+   static uint8_t frames[2][digits_size];
+   //! Index of the front buffer in frames; the interrupt handler reads it once per digit.
+   static uint8_t volatile front;
+   //! Digit currently being displayed.
+   static uint8_t curr_digit;
+   //! false if the brightness is 0.
+   static bool volatile lit;
+};
+
+template <int TimerIndex, typename SegmentPins, typename DigitPins, bool CommonAnode>
+uint8_t multiplexed_seven_segment_display_impl<TimerIndex, SegmentPins, DigitPins, CommonAnode>::frames
+   [2][digits_size];
+
+template <int TimerIndex, typename SegmentPins, typename DigitPins, bool CommonAnode>
+uint8_t volatile
+   multiplexed_seven_segment_display_impl<TimerIndex, SegmentPins, DigitPins, CommonAnode>::front;
+
+template <int TimerIndex, typename SegmentPins, typename DigitPins, bool CommonAnode>
+uint8_t multiplexed_seven_segment_display_impl<TimerIndex, SegmentPins, DigitPins, CommonAnode>::curr_digit;
+
+template <int TimerIndex, typename SegmentPins, typename DigitPins, bool CommonAnode>
+bool volatile multiplexed_seven_segment_display_impl<TimerIndex, SegmentPins, DigitPins, CommonAnode>::lit;
+
+}} //namespace rawr::_pvt
+
+namespace rawr {
+
+/*! Output generator for a display made of multiple 7-segment digits sharing the same segment pins, each
+digit having its own common anode or cathode pin. Digits are lit one at a time, each for one period of the
+timer/counter, which runs in CTC mode and is entirely dedicated to the display: the interrupt for comparator
+A moves on to the next digit, and the one for comparator B turns it off early to reduce brightness. Since
+the timer/counter needs the I/O clock, the display keeps rawr::power_manager from putting the CPU in
+power-down mode.
+
+SegmentPins and DigitPins are rawr::binary_output_pin_aggregator specializations; the former lists the pins
+for segments A to G, in this order, and the latter one pin for each digit, leftmost first. With CommonAnode ==
+false, segments are lit by driving their pins high and a digit is selected by driving its pin low; with
+CommonAnode == true, the other way around. The decimal point is not managed by this class.
+
+What’s displayed is double-buffered: the application changes the back buffer (only touching RAM), and then
+makes it visible at once with swap(). The write() methods do both.
+
+   using namespace rawr;
+   multiplexed_seven_segment_display<
+      seven_segment_display_decimal_font, 2,
+      binary_output_pin_aggregator<hw::io_port_pin<'B', 0>, …, hw::io_port_pin<'B', 6>>,
+      binary_output_pin_aggregator<hw::io_port_pin<'C', 0>, hw::io_port_pin<'C', 1>>
+   > display{100_Hz};
+   display.write_number(42);
+*/
+template <
+   typename Font, int TimerIndex, typename SegmentPins, typename DigitPins, bool CommonAnode = false
+>
+class multiplexed_seven_segment_display :
+   private _pvt::multiplexed_seven_segment_display_impl<TimerIndex, SegmentPins, DigitPins, CommonAnode>,
+   protected Font {
+private:
+   typedef _pvt::multiplexed_seven_segment_display_impl<
+      TimerIndex, SegmentPins, DigitPins, CommonAnode
+   > impl;
+   typedef typename impl::timer_counter_t timer_counter_t;
+   typedef typename timer_counter_t::template comparators<'A'> tc_comp_a;
+   typedef typename impl::tc_comp_b tc_comp_b;
+   static constexpr int layout{hw::timer_counter_control_registers_layout<TimerIndex>::layout};
+   static_assert(layout != 1, "this timer/counter does not support CTC mode with TOP = OCRnA");
+   static_assert(SegmentPins::word_size == 7, "SegmentPins must list 7 pins, for segments A to G");
+   static constexpr uint16_t max_top{layout == 3 ? 0xffff : 0xff};
+
+public:
+   using font_type = Font;
+   using source_type = typename Font::source_type;
+   //! Number of digits.
+   static constexpr uint8_t size{impl::digits_size};
+
+   //! Wraps a refresh rate known at compile time, so that the search for its timing generates no code.
+   struct constant_refresh_rate {
+      consteval constant_refresh_rate(chrono::hertz refresh_rate) :
+         timing{_pvt::find_pwm_timing<TimerIndex>(
+            chrono::hertz{refresh_rate.count() * size}, pwm_mode::fast, true, max_top
+         )} {
+      }
+
+      _pvt::pwm_timing timing;
+   };
+
+public:
+   /*! Constructor; configures the pins and starts scanning the digits, initially all blank.
+
+   @param refresh_rate
+      Number of times per second each digit is lit; must be a constant expression. Below 50-60 Hz the display
+      will noticeably flicker.
+   @param brightness
+      Fraction of its time slot each digit is lit for, with 0 meaning off and 255 meaning always on.
+   */
+   explicit multiplexed_seven_segment_display(
+      constant_refresh_rate refresh_rate = 100_Hz, uint8_t brightness = 0xff
+   ) {
+      power_manager::power_up(_pvt::timer_counter_power_reduction<TimerIndex>::bit);
+      power_manager::require_io_clock(power_manager::timer_counter_clock(TimerIndex), true);
+      DigitPins{}.set(impl::all_digits_off);
+      DigitPins::configure_outputs();
+      SegmentPins::configure_outputs();
+      top = refresh_rate.timing.top;
+      set_brightness(brightness);
+      // CTC mode, TOP = OCRnA.
+      timer_counter_t::control_registers.set_wgm(layout == 3 ? 4 : 2);
+      tc_comp_a::top = static_cast<typename timer_counter_t::value_type>(top);
+      timer_counter_t::value = 0;
+      timer_counter_t::interrupt_mask.set_bit(tc_comp_a::interrupt_enable_bit);
+      timer_counter_t::control_registers.set_cs(refresh_rate.timing.prescaler_bits);
+   }
+
+   multiplexed_seven_segment_display(multiplexed_seven_segment_display const &) = delete;
+
+   multiplexed_seven_segment_display & operator=(multiplexed_seven_segment_display const &) = delete;
+
+   font_type & font() {
+      return *this;
+   }
+   font_type const & font() const {
+      return *this;
+   }
+
+   //! Sets the fraction of its time slot each digit is lit for, with 0 meaning off and 255 always on.
+   void set_brightness(uint8_t brightness) {
+      impl::lit = brightness != 0;
+      if (brightness == 0xff || brightness == 0) {
+         timer_counter_t::interrupt_mask.clear_bit(tc_comp_b::interrupt_enable_bit);
+         return;
+      }
+      uint16_t compare;
+      if (max_top <= 0xff) {
+         compare = static_cast<uint16_t>((static_cast<uint16_t>(brightness) * (top + 1)) >> 8);
+      } else {
+         compare = static_cast<uint16_t>((static_cast<uint32_t>(brightness) * (uint32_t{top} + 1)) >> 8);
+      }
+      // A compare value of 0 would match right after compare match A, leaving the digit effectively off.
+      tc_comp_b::top = static_cast<typename timer_counter_t::value_type>(max(compare, uint16_t{1}));
+      timer_counter_t::interrupt_mask.set_bit(tc_comp_b::interrupt_enable_bit);
+   }
+
+   //! Sets a digit in the back buffer to a character of the font.
+   void set(uint8_t index, source_type value) {
+      back()[index] = font().map(value);
+   }
+
+   /*! Sets a digit in the back buffer to the specified segments, encoded as returned by the map() method of
+   the font classes; see RAWR_1_7SEGS(). */
+   void set_segments(uint8_t index, uint8_t segments) {
+      back()[index] = segments;
+   }
+
+   /*! Makes the back buffer visible, then copies it into the new back buffer, so that it can be incrementally
+   changed. */
+   void swap() {
+      auto new_front{static_cast<uint8_t>(impl::front ^ 1)};
+      // Writing a single byte is atomic, so the interrupt handler will use either buffer, but never a mix.
+      impl::front = new_front;
+      trivial_copy<size>(impl::frames[new_front], impl::frames[new_front ^ 1]);
+   }
+
+   //! Displays size characters of the font, such as a string that’s at least size characters long.
+   void write(source_type const * values) {
+      for (uint8_t i = 0; i < size; ++i) {
+         set(i, values[i]);
+      }
+      swap();
+   }
+
+   /*! Displays a number, right-aligned and without leading zeros; if it has more digits than the display,
+   only the least significant ones are shown. */
+   void write_number(typename _pvt::uint_t_from_bytes<(size <= 4 ? 2 : 4)>::type number) {
+      seven_segment_display_decimal_font decimal_font;
+      auto frame{back()};
+      for (uint8_t i = size; i > 0; --i) {
+         frame[i - 1] = number != 0 || i == size ? decimal_font.map(static_cast<uint8_t>(number % 10)) : 0;
+         number /= 10;
+      }
+      swap();
+   }
+
+private:
+   static uint8_t * back() {
+      return impl::frames[impl::front ^ 1];
+   }
+
+private:
+   //! Cached TOP, to avoid reading it back from 16-bit registers when scaling the brightness.
+   uint16_t top;
+};
+
+} //namespace rawr
@@ -0,0 +1,186 @@
+/* -*- coding: utf-8; mode: c++; tab-width: 3; indent-tabs-mode: nil -*-
+
+Copyright 2022 Raffaello D. Di Napoli
+
+This file is part of RAWR.
+
+RAWR is free software: you can redistribute it and/or modify it under the terms of version 2.1 of the GNU
+Lesser General Public License as published by the Free Software Foundation.
+
+RAWR is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for
+more details.
+------------------------------------------------------------------------------------------------------------*/
+
+#pragma once
+
+#include <rawr/alias.hxx>
+#include <rawr/hw/io_port.hxx>
+#include <rawr/trace.hxx>
+#ifdef RAWR_DEFERRED_CALLBACKS
+   #include <rawr/event_loop.hxx>
+#endif
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace rawr {
+
+/*! Binds a handler to a pin, for use with rawr::pin_change_port. Handler can be a pointer to a function, or a
+lambda without captures, taking the new value of the pin as a bool argument. */
+template <uint8_t Bit, auto Handler>
+struct pin_change_handler {
+   static constexpr uint8_t bit{Bit};
+
+   //! Invokes (or posts, if RAWR_DEFERRED_CALLBACKS is defined) the handler if the pin changed.
+   static void dispatch(uint8_t curr_pins, uint8_t changed_pins) {
+      if ((changed_pins & _BV(Bit)) != 0) {
+#ifdef RAWR_DEFERRED_CALLBACKS
+         event_loop::post(&invoke, nullptr, (curr_pins & _BV(Bit)) != 0);
+#else
+         Handler((curr_pins & _BV(Bit)) != 0);
+#endif
+      }
+   }
+
+#ifdef RAWR_DEFERRED_CALLBACKS
+   static void invoke(void *, uint8_t value) {
+      Handler(value != 0);
+   }
+#endif
+};
+
+} //namespace rawr
+
+namespace rawr { namespace _pvt {
+
+template <char Port>
+struct pin_change_port_asm;
+
+#define _RAWR_SPECIALIZE_PIN_CHANGE_PORT_ASM_IMPL(port_ascii, vector, prefix) \
+   template <> \
+   struct pin_change_port_asm<port_ascii> { \
+      static void emit() { \
+         RAWR_ALIAS(RAWR_TOSTRING(vector), prefix "EE8__vectorEv"); \
+      } \
+   };
+#define _RAWR_SPECIALIZE_PIN_CHANGE_PORT_ASM(port_ascii, vector) \
+   _RAWR_SPECIALIZE_PIN_CHANGE_PORT_ASM_IMPL(port_ascii, vector, "_ZN4rawr4_pvt22pin_change_port_vectorILc" RAWR_TOSTRING(port_ascii))
+#ifdef PCINT_A_vect
+   _RAWR_SPECIALIZE_PIN_CHANGE_PORT_ASM(65 /*A*/, PCINT_A_vect)
+#endif
+#ifdef PCINT_B_vect
+   _RAWR_SPECIALIZE_PIN_CHANGE_PORT_ASM(66 /*B*/, PCINT_B_vect)
+#endif
+#ifdef PCINT_C_vect
+   _RAWR_SPECIALIZE_PIN_CHANGE_PORT_ASM(67 /*C*/, PCINT_C_vect)
+#endif
+#ifdef PCINT_D_vect
+   _RAWR_SPECIALIZE_PIN_CHANGE_PORT_ASM(68 /*D*/, PCINT_D_vect)
+#endif
+#undef _RAWR_SPECIALIZE_PIN_CHANGE_PORT_ASM
+#undef _RAWR_SPECIALIZE_PIN_CHANGE_PORT_ASM_IMPL
+
+/*! Tag type used to find the dispatch function of a port via ADL. The function is only declared here, and
+defined by the one rawr::pin_change_port instantiated for the port; this allows the interrupt vector to have a
+name that doesn’t depend on the handlers, while still having them inlined into it. */
+template <char Port>
+struct pin_change_port_tag {
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wnon-template-friend"
+   friend void pin_change_port_dispatch(pin_change_port_tag);
+#pragma GCC diagnostic pop
+};
+
+template <char Port>
+class pin_change_port_vector {
+private:
+   // Weird name to work around g++ name check for interrupt vectors.
+   static __attribute__((signal, used)) void __vector() {
+      pin_change_port_asm<Port>::emit();
+      trace::isr_entry(trace::pin_change_port_source(Port));
+      pin_change_port_dispatch(pin_change_port_tag<Port>{});
+      trace::isr_exit(trace::pin_change_port_source(Port));
+   }
+};
+
+template <char Port, typename... Handlers>
+class pin_change_port_dispatcher : private pin_change_port_vector<Port> {
+private:
+   typedef hw::io_port<Port> io_port_;
+
+   /*! Invoked by the interrupt vector. Being a friend, it’s declared in this namespace, where
+   pin_change_port_tag declared it too. */
+   friend void pin_change_port_dispatch(pin_change_port_tag<Port>) {
+      uint8_t curr_pins = io_port_::pins, changed_pins = curr_pins ^ last_pins;
+      last_pins = curr_pins;
+      // Expands to one bit test per handler.
+      (Handlers::dispatch(curr_pins, changed_pins), ...);
+   }
+
+protected:
+   /*! Since all pins on a port share the same pin change interrupt, we need to track the last state of each
+   pin to avoid invoking handlers for pins that did not, in fact, change. */
+   static uint8_t last_pins;
+};
+
+template <char Port, typename... Handlers>
+uint8_t pin_change_port_dispatcher<Port, Handlers...>::last_pins;
+
+}} //namespace rawr::_pvt
+
+namespace rawr {
+
+/*! Configures pins of an I/O port as inputs, and handles their pin change interrupt with a fixed set of
+handlers, each specified as a rawr::pin_change_handler:
+
+   using namespace rawr;
+   pin_change_port<'D', pin_change_handler<4, on_d4>, pin_change_handler<5, on_d5>> port_d{true};
+
+Unlike rawr::binary_input_pin, which looks up callbacks in a RAM table by iterating over all the pins of the
+port, the generated interrupt handler only tests the registered pins, in a fixed sequence, and calls their
+handlers directly. Only one pin_change_port can be instantiated for each port, and it can’t be combined with
+rawr::binary_input_pin callbacks on the same port. */
+template <char Port, typename... Handlers>
+class pin_change_port : private _pvt::pin_change_port_dispatcher<Port, Handlers...> {
+private:
+   typedef _pvt::pin_change_port_dispatcher<Port, Handlers...> pin_change_port_dispatcher_;
+   typedef hw::io_port<Port> io_port_;
+   //! Pins with a handler.
+   static constexpr uint8_t mask{static_cast<uint8_t>((0 | ... | _BV(Handlers::bit)))};
+
+public:
+   //! Configures the pins as inputs, without activating internal pull-ups or pull-downs.
+   pin_change_port() {
+      io_port_::data_direction = static_cast<uint8_t>(io_port_::data_direction & ~mask);
+      enable();
+   }
+
+   //! Configures the pins as inputs, activating internal pull-ups or pull-downs.
+   pin_change_port(bool pullup) {
+      io_port_::data_direction = static_cast<uint8_t>(io_port_::data_direction & ~mask);
+      if (pullup) {
+         io_port_::data = static_cast<uint8_t>(io_port_::data | mask);
+      } else {
+         io_port_::data = static_cast<uint8_t>(io_port_::data & ~mask);
+      }
+      enable();
+   }
+
+   pin_change_port(pin_change_port const &) = delete;
+
+   pin_change_port & operator=(pin_change_port const &) = delete;
+
+   //! Returns the current value of all the pins on the port.
+   uint8_t value() const {
+      return io_port_::pins;
+   }
+
+private:
+   void enable() {
+      pin_change_port_dispatcher_::last_pins = io_port_::pins;
+      io_port_::pcint_mask = static_cast<uint8_t>(io_port_::pcint_mask | mask);
+      PCICR.set_bit(io_port_::pcint_enable_bit);
+   }
+};
+
+} //namespace rawr
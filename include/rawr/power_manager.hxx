@@ -0,0 +1,471 @@
+/* -*- coding: utf-8; mode: c++; tab-width: 3; indent-tabs-mode: nil -*-
+
+Copyright 2022 Raffaello D. Di Napoli
+
+This file is part of RAWR.
+
+RAWR is free software: you can redistribute it and/or modify it under the terms of version 2.1 of the GNU
+Lesser General Public License as published by the Free Software Foundation.
+
+RAWR is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for
+more details.
+------------------------------------------------------------------------------------------------------------*/
+
+#pragma once
+
+#include <rawr/alias.hxx>
+#include <rawr/hw/io.hxx>
+#include <rawr/misc.hxx>
+#ifdef RAWR_HOST
+   #include <rawr/host.hxx>
+#else
+   #include <avr/interrupt.h>
+   #include <avr/sleep.h>
+   #include <avr/wdt.h>
+#endif
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace rawr { namespace _pvt {
+
+//! Bit of PRR that gates the clock of each timer/counter, or -1 if it can’t be gated.
+template <int Index>
+struct timer_counter_power_reduction {
+   static constexpr int8_t bit{-1};
+};
+
+//! Bit of PRR that gates the clock of each USART, or -1 if it can’t be gated.
+template <int Index>
+struct usart_power_reduction {
+   static constexpr int8_t bit{-1};
+};
+
+//! Bit of PRR that gates the clock of the USI, or -1 if it can’t be gated.
+template <int Index>
+struct usi_power_reduction {
+   static constexpr int8_t bit{-1};
+};
+
+//! Bit of PRR that gates the clock of the ADC, or -1 if it can’t be gated.
+template <int Index>
+struct adc_power_reduction {
+   static constexpr int8_t bit{-1};
+};
+
+#define _RAWR_SPECIALIZE_POWER_REDUCTION(module, index, prr_bit) \
+   template <> \
+   struct module ## _power_reduction<index> { \
+      static constexpr int8_t bit{prr_bit}; \
+   };
+// MCUs with more than 8 gateable modules have PRR0 and PRR1 instead; those are not supported.
+#ifdef PRR
+   #ifdef PRTIM0
+      _RAWR_SPECIALIZE_POWER_REDUCTION(timer_counter, 0, PRTIM0)
+   #endif
+   #ifdef PRTIM1
+      _RAWR_SPECIALIZE_POWER_REDUCTION(timer_counter, 1, PRTIM1)
+   #endif
+   #ifdef PRTIM2
+      _RAWR_SPECIALIZE_POWER_REDUCTION(timer_counter, 2, PRTIM2)
+   #endif
+   #if defined(PRUSART0)
+      _RAWR_SPECIALIZE_POWER_REDUCTION(usart, 0, PRUSART0)
+   #elif defined(PRUSART)
+      _RAWR_SPECIALIZE_POWER_REDUCTION(usart, 0, PRUSART)
+   #endif
+   #ifdef PRUSI
+      _RAWR_SPECIALIZE_POWER_REDUCTION(usi, 0, PRUSI)
+   #endif
+   #ifdef PRADC
+      _RAWR_SPECIALIZE_POWER_REDUCTION(adc, 0, PRADC)
+   #endif
+#endif
+#undef _RAWR_SPECIALIZE_POWER_REDUCTION
+
+}} //namespace rawr::_pvt
+
+#ifdef RAWR_POWER_MANAGEMENT
+
+namespace rawr { namespace _pvt {
+
+#ifdef SMCR
+   inline constexpr decltype(SMCR) sleep_control{};
+#else
+   inline constexpr decltype(MCUCR) sleep_control{};
+#endif
+
+/*! Values of the SMn bits for the sleep modes used by power_manager. The same bits select different modes on
+different MCUs (e.g. SM0 alone selects power-down on the ATtiny2313), so they need to be specialized for each
+MCU, like hw::adc_references. On MCUs without an ADC, adc_noise_reduction is never used. */
+struct sleep_modes;
+
+#define _RAWR_SPECIALIZE_SLEEP_MODES(adc_noise_reduction_bits, power_down_bits) \
+   struct sleep_modes { \
+      static constexpr uint8_t idle{0}; \
+      static constexpr uint8_t adc_noise_reduction{adc_noise_reduction_bits}; \
+      static constexpr uint8_t power_down{power_down_bits}; \
+   };
+#if defined(__AVR_ATmega48__) || defined(__AVR_ATmega48A__) || defined(__AVR_ATmega48P__) || \
+    defined(__AVR_ATmega48PA__) || defined(__AVR_ATmega88__) || defined(__AVR_ATmega88A__) || \
+    defined(__AVR_ATmega88P__) || defined(__AVR_ATmega88PA__) || defined(__AVR_ATmega168__) || \
+    defined(__AVR_ATmega168A__) || defined(__AVR_ATmega168P__) || defined(__AVR_ATmega168PA__) || \
+    defined(__AVR_ATmega328__) || defined(__AVR_ATmega328P__) || \
+    defined(__AVR_ATtiny24__) || defined(__AVR_ATtiny44__) || defined(__AVR_ATtiny84__) || \
+    defined(__AVR_ATtiny25__) || defined(__AVR_ATtiny45__) || defined(__AVR_ATtiny85__)
+   _RAWR_SPECIALIZE_SLEEP_MODES(_BV(SM0), _BV(SM1))
+#elif defined(__AVR_ATtiny2313__) || defined(__AVR_ATtiny2313A__) || defined(__AVR_ATtiny4313__)
+   // SM1 alone selects standby mode.
+   _RAWR_SPECIALIZE_SLEEP_MODES(0, _BV(SM0))
+#else
+   #error "RAWR_POWER_MANAGEMENT: the sleep modes of the selected MCU are not known"
+#endif
+#undef _RAWR_SPECIALIZE_SLEEP_MODES
+
+class power_manager_vector;
+
+}} //namespace rawr::_pvt
+
+namespace rawr {
+
+/*! Puts the CPU to sleep in the deepest mode that keeps running the clocks needed by the RAWR subsystems
+currently in use, gating the clock of any unused module via the Power Reduction Register (PRR).
+
+Defining RAWR_POWER_MANAGEMENT before including any rawr header makes rawr::event_loop::run() sleep via
+sleep(), and RAWR drivers report to this class which modules they use:
+
+•  rawr::timer_mux needs the I/O clock while any delay is scheduled, so the CPU can only enter idle mode;
+   while its queue is empty, it doesn’t keep the CPU from entering power-down mode;
+•  rawr::usart, rawr::pwm_output, rawr::steady_clock and rawr::multiplexed_seven_segment_display need the
+   I/O clock for as long as they exist, and rawr::usi_uart while transmitting;
+•  rawr::adc needs the ADC clock, so the CPU enters ADC noise reduction mode instead of power-down mode, which
+   also keeps the I/O clock from disturbing conversions; when triggered by a timer/counter, it needs the I/O
+   clock as well, so the CPU can only enter idle mode;
+•  rawr::eeprom_store counts as needing the I/O clock while committing, since the EEPROM ready interrupt
+   can’t wake the CPU from power-down mode;
+•  Pin change interrupts, used by rawr::binary_input_pin, and the watchdog timer wake the CPU from power-down
+   mode, so they don’t need any clocks.
+
+If the only user of the I/O clock is a timer_mux whose next delay is far enough in the future, the CPU sleeps
+in power-down mode instead, with the timer/counter stopped and the watchdog timer in interrupt mode waking it
+up after the longest period (16 ms to 8 s) that ends before the delay expires, allowing for the watchdog
+oscillator’s ±10% inaccuracy. The shortest time the period could have lasted is then subtracted from the
+delay, so that it never expires early, though it can expire late by up to a fifth of the time spent napping;
+the rest of the delay elapses sleeping in idle mode, with the usual accuracy. If another interrupt wakes the
+CPU up before the watchdog timer, the time spent napping can’t be measured, so nothing is subtracted, making
+the delay expire late by up to one watchdog period; to keep such wake-ups from adding up, each of them halves
+the longest period used for the following naps, and each nap that runs to completion doubles it back. Naps
+are skipped while the watchdog timer is in use by other code, e.g. via hw::watchdog_timer, since the
+watchdog timer can’t be shared, and while the ADC is in use, since power-down mode would stop it.
+
+Modules not used by any RAWR driver are gated while sleeping, and stay gated after waking up; code using
+modules directly must invoke power_up() before accessing them. */
+class power_manager {
+private:
+   friend class _pvt::power_manager_vector;
+
+public:
+   //! Hooks allowing power_manager to stop the timer/counter of a timer_mux while sleeping.
+   struct timebase {
+      //! Value passed to require_io_clock() by the timer_mux.
+      uint8_t io_clock_user;
+      /*! Stops the timer/counter, returning the milliseconds left until the next delay expires, or 0 if less
+      than 1 ms. */
+      uint16_t (* suspend)();
+      //! Subtracts the specified milliseconds from the next delay, then restarts the timer/counter.
+      void (* resume)(uint16_t slept_ms);
+   };
+
+public:
+   //! Returns the value for require_io_clock() for a timer/counter.
+   static constexpr uint8_t timer_counter_clock(int index) {
+      return static_cast<uint8_t>(0x01 << index);
+   }
+
+   //! Returns the value for require_io_clock() for a USART.
+   static constexpr uint8_t usart_clock(int index) {
+      return static_cast<uint8_t>(0x08 << index);
+   }
+
+   //! Value for require_io_clock() for the USI.
+   static constexpr uint8_t usi_clock{0x20};
+
+   //! Value for require_io_clock() for rawr::eeprom_store.
+   static constexpr uint8_t eeprom_clock{0x40};
+
+   /*! Ungates the clock of a module, and keeps it ungated while sleeping.
+
+   @param prr_bit
+      Bit of PRR gating the module, e.g. _pvt::timer_counter_power_reduction<0>::bit; if -1, the module can’t
+      be gated, and nothing happens.
+   */
+   static void power_up(int8_t prr_bit) {
+#ifdef PRR
+      if (prr_bit >= 0) {
+         powered_modules = static_cast<uint8_t>(powered_modules | _BV(prr_bit));
+         PRR.clear_bit(static_cast<uint8_t>(prr_bit));
+      }
+#else
+      static_cast<void>(prr_bit);
+#endif
+   }
+
+   /*! Records whether a subsystem needs the I/O clock to run while sleeping. Safe to call with interrupts
+   enabled.
+
+   @param user
+      Subsystem, e.g. timer_counter_clock(0).
+   @param required
+      true if the subsystem needs the I/O clock, or false if it can let it stop.
+   */
+   static void require_io_clock(uint8_t user, bool required) {
+      uint8_t sreg{SREG};
+      cli();
+      if (required) {
+         io_clock_users = static_cast<uint8_t>(io_clock_users | user);
+      } else {
+         io_clock_users = static_cast<uint8_t>(io_clock_users & ~user);
+      }
+      SREG = sreg;
+   }
+
+   /*! Records whether the ADC is converting, and so needs its clock to run while sleeping. Safe to call with
+   interrupts enabled. */
+   static void require_adc_clock(bool required) {
+      adc_clock_required = required;
+   }
+
+   //! Registers the hooks of a timer_mux; only the last timer_mux to register them can sleep in power-down.
+   static void set_timebase(timebase const * timebase__) {
+      timebase_ = timebase__;
+   }
+
+   /*! Sleeps until an interrupt wakes the CPU up. Must be called with interrupts disabled; returns with
+   interrupts enabled, after servicing the interrupt. */
+   static void sleep() {
+      uint8_t mode{_pvt::sleep_modes::power_down};
+      int8_t watchdog_period{-1};
+      if (io_clock_users != 0) {
+         mode = _pvt::sleep_modes::idle;
+         if (
+            timebase_ && io_clock_users == timebase_->io_clock_user &&
+            (WDTCR & (_BV(WDE) | _BV(WDIE))) == 0 && !adc_clock_required
+         ) {
+            watchdog_period = longest_watchdog_period(timebase_->suspend());
+            if (watchdog_period >= 0) {
+               start_watchdog(static_cast<uint8_t>(watchdog_period));
+               mode = _pvt::sleep_modes::power_down;
+            } else {
+               timebase_->resume(0);
+            }
+         }
+      } else if (adc_clock_required) {
+         mode = _pvt::sleep_modes::adc_noise_reduction;
+      }
+#ifdef PRR
+      PRR = static_cast<uint8_t>(gateable_modules & ~powered_modules);
+#endif
+      _pvt::sleep_control = static_cast<uint8_t>((_pvt::sleep_control & ~sleep_mode_mask) | mode);
+      sleep_enable();
+      // See event_loop::run().
+      sei();
+      sleep_cpu();
+      sleep_disable();
+      if (watchdog_period >= 0) {
+         cli();
+         uint16_t slept_ms{0};
+         if (stop_watchdog()) {
+            auto period_ms{watchdog_period_ms(static_cast<uint8_t>(watchdog_period))};
+            // 90.6% of the period, since the watchdog oscillator may be up to 10% fast.
+            slept_ms = static_cast<uint16_t>(period_ms - (period_ms >> 4) - (period_ms >> 5));
+            if (nap_limit < watchdog_max_period) {
+               ++nap_limit;
+            }
+         } else if (watchdog_period > 0) {
+            /* Another interrupt woke the CPU up first, after an unknown time; crediting none of it makes the
+            delay late instead of early, and shorter naps keep that from adding up. */
+            nap_limit = static_cast<int8_t>(watchdog_period - 1);
+         }
+         timebase_->resume(slept_ms);
+         sei();
+      }
+   }
+
+private:
+   //! Returns the period of the watchdog timer for the specified prescaler selection, in milliseconds.
+   static constexpr uint16_t watchdog_period_ms(uint8_t period) {
+      // 2048 << period cycles of the 128 kHz watchdog oscillator.
+      return static_cast<uint16_t>(16 << period);
+   }
+
+   /*! Returns the longest watchdog period, up to nap_limit, that will end before ms elapse even if the
+   watchdog oscillator is 12.5% slow, or -1 if there’s none. */
+   static int8_t longest_watchdog_period(uint16_t ms) {
+      int8_t period{nap_limit};
+      for (; period >= 0; --period) {
+         auto period_ms{watchdog_period_ms(static_cast<uint8_t>(period))};
+         if (static_cast<uint32_t>(period_ms) + (period_ms >> 3) <= ms) {
+            break;
+         }
+      }
+      return period;
+   }
+
+   //! Restarts the watchdog timer in interrupt mode, with the specified period. Interrupts must be disabled.
+   static void start_watchdog(uint8_t period) {
+      auto control{static_cast<uint8_t>(_BV(WDIE) | watchdog_prescaler_bits(period))};
+      watchdog_expired = false;
+      wdt_reset();
+      write_watchdog_control(control);
+   }
+
+   /*! Stops the watchdog timer, returning true if its period elapsed, even if its interrupt was not serviced
+   yet. Interrupts must be disabled. */
+   static bool stop_watchdog() {
+      bool expired{watchdog_expired || (WDTCR & _BV(WDIF)) != 0};
+      // Writing 1 to WDIF clears it, so it won’t cut the next period short.
+      write_watchdog_control(_BV(WDIF));
+      return expired;
+   }
+
+   /*! Writes WDTCR via the timed sequence needed to change WDE or the prescaler: the write must come within 4
+   cycles of another setting WDCE and WDE. Interrupts must be disabled. */
+   static void write_watchdog_control(uint8_t control) {
+      auto change_enable{static_cast<uint8_t>(WDTCR | _BV(WDCE) | _BV(WDE))};
+#ifdef RAWR_HOST
+      WDTCR = change_enable;
+      WDTCR = control;
+#else
+      // Like wdt_enable(), both values are already in registers, so the two writes are back to back.
+      __asm__ __volatile__(
+         "\r\n" "sts %0, %1"
+         "\r\n" "sts %0, %2"
+         :
+         : "n" (_SFR_MEM_ADDR(WDTCR)), "r" (change_enable), "r" (control)
+         : "memory"
+      );
+#endif
+   }
+
+   static constexpr uint8_t watchdog_prescaler_bits(uint8_t period) {
+#ifdef WDP3
+      return static_cast<uint8_t>((period & 0x07) | ((period & 0x08) != 0 ? _BV(WDP3) : 0));
+#else
+      return static_cast<uint8_t>(period & 0x07);
+#endif
+   }
+
+private:
+#ifdef SM2
+   static constexpr uint8_t sleep_mode_mask{_BV(SM0) | _BV(SM1) | _BV(SM2)};
+#else
+   static constexpr uint8_t sleep_mode_mask{_BV(SM0) | _BV(SM1)};
+#endif
+#ifdef WDP3
+   static constexpr int8_t watchdog_max_period{9};
+#else
+   static constexpr int8_t watchdog_max_period{7};
+#endif
+#ifdef PRR
+   //! Modules that can be gated via PRR.
+   static constexpr uint8_t gateable_modules{
+   #ifdef PRADC
+      _BV(PRADC) |
+   #endif
+   #ifdef PRSPI
+      _BV(PRSPI) |
+   #endif
+   #ifdef PRTWI
+      _BV(PRTWI) |
+   #endif
+   #ifdef PRUSI
+      _BV(PRUSI) |
+   #endif
+   #ifdef PRTIM0
+      _BV(PRTIM0) |
+   #endif
+   #ifdef PRTIM1
+      _BV(PRTIM1) |
+   #endif
+   #ifdef PRTIM2
+      _BV(PRTIM2) |
+   #endif
+   #if defined(PRUSART0)
+      _BV(PRUSART0) |
+   #elif defined(PRUSART)
+      _BV(PRUSART) |
+   #endif
+      0
+   };
+
+   //! Modules ungated by power_up().
+   static inline uint8_t powered_modules;
+#endif
+   //! Combination of *_clock values for the subsystems currently needing the I/O clock.
+   static inline uint8_t volatile io_clock_users;
+   static inline timebase const * timebase_;
+   //! Set while rawr::adc is converting.
+   static inline bool volatile adc_clock_required;
+   //! Longest watchdog period sleep() will nap for; see the class documentation.
+   static inline int8_t nap_limit{watchdog_max_period};
+   //! Set by the watchdog timeout interrupt handler.
+   static inline bool volatile watchdog_expired;
+};
+
+} //namespace rawr
+
+namespace rawr { namespace _pvt {
+
+#ifdef WDT_vect
+   #define _RAWR_POWER_MANAGER_WDT_VECT WDT_vect
+#elif defined(WATCHDOG_vect)
+   #define _RAWR_POWER_MANAGER_WDT_VECT WATCHDOG_vect
+#endif
+
+class power_manager_vector {
+private:
+   //! Watchdog timeout interrupt vector. It has a weird name to work around g++’s name check.
+   static __attribute__((signal, used)) void __vector() {
+      RAWR_ALIAS(
+         RAWR_TOSTRING(_RAWR_POWER_MANAGER_WDT_VECT), "_ZN4rawr4_pvt20power_manager_vector8__vectorEv"
+      );
+      power_manager::watchdog_expired = true;
+   }
+};
+
+#undef _RAWR_POWER_MANAGER_WDT_VECT
+
+}} //namespace rawr::_pvt
+
+#else //ifdef RAWR_POWER_MANAGEMENT
+
+namespace rawr {
+
+//! Without RAWR_POWER_MANAGEMENT, drivers reporting their needs to power_manager generate no code.
+class power_manager {
+public:
+   static constexpr uint8_t timer_counter_clock(int) {
+      return 0;
+   }
+
+   static constexpr uint8_t usart_clock(int) {
+      return 0;
+   }
+
+   static constexpr uint8_t usi_clock{0};
+
+   static constexpr uint8_t eeprom_clock{0};
+
+   static void power_up(int8_t) {
+   }
+
+   static void require_io_clock(uint8_t, bool) {
+   }
+
+   static void require_adc_clock(bool) {
+   }
+};
+
+} //namespace rawr
+
+#endif //ifdef RAWR_POWER_MANAGEMENT … else
@@ -0,0 +1,246 @@
+/* -*- coding: utf-8; mode: c++; tab-width: 3; indent-tabs-mode: nil -*-
+
+Copyright 2022 Raffaello D. Di Napoli
+
+This file is part of RAWR.
+
+RAWR is free software: you can redistribute it and/or modify it under the terms of version 2.1 of the GNU
+Lesser General Public License as published by the Free Software Foundation.
+
+RAWR is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for
+more details.
+------------------------------------------------------------------------------------------------------------*/
+
+#pragma once
+
+#include <rawr/hw/timer_counter.hxx>
+#include <rawr/chrono.hxx>
+#include <rawr/misc.hxx>
+#include <rawr/power_manager.hxx>
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace rawr {
+
+//! Waveform generated by rawr::pwm_output.
+enum class pwm_mode : uint8_t {
+   //! Single-slope: twice the frequency of phase_correct for the same TOP.
+   fast,
+   //! Dual-slope: pulses stay centered within the period as the duty cycle changes.
+   phase_correct
+};
+
+} //namespace rawr
+
+namespace rawr { namespace _pvt {
+
+//! Clock select bits and TOP value yielding a PWM frequency.
+struct pwm_timing {
+   uint8_t prescaler_bits;
+   uint16_t top;
+};
+
+/*! Returns the timing that best approximates frequency. With a variable TOP, the smallest prescaler for which
+TOP fits in max_top is chosen, to get the finest duty cycle resolution; with TOP fixed to max_top, the
+prescaler yielding the closest frequency is chosen.
+
+Only uses 32-bit math, so that it’s affordable at run time as well. */
+template <int Index>
+inline constexpr pwm_timing find_pwm_timing(
+   chrono::hertz frequency, pwm_mode mode, bool variable_top, uint16_t max_top
+) {
+   constexpr auto & prescalers{hw::timer_counter_prescaler_list<Index>::values};
+   constexpr auto prescalers_size{static_cast<uint8_t>(RAWR_COUNTOF(prescalers))};
+   auto target{static_cast<uint32_t>(frequency.count())};
+   // Fast PWM has a period of TOP + 1 ticks; phase-correct PWM counts up and down, for 2 * TOP ticks.
+   uint32_t slopes{mode == pwm_mode::fast ? 1u : 2u}, top_offset{mode == pwm_mode::fast ? 1u : 0u};
+   // Fallback: the lowest frequency possible.
+   pwm_timing best{prescalers_size, max_top};
+   uint32_t best_error{~uint32_t{}};
+   for (uint8_t i = 0; i < prescalers_size; ++i) {
+      auto prescaled_frequency{static_cast<uint32_t>(F_CPU / prescalers[i])};
+      if (variable_top) {
+         uint32_t ticks{int_round_div(prescaled_frequency, target * slopes)};
+         if (ticks <= max_top + top_offset) {
+            // Keep at least a few steps of duty cycle resolution.
+            return pwm_timing{
+               static_cast<uint8_t>(i + 1), static_cast<uint16_t>(max(ticks, 3 + top_offset) - top_offset)
+            };
+         }
+      } else {
+         uint32_t actual{int_round_div(prescaled_frequency, (max_top + top_offset) * slopes)};
+         uint32_t error{actual > target ? actual - target : target - actual};
+         if (error < best_error) {
+            best_error = error;
+            best.prescaler_bits = static_cast<uint8_t>(i + 1);
+         }
+      }
+   }
+   return best;
+}
+
+//! Count of rawr::pwm_output instances driven by each timer/counter.
+template <int Index>
+struct pwm_timer_counter_users {
+   static inline uint8_t count;
+};
+
+}} //namespace rawr::_pvt
+
+namespace rawr {
+
+/*! Hardware PWM output on the pin driven by an Output Compare Unit (OCnx); once configured, the waveform is
+generated without any CPU involvement or interrupts.
+
+The frequency can be chosen freely on timer/counters that have an Input Capture Unit (TOP = ICRn), and for
+comparator B of those that don’t (TOP = OCRnA, which makes comparator A unusable as output). In every other
+case TOP is fixed at the maximum value of the timer/counter, and the frequency is approximated by only
+choosing a prescaler.
+
+The timer/counter is entirely dedicated to PWM: it can’t be shared with rawr::timer_mux, and a second
+pwm_output on the other comparator must use the same mode and frequency. It’s stopped when the last
+pwm_output using it is destroyed. */
+template <int TimerIndex, char Comparator, pwm_mode Mode = pwm_mode::fast>
+class pwm_output {
+private:
+   typedef hw::timer_counter<TimerIndex> timer_counter_t;
+   typedef typename timer_counter_t::template comparators<Comparator> tc_comp;
+   typedef hw::timer_counter_output_compare_pin<TimerIndex, Comparator> oc_pin;
+   static constexpr int layout{hw::timer_counter_control_registers_layout<TimerIndex>::layout};
+
+public:
+   //! true if the frequency is determined by a TOP value, as opposed to just the prescaler.
+   static constexpr bool variable_top{layout == 3 || (layout == 2 && Comparator == 'B')};
+   //! Maximum value for TOP, and therefore for the compare value.
+   static constexpr uint16_t max_top{layout == 3 ? 0xffff : 0xff};
+
+   //! Wraps a frequency known at compile time, so that the search for its timing generates no code.
+   struct constant_frequency {
+      consteval constant_frequency(chrono::hertz frequency) :
+         timing{timing_for(frequency)} {
+      }
+
+      _pvt::pwm_timing timing;
+   };
+
+public:
+   /*! Constructor; configures and starts the timer/counter, and makes the pin an output. The timer/counter
+   keeps the CPU from sleeping deeper than idle mode (see rawr::power_manager).
+
+   @param frequency
+      PWM frequency; must be a constant expression.
+   @param duty
+      Duty cycle, with 0 meaning always low and 255 meaning always high.
+   */
+   explicit pwm_output(constant_frequency frequency, uint8_t duty = 0) {
+      ++_pvt::pwm_timer_counter_users<TimerIndex>::count;
+      power_manager::power_up(_pvt::timer_counter_power_reduction<TimerIndex>::bit);
+      power_manager::require_io_clock(power_manager::timer_counter_clock(TimerIndex), true);
+      oc_pin::port::data.clear_bit(oc_pin::pin);
+      oc_pin::port::data_direction.set_bit(oc_pin::pin);
+      timer_counter_t::control_registers.set_wgm(waveform_generation_mode());
+      set_timing(frequency.timing);
+      set_duty(duty);
+   }
+
+   pwm_output(pwm_output const &) = delete;
+
+   /*! Destructor; disconnects OCnx, leaving the pin low, and if no other pwm_output uses the timer/counter,
+   stops it and lets the CPU sleep deeper again. */
+   ~pwm_output() {
+      timer_counter_t::control_registers.template set_com<Comparator>(0b00);
+      if (--_pvt::pwm_timer_counter_users<TimerIndex>::count == 0) {
+         timer_counter_t::control_registers.set_cs(0);
+         power_manager::require_io_clock(power_manager::timer_counter_clock(TimerIndex), false);
+      }
+   }
+
+   pwm_output & operator=(pwm_output const &) = delete;
+
+   //! Returns the timing that best approximates frequency; usable at compile time and at run time.
+   static constexpr _pvt::pwm_timing timing_for(chrono::hertz frequency) {
+      return _pvt::find_pwm_timing<TimerIndex>(frequency, Mode, variable_top, max_top);
+   }
+
+   /*! Changes the PWM frequency, searching for its timing at run time. The duty cycle needs to be set again
+   afterwards, since the compare value is relative to TOP. If TOP is ICRn, the current period may be cut
+   short. */
+   void set_frequency(chrono::hertz frequency) {
+      set_timing(timing_for(frequency));
+   }
+
+   //! Changes the PWM frequency to one whose timing was found at compile time.
+   void set_frequency(constant_frequency frequency) {
+      set_timing(frequency.timing);
+   }
+
+   //! Sets the duty cycle, with 0 meaning always low and 255 meaning always high.
+   void set_duty(uint8_t duty) {
+      if (duty == 0) {
+         // Even a compare value of 0 would generate a spike each period; disconnect OCnx instead.
+         timer_counter_t::control_registers.template set_com<Comparator>(0b00);
+         return;
+      }
+      if (duty == 0xff) {
+         set_compare(top_);
+      } else if (max_top <= 0xff) {
+         set_compare(static_cast<uint16_t>((static_cast<uint16_t>(duty) * (top_ + 1)) >> 8));
+      } else {
+         set_compare(static_cast<uint16_t>((static_cast<uint32_t>(duty) * (uint32_t{top_} + 1)) >> 8));
+      }
+      // Clear OCnx on compare match, set it at BOTTOM (or while counting down, for phase-correct PWM).
+      timer_counter_t::control_registers.template set_com<Comparator>(0b10);
+   }
+
+   //! Sets the raw compare value, from 0 to top().
+   void set_compare(uint16_t value) {
+      tc_comp::top = static_cast<typename timer_counter_t::value_type>(value);
+   }
+
+   //! Returns the current TOP value.
+   uint16_t top() const {
+      return top_;
+   }
+
+private:
+   static constexpr uint8_t waveform_generation_mode() {
+      if (layout == 3) {
+         // TOP = ICRn.
+         return Mode == pwm_mode::fast ? 14 : 10;
+      } else if (variable_top) {
+         // TOP = OCRnA.
+         return Mode == pwm_mode::fast ? 7 : 5;
+      } else {
+         // TOP = 0xff.
+         return Mode == pwm_mode::fast ? 3 : 1;
+      }
+   }
+
+   void set_timing(_pvt::pwm_timing const & timing) {
+      top_ = timing.top;
+      if constexpr (layout == 3) {
+         set_input_capture_top(timing.top);
+      } else if constexpr (variable_top) {
+         timer_counter_t::template comparators<'A'>::top = static_cast<uint8_t>(timing.top);
+      }
+      timer_counter_t::control_registers.set_cs(timing.prescaler_bits);
+   }
+
+   /*! Writes TOP to ICRn. Unlike OCRnx, ICRn is not double-buffered: if the counter were already past the new
+   TOP, it would run up to 0xffff before wrapping around, stretching the period by up to 65536 ticks. So the
+   timer/counter is stopped, and if the counter is past the new TOP, it’s moved back to it, ending the current
+   period early instead; set_timing() then restarts it. */
+   static void set_input_capture_top(uint16_t top) {
+      timer_counter_t::control_registers.set_cs(0);
+      hw::timer_counter_input_capture<TimerIndex>::value = top;
+      if (timer_counter_t::value > top) {
+         timer_counter_t::value = top;
+      }
+   }
+
+   //! Cached TOP, to avoid reading it back from 16-bit registers when scaling the duty cycle.
+   uint16_t top_;
+};
+
+} //namespace rawr
@@ -15,9 +15,37 @@ more details.
 #pragma once
 
 #include <rawr/hw/io.hxx>
+#ifdef RAWR_HOST
+   #include <stdlib.h>
+#endif
 
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+#ifdef RAWR_HOST
+
+namespace rawr { namespace host {
+
+/*! Invoked by rawr::reset() in host builds, where there’s no device to reset. A test can set this to a
+function that throws or calls longjmp() to regain control; if nullptr, or if it returns, the process is
+aborted. */
+inline void (* reset_handler)() = nullptr;
+
+}} //namespace rawr::host
+
+namespace rawr {
+
+//! Resets the device; in host builds, invokes host::reset_handler instead.
+[[noreturn]] inline void reset() {
+   if (host::reset_handler) {
+      host::reset_handler();
+   }
+   ::abort();
+}
+
+} //namespace rawr
+
+#else //ifdef RAWR_HOST
+
 namespace rawr {
 
 //! Resets the device.
@@ -34,3 +62,5 @@ inline __attribute__((naked)) void reset() {
 }
 
 } //namespace rawr
+
+#endif //ifdef RAWR_HOST … else
@@ -0,0 +1,146 @@
+/* -*- coding: utf-8; mode: c++; tab-width: 3; indent-tabs-mode: nil -*-
+
+Copyright 2022 Raffaello D. Di Napoli
+
+This file is part of RAWR.
+
+RAWR is free software: you can redistribute it and/or modify it under the terms of version 2.1 of the GNU
+Lesser General Public License as published by the Free Software Foundation.
+
+RAWR is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for
+more details.
+------------------------------------------------------------------------------------------------------------*/
+
+#pragma once
+
+#include <inttypes.h>
+#ifdef RAWR_HOST
+   #include <rawr/host.hxx>
+#else
+   #include <avr/pgmspace.h>
+#endif
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace rawr { namespace _pvt {
+
+/*! Transmit queue shared by rawr::usart and rawr::usi_uart. Rather than bytes, it queues up to Capacity
+segments, each referencing a caller-owned buffer in RAM or program memory, which is read a byte at a time by
+the interrupt handler draining the queue; nothing is copied, so a segment can be arbitrarily long, but its
+buffer must not change until it’s been transmitted. Single bytes are the exception: they are stored in the
+segment itself.
+
+push() must be called with the interrupt handler calling pop() disabled. */
+template <uint8_t Capacity>
+class serial_tx_queue {
+private:
+   struct segment_t {
+      //! Next byte to transmit.
+      uint8_t const * next;
+      //! Bytes left to transmit, including *next.
+      uint16_t remaining;
+      //! true if next points to program memory.
+      bool progmem;
+      //! Storage for segments queued by push(uint8_t).
+      uint8_t byte;
+   };
+
+public:
+   constexpr serial_tx_queue() :
+      segments{},
+      first{0},
+      size{0} {
+   }
+
+   //! Returns true if there’s nothing left to transmit.
+   bool empty() const {
+      return size == 0;
+   }
+
+   //! Returns true if no more segments can be queued.
+   bool full() const {
+      return size == Capacity;
+   }
+
+   /*! Queues a segment; returns false, without queuing anything, if the queue is full. Empty buffers are not
+   queued, but are reported as successfully queued. */
+   bool push(void const * buffer, uint16_t buffer_size, bool progmem) {
+      if (buffer_size == 0) {
+         return true;
+      }
+      auto segment{tail()};
+      if (!segment) {
+         return false;
+      }
+      segment->next = static_cast<uint8_t const *>(buffer);
+      segment->remaining = buffer_size;
+      segment->progmem = progmem;
+      size = static_cast<uint8_t>(size + 1);
+      return true;
+   }
+
+   //! Queues a single byte; returns false if the queue is full.
+   bool push(uint8_t byte) {
+      auto segment{tail()};
+      if (!segment) {
+         return false;
+      }
+      segment->byte = byte;
+      segment->next = &segment->byte;
+      segment->remaining = 1;
+      segment->progmem = false;
+      size = static_cast<uint8_t>(size + 1);
+      return true;
+   }
+
+   //! Drops all queued segments; the interrupt handler calling pop() must be disabled.
+   void clear() {
+      size = 0;
+   }
+
+   //! Removes and returns the next byte to transmit; the queue must not be empty.
+   uint8_t pop() {
+      auto & segment{segments[first]};
+      auto byte{segment.progmem ? pgm_read_byte(segment.next) : *segment.next};
+      ++segment.next;
+      if (--segment.remaining == 0) {
+         if (++first == Capacity) {
+            first = 0;
+         }
+         size = static_cast<uint8_t>(size - 1);
+      }
+      return byte;
+   }
+
+private:
+   //! Returns the first available segment, or nullptr if the queue is full.
+   segment_t * tail() {
+      if (size == Capacity) {
+         return nullptr;
+      }
+      auto tail_{static_cast<uint8_t>(first + size)};
+      if (tail_ >= Capacity) {
+         tail_ = static_cast<uint8_t>(tail_ - Capacity);
+      }
+      return &segments[tail_];
+   }
+
+private:
+   segment_t segments[Capacity];
+   //! Index of the segment being transmitted.
+   uint8_t first;
+   //! Number of queued segments; volatile since code waiting for it to change only reads it.
+   uint8_t volatile size;
+};
+
+//! Returns the length of a NUL-terminated string, in RAM or program memory.
+inline uint16_t string_length(char const * s, bool progmem) {
+   uint16_t length{0};
+   while ((progmem ? pgm_read_byte(s + length) : static_cast<uint8_t>(s[length])) != 0) {
+      ++length;
+   }
+   return length;
+}
+
+}} //namespace rawr::_pvt
@@ -15,6 +15,11 @@ more details.
 #pragma once
 
 #include <rawr/binary_output_pin_aggregator.hxx>
+#ifdef RAWR_HOST
+   #include <rawr/host.hxx>
+#else
+   #include <avr/pgmspace.h>
+#endif
 
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -44,12 +49,13 @@ namespace rawr {
    RAWR_1_7SEGS(a3, f3, b3, g3, e3, c3, d3), \
    RAWR_1_7SEGS(a4, f4, b4, g4, e4, c4, d4)
 
-//! Provides characters to display numbers from 0 to 9.
+/*! Provides characters to display numbers from 0 to 9. Like all fonts, its table is stored in program memory,
+so it takes no SRAM. */
 struct seven_segment_display_decimal_font {
    using source_type = uint8_t;
 
    uint8_t map(source_type source) const {
-      static constexpr uint8_t const digits[]{
+      static constexpr uint8_t const digits[] PROGMEM {
          RAWR_5_7SEGS(/*0*/  1,   /*1*/  0,   /*2*/  1,   /*3*/  1,   /*4*/  0,
                            1,  1,      0,  1,      0,  1,      0,  1,      1,  1,
                              0,          0,          1,          1,          1,
@@ -62,7 +68,7 @@ struct seven_segment_display_decimal_font {
                            0,  1,      1,  1,      0,  1,      1,  1,      0,  1,
                              1,          1,          0,          1,          1   )
       };
-      return source < sizeof digits / sizeof digits[0] ? digits[source] : 0;
+      return source < sizeof digits / sizeof digits[0] ? pgm_read_byte(&digits[source]) : 0;
    }
 };
 
@@ -72,7 +78,7 @@ struct seven_segment_display_alphanum_font : protected seven_segment_display_dec
    using source_type = char;
 
    uint8_t map(source_type source) const {
-      static constexpr uint8_t const letters[]{
+      static constexpr uint8_t const letters[] PROGMEM {
          RAWR_5_7SEGS(/*A*/  1,   /*b*/  0,   /*C*/  1,   /*d*/  0,   /*E*/  1,
                            1,  1,      1,  0,      1,  0,      0,  1,      1,  0,
                              1,          1,          0,          1,          1,
@@ -114,9 +120,9 @@ struct seven_segment_display_alphanum_font : protected seven_segment_display_dec
             static_cast<seven_segment_display_decimal_font::source_type>(source - '0')
          );
       } else if (source >= 'A' && source <= 'Z') {
-         return letters[source - 'A'];
+         return pgm_read_byte(&letters[source - 'A']);
       } else if (source >= 'a' && source <= 'z') {
-         return letters[source - 'a'];
+         return pgm_read_byte(&letters[source - 'a']);
       } else {
          return 0;
       }
@@ -0,0 +1,172 @@
+/* -*- coding: utf-8; mode: c++; tab-width: 3; indent-tabs-mode: nil -*-
+
+Copyright 2022 Raffaello D. Di Napoli
+
+This file is part of RAWR.
+
+RAWR is free software: you can redistribute it and/or modify it under the terms of version 2.1 of the GNU
+Lesser General Public License as published by the Free Software Foundation.
+
+RAWR is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for
+more details.
+------------------------------------------------------------------------------------------------------------*/
+
+#pragma once
+
+#include <rawr/alias.hxx>
+#include <rawr/chrono.hxx>
+#include <rawr/hw/timer_counter.hxx>
+#include <rawr/misc.hxx>
+#include <rawr/power_manager.hxx>
+#ifdef RAWR_HOST
+   #include <rawr/host.hxx>
+#else
+   #include <avr/interrupt.h>
+#endif
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace rawr { namespace _pvt {
+
+template <int Index>
+struct steady_clock_asm;
+
+#define _RAWR_SPECIALIZE_STEADY_CLOCK_ASM(index, vector) \
+   template <> \
+   struct steady_clock_asm<index> { \
+      static void emit() { \
+         RAWR_ALIAS( \
+            RAWR_TOSTRING(vector), \
+            "_ZN4rawr4_pvt17steady_clock_baseILi" RAWR_TOSTRING(index) "EE8__vectorEv" \
+         ); \
+      } \
+   };
+#ifdef TIMER0_OVF_vect
+   _RAWR_SPECIALIZE_STEADY_CLOCK_ASM(0, TIMER0_OVF_vect)
+#endif
+#ifdef TIMER1_OVF_vect
+   _RAWR_SPECIALIZE_STEADY_CLOCK_ASM(1, TIMER1_OVF_vect)
+#endif
+#ifdef TIMER2_OVF_vect
+   _RAWR_SPECIALIZE_STEADY_CLOCK_ASM(2, TIMER2_OVF_vect)
+#endif
+#undef _RAWR_SPECIALIZE_STEADY_CLOCK_ASM
+
+//! Type of the overflow count kept by steady_clock_base: wide enough to complete a 32-bit tick count.
+template <typename TimerTicks>
+struct steady_clock_overflows {
+   typedef uint32_t type;
+};
+
+template <>
+struct steady_clock_overflows<uint16_t> {
+   typedef uint16_t type;
+};
+
+/*! Overflow interrupt handler and tick reader of rawr::steady_clock. Kept apart from the latter so that its
+name, which needs to be aliased in assembly, and rawr::trace’s use of it, don’t depend on the prescaler. */
+template <int Index>
+class steady_clock_base {
+protected:
+   typedef hw::timer_counter<Index> timer_counter_t;
+   typedef typename timer_counter_t::value_type timer_ticks;
+
+public:
+   /*! Returns the number of timer ticks elapsed since the clock was started, wrapping around every 2^32
+   ticks. Can be called with interrupts enabled or disabled, including from interrupt handlers. */
+   static uint32_t now() {
+      uint8_t sreg{SREG};
+      cli();
+      auto high{overflows};
+      timer_ticks low{timer_counter_t::value};
+      /* If the counter wrapped around before or right after being read, the interrupt handler didn’t get to
+      account for it yet; read the counter again, to know for sure that it’s past the wrap-around. */
+      if ((timer_counter_t::interrupt_flags & _BV(timer_counter_t::overflow_flag_bit)) != 0) {
+         low = timer_counter_t::value;
+         ++high;
+      }
+      SREG = sreg;
+      return (static_cast<uint32_t>(high) << (sizeof(timer_ticks) * 8)) | low;
+   }
+
+private:
+   //! Interrupt vector. It has a weird name to work around g++’s name check for interrupt vectors.
+   static __attribute__((signal, used)) void __vector() {
+      steady_clock_asm<Index>::emit();
+      // Not atomic, but only this handler writes it, and now() reads it with interrupts disabled.
+      overflows = static_cast<decltype(overflows)>(overflows + 1);
+   }
+
+private:
+   //! Count of counter wrap-arounds, making up the upper bits of the value returned by now().
+   static inline typename steady_clock_overflows<timer_ticks>::type volatile overflows;
+};
+
+}} //namespace rawr::_pvt
+
+namespace rawr {
+
+/*! Monotonic clock counting ticks of timer/counter Index, prescaled by Prescaler, since its construction.
+
+now() combines the live counter value with a count of overflows kept by the overflow interrupt handler, so it
+takes a handful of cycles and never tears, even when the counter wraps around while it’s being read; ticks are
+32-bit, so time spans measured as the difference of two now() values are correct as long as they are shorter
+than 2^32 ticks (e.g. over an hour with 1 µs ticks). to() converts ticks into chrono units, with a scaling
+factor reduced at compile time to avoid 64-bit math where possible.
+
+The timer/counter is reserved for the clock: rawr::timer_mux resets the counter, and PWM modes shorten its
+cycle, so neither can share it. Since it needs the I/O clock, a steady_clock keeps rawr::power_manager from
+putting the CPU in power-down mode. */
+template <int Index, uint16_t Prescaler = 8>
+class steady_clock : public _pvt::steady_clock_base<Index> {
+private:
+   typedef _pvt::steady_clock_base<Index> steady_clock_base_;
+   typedef typename steady_clock_base_::timer_counter_t timer_counter_t;
+   typedef typename timer_counter_t::template prescalers<Prescaler> tc_prescaler;
+
+public:
+   typedef uint32_t count_type;
+
+   static constexpr chrono::hertz frequency{int_round_div(chrono::hertz{F_CPU}, Prescaler)};
+
+public:
+   //! Starts the counter in normal mode, and enables its overflow interrupt.
+   steady_clock() {
+      power_manager::power_up(_pvt::timer_counter_power_reduction<Index>::bit);
+      power_manager::require_io_clock(power_manager::timer_counter_clock(Index), true);
+      timer_counter_t::control_registers.set_wgm(0);
+      timer_counter_t::value = 0;
+      timer_counter_t::interrupt_mask.set_bit(timer_counter_t::overflow_interrupt_enable_bit);
+      timer_counter_t::control_registers.set_cs(tc_prescaler::control_register_bits);
+   }
+
+   using steady_clock_base_::now;
+
+   /*! Converts a number of ticks into Duration, which must be a chrono::time_unit; the result is truncated,
+   and wraps around if it doesn’t fit Duration::count_type. */
+   template <typename Duration>
+   static constexpr Duration to(count_type ticks) {
+      // Reduce Duration::scale / frequency to the smallest terms.
+      constexpr auto ticks_per_second{static_cast<uint32_t>(frequency.count())};
+      constexpr auto divisor{gcd(static_cast<uint32_t>(Duration::scale), ticks_per_second)};
+      constexpr auto numerator{static_cast<uint32_t>(Duration::scale) / divisor};
+      constexpr auto denominator{ticks_per_second / divisor};
+      typedef typename Duration::count_type duration_count;
+      if constexpr (numerator == 1) {
+         return Duration(static_cast<duration_count>(ticks / denominator));
+      } else if constexpr (denominator == 1) {
+         return Duration(static_cast<duration_count>(static_cast<uint64_t>(ticks) * numerator));
+      } else {
+         return Duration(static_cast<duration_count>(static_cast<uint64_t>(ticks) * numerator / denominator));
+      }
+   }
+
+   //! Returns the time elapsed since since, a value previously returned by now().
+   template <typename Duration>
+   static Duration elapsed(count_type since) {
+      return to<Duration>(now() - since);
+   }
+};
+
+} //namespace rawr
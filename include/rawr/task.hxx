@@ -0,0 +1,302 @@
+/* -*- coding: utf-8; mode: c++; tab-width: 3; indent-tabs-mode: nil -*-
+
+Copyright 2022 Raffaello D. Di Napoli
+
+This file is part of RAWR.
+
+RAWR is free software: you can redistribute it and/or modify it under the terms of version 2.1 of the GNU
+Lesser General Public License as published by the Free Software Foundation.
+
+RAWR is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for
+more details.
+------------------------------------------------------------------------------------------------------------*/
+
+#pragma once
+
+#include <rawr/abort.hxx>
+#include <rawr/misc.hxx>
+#if __has_include(<coroutine>)
+   #include <coroutine>
+#endif
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#if !__has_include(<coroutine>)
+
+/* avr-libc comes without a C++ standard library, so provide the part of <coroutine> (C++20 § 17.12
+“Coroutines”) the compiler needs to build coroutines, on top of the same builtins libstdc++ uses. */
+namespace std {
+
+template <typename Ret, typename... Args>
+struct coroutine_traits {
+   typedef typename Ret::promise_type promise_type;
+};
+
+template <typename Promise = void>
+struct coroutine_handle;
+
+template <>
+struct coroutine_handle<void> {
+public:
+   constexpr coroutine_handle() noexcept :
+      frame{nullptr} {
+   }
+
+   constexpr coroutine_handle(decltype(nullptr)) noexcept :
+      frame{nullptr} {
+   }
+
+   static constexpr coroutine_handle from_address(void * frame_) noexcept {
+      coroutine_handle handle;
+      handle.frame = frame_;
+      return handle;
+   }
+
+   constexpr void * address() const noexcept {
+      return frame;
+   }
+
+   explicit constexpr operator bool() const noexcept {
+      return frame != nullptr;
+   }
+
+   bool done() const noexcept {
+      return __builtin_coro_done(frame);
+   }
+
+   void operator()() const {
+      resume();
+   }
+
+   void resume() const {
+      __builtin_coro_resume(frame);
+   }
+
+   void destroy() const {
+      __builtin_coro_destroy(frame);
+   }
+
+protected:
+   void * frame;
+};
+
+template <typename Promise>
+struct coroutine_handle : coroutine_handle<> {
+public:
+   constexpr coroutine_handle() noexcept {
+   }
+
+   constexpr coroutine_handle(decltype(nullptr)) noexcept {
+   }
+
+   static coroutine_handle from_promise(Promise & promise_) noexcept {
+      coroutine_handle handle;
+      handle.frame = __builtin_coro_promise(&promise_, __alignof(Promise), true);
+      return handle;
+   }
+
+   static constexpr coroutine_handle from_address(void * frame_) noexcept {
+      coroutine_handle handle;
+      handle.frame = frame_;
+      return handle;
+   }
+
+   Promise & promise() const {
+      return *static_cast<Promise *>(__builtin_coro_promise(frame, __alignof(Promise), false));
+   }
+};
+
+struct suspend_never {
+   constexpr bool await_ready() const noexcept {
+      return true;
+   }
+
+   constexpr void await_suspend(coroutine_handle<>) const noexcept {
+   }
+
+   constexpr void await_resume() const noexcept {
+   }
+};
+
+struct suspend_always {
+   constexpr bool await_ready() const noexcept {
+      return false;
+   }
+
+   constexpr void await_suspend(coroutine_handle<>) const noexcept {
+   }
+
+   constexpr void await_resume() const noexcept {
+   }
+};
+
+} //namespace std
+
+#endif //if !__has_include(<coroutine>)
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace rawr { namespace _pvt {
+
+// Only declared: calls that survive optimization fail the build, with this message.
+void task_frame_too_large() __attribute__((error(
+   "coroutine frame larger than FrameSize; increase the FrameSize of its rawr::task"
+)));
+
+}} //namespace rawr::_pvt
+
+namespace rawr {
+
+/*! Return type of coroutines, allowing them to wait on timer_mux::delay(), binary_input_pin::changed() and
+other awaitables instead of chaining callbacks:
+
+   rawr::task<> blink(rawr::timer_mux<0> & timer_mux, rawr::hw::binary_output_pin<'B', 3> & led) {
+      for (;;) {
+         led.toggle();
+         co_await timer_mux.delay(250_ms);
+      }
+   }
+
+A task starts running as soon as the coroutine is called, until its first co_await; it’s then resumed by
+whatever it awaits, e.g. by the event loop if RAWR_DEFERRED_CALLBACKS is defined, and its frame is released
+when it returns. The returned task object only identifies the coroutine type, and can be discarded.
+
+Frames are never allocated from a heap: each task type has a pool of Capacity frames of FrameSize bytes,
+shared by all coroutines returning that type. A coroutine whose frame (its arguments, the locals and
+awaitables living across a co_await, and 13 bytes of bookkeeping) is larger than FrameSize fails to
+build if the compiler can prove the frame size constant, which g++ does at -O1 and above; at -O0 it results
+in abort() when the coroutine is started instead. Starting more than Capacity coroutines of the same task
+type at the same time results in abort(). In host builds, where frames are made much larger by pointers and
+padding, each frame gets FrameSize * sizeof(void *) bytes instead.
+
+Note: g++ 12 miscompiles co_await used directly as the condition of an if statement in a loop; store its
+result in a variable first. */
+template <uint8_t Capacity = 1, unsigned FrameSize = 32>
+class task {
+public:
+   static_assert(Capacity >= 1 && Capacity <= 8, "Capacity must be 1 to 8");
+
+private:
+#ifdef RAWR_HOST
+   static constexpr unsigned frame_size{FrameSize * sizeof(void *)};
+#else
+   static constexpr unsigned frame_size{FrameSize};
+#endif
+
+public:
+   struct promise_type {
+      /* Always inlined into the coroutine, where size is a constant, so that whether the frame size check
+      happens at compile time doesn’t depend on the inliner’s heuristics. */
+      __attribute__((always_inline)) static void * operator new(decltype(sizeof 0) size) {
+         if (size > frame_size) {
+            // Only constant when optimizing: at -O0 __builtin_constant_p() is always false.
+            if (__builtin_constant_p(size)) {
+               _pvt::task_frame_too_large();
+            }
+            abort(abort_reason::task_frame_too_large);
+         }
+         return allocate_frame();
+      }
+
+      static void operator delete(void * p) {
+         auto index{static_cast<uint8_t>((static_cast<uint8_t *>(p) - frames[0]) / frame_size)};
+         used_frames &= static_cast<uint8_t>(~(1 << index));
+      }
+
+      //! Returns the first free frame in the pool, or aborts if there are none.
+      static void * allocate_frame() {
+         uint8_t frame_bit{1};
+         for (auto & frame : frames) {
+            if ((used_frames & frame_bit) == 0) {
+               used_frames |= frame_bit;
+               return frame;
+            }
+            frame_bit = static_cast<uint8_t>(frame_bit << 1);
+         }
+         abort(abort_reason::task_pool_full);
+         // abort() resets the device.
+         __builtin_unreachable();
+      }
+
+      task get_return_object() const {
+         return task{};
+      }
+
+      std::suspend_never initial_suspend() const noexcept {
+         return {};
+      }
+
+      std::suspend_never final_suspend() const noexcept {
+         return {};
+      }
+
+      void return_void() const {
+      }
+
+      void unhandled_exception() const {
+         abort();
+      }
+   };
+
+private:
+   alignas(__BIGGEST_ALIGNMENT__) static inline uint8_t frames[Capacity][frame_size];
+   //! Bit i is set while frames[i] is in use.
+   static inline uint8_t used_frames;
+};
+
+/*! Callback type that resumes a coroutine waiting on it via wait(), passing it the argument of the call;
+calls with no coroutine waiting do nothing. Used as Callback of e.g. rawr::binary_input_pin, to allow
+co_await pin.changed(), or on its own as an event a coroutine can wait for. */
+template <typename Arg>
+class resume_callback {
+public:
+   struct awaiter {
+      resume_callback & callback;
+
+      bool await_ready() const {
+         return false;
+      }
+
+      void await_suspend(std::coroutine_handle<> handle) {
+         callback.waiter = handle;
+      }
+
+      Arg await_resume() const {
+         return callback.arg;
+      }
+   };
+
+public:
+   constexpr resume_callback() :
+      waiter{},
+      arg{} {
+   }
+
+   //! Returns true, so that the owner keeps invoking it; calls check whether a coroutine is waiting.
+   explicit constexpr operator bool() const {
+      return true;
+   }
+
+   //! Resumes the waiting coroutine, if any, which will be able to wait again before this returns.
+   void operator()(Arg arg_) {
+      if (auto handle{waiter}) {
+         waiter = nullptr;
+         arg = arg_;
+         handle.resume();
+      }
+   }
+
+   //! Returns an awaitable suspending the awaiting coroutine until the next call.
+   awaiter wait() {
+      return awaiter{*this};
+   }
+
+private:
+   //! Coroutine suspended in wait().
+   std::coroutine_handle<> waiter;
+   //! Argument of the last call that resumed a coroutine.
+   Arg arg;
+};
+
+} //namespace rawr
@@ -17,9 +17,15 @@ more details.
 #include <rawr/abort.hxx>
 #include <rawr/alias.hxx>
 #include <rawr/chrono.hxx>
+#ifdef RAWR_DEFERRED_CALLBACKS
+   #include <rawr/event_loop.hxx>
+#endif
 #include <rawr/function.hxx>
 #include <rawr/hw/timer_counter.hxx>
 #include <rawr/misc.hxx>
+#include <rawr/power_manager.hxx>
+#include <rawr/task.hxx>
+#include <rawr/trace.hxx>
 
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -36,7 +42,9 @@ struct timer_mux_asm;
       } \
    };
 #define _RAWR_SPECIALIZE_TIMER_DELAY_ASM(index, comparator_ascii, vector) \
-   _RAWR_SPECIALIZE_TIMER_DELAY_ASM_IMPL(index, comparator_ascii, vector, "_ZN4rawr9timer_muxILi" RAWR_TOSTRING(index))
+   _RAWR_SPECIALIZE_TIMER_DELAY_ASM_IMPL( \
+      index, comparator_ascii, vector, "_ZN4rawr4_pvt16timer_mux_vectorILi" RAWR_TOSTRING(index) \
+   )
 #ifdef TIMER0_COMPA_vect
    _RAWR_SPECIALIZE_TIMER_DELAY_ASM(0, 65 /*A*/, TIMER0_COMPA_vect)
 #endif
@@ -71,40 +79,107 @@ inline constexpr uint16_t default_timer_mux_prescaler() {
                                                    8;
 }
 
-}} //namespace rawr::_pvt
+//! Given a goal of max tick duration = 1 µs, returns the largest prescaler appropriate for frequency.
+inline constexpr uint16_t microsecond_timer_mux_prescaler() {
+   return prescaled_period(  64) <=   1000_ns ?   64 :
+          prescaled_period(   8) <=   1000_ns ?    8 :
+                                                   1;
+}
 
-namespace rawr {
+//! Selects timer_mux’s prescaler and conversion of durations to ticks, based on the unit of its durations.
+template <typename Resolution>
+struct timer_mux_resolution {
+   // Check for just any value known to be false.
+   static_assert(sizeof(Resolution) < 0, "timer_mux only supports milliseconds and microseconds resolutions");
+};
+
+template <>
+struct timer_mux_resolution<chrono::milliseconds> {
+   static constexpr uint16_t prescaler{default_timer_mux_prescaler()};
+};
 
-/*! Millisecond-precision timer multiplexer. Allows to create many delays or virtual timers while consuming a
-single hardware timer.
+template <>
+struct timer_mux_resolution<chrono::microseconds> {
+   static constexpr uint16_t prescaler{microsecond_timer_mux_prescaler()};
+};
 
-Once created, a delay can be canceled by invoking cancel() on the returned object. Delays created with the
-repeat() method are automatically re-scheduled; those created with once() are not.
+/*! Tag type used to find, via ADL, the interrupt handler of the timer_mux_base instantiated for a
+timer/counter. The function is only declared here, and defined by timer_mux_base; this allows the interrupt
+vector to have a name that doesn’t depend on the callback type. */
+template <int Index>
+struct timer_mux_tag {
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wnon-template-friend"
+   friend void timer_mux_interrupt(timer_mux_tag);
+#pragma GCC diagnostic pop
+};
 
-The range for delays is 1 millisecond up to min_max_duration (currently 3 seconds); this range is chosen to
-avoid 32-bit math operations while at the same time minimizing the number of interrupts generated (i.e.
-wake-ups from sleep). */
 template <int Index>
-class timer_mux {
+class timer_mux_vector {
+protected:
+   static constexpr char comparator_name{'A'};
+
+private:
+   //! Interrupt vector. It has a weird name to work around g++’s name check for interrupt vectors.
+   static __attribute__((signal, used)) void __vector() {
+      timer_mux_asm<Index, comparator_name>::emit();
+      trace::isr_entry(trace::timer_mux_source(Index));
+      timer_mux_interrupt(timer_mux_tag<Index>{});
+      trace::isr_exit(trace::timer_mux_source(Index));
+   }
+};
+
+/*! Delay queue and interrupt handler of rawr::timer_mux. These are kept apart from the latter so that the
+queue code does not depend on its capacity; the interrupt vector, which needs to be aliased in assembly, is
+further kept apart in timer_mux_vector, so that its name doesn’t depend on Callback either.
+
+Scheduled delays are kept in a singly-linked list sorted by expiration time, each storing its distance in
+ticks from the previous one (or, for the first delay, from the last time the timer was reset). This way the
+interrupt handler only needs to look at the head of the list, and never iterate over delays that did not yet
+expire.
+
+Delays longer than 0xffff ticks are split into a first part followed by a number of chunk_ticks-long chunks,
+each enqueued in turn; this keeps the interrupt handler to 16-bit math.
+
+If RAWR_DEFERRED_CALLBACKS is defined, callbacks are posted to rawr::event_loop instead of being invoked by
+the interrupt handler. A delay stays allocated until its last posted callback has been dispatched, and a
+recurring delay expiring while its previous callback is still waiting to be dispatched is not posted again. */
+template <int Index, typename Callback>
+class timer_mux_base : private timer_mux_vector<Index> {
 public:
    static constexpr chrono::hertz frequency{F_CPU};
    static constexpr chrono::milliseconds min_max_duration{3000_ms};
 
-private:
+protected:
    struct delay_t {
-      uint16_t remaining_ticks;
+      //! Next delay in the queue, or in the list of available delays.
+      delay_t * next;
+      //! Ticks between the expiration of the previous delay in the queue and that of this one.
+      uint16_t delta_ticks;
+      //! Number of chunks left to wait after delta_ticks, before the delay actually expires.
+      uint16_t remaining_chunks;
+      //! Length of the first part of the period of recurring delays; 0 for non-recurring ones.
       uint16_t initial_ticks;
-      function<void ()> callback;
-
-      constexpr bool active() const {
-         return callback != nullptr;
-      }
+      //! Number of chunks making up the rest of the period of recurring delays.
+      uint16_t initial_chunks;
+#ifdef RAWR_DEFERRED_CALLBACKS
+      //! Combination of pending_flag and retired_flag.
+      uint8_t flags;
+#endif
+      Callback callback;
    };
 
+#ifdef RAWR_DEFERRED_CALLBACKS
+   //! Set in delay_t::flags while the delay’s callback is waiting in the event loop.
+   static constexpr uint8_t pending_flag{0x01};
+   //! Set in delay_t::flags if the delay left the queue while pending_flag was set.
+   static constexpr uint8_t retired_flag{0x02};
+#endif
+
 public:
    struct delay_control {
    private:
-      friend class timer_mux;
+      friend class timer_mux_base;
 
    public:
       constexpr delay_control() :
@@ -116,10 +191,9 @@ public:
       }
 
       void cancel() {
-         delay->callback = nullptr;
+         static_this->unschedule(delay);
          // Make sure *this can’t be reused.
          delay = nullptr;
-         // Don’t bother rescheduling the timer; that will happen when the interrupt occurs.
       }
 
    private:
@@ -131,16 +205,353 @@ public:
       delay_t * delay;
    };
 
-private:
-   static constexpr char comparator_name{'A'};
+protected:
+   using timer_mux_vector<Index>::comparator_name;
    typedef hw::timer_counter<Index> timer_counter_t;
    typedef typename timer_counter_t::template comparators<comparator_name> tc_comp;
    typedef typename timer_counter_t::value_type timer_ticks;
 
    static constexpr timer_ticks max_timer_ticks{static_cast<timer_ticks>(~timer_ticks{})};
-   static constexpr uint16_t prescaler{_pvt::default_timer_mux_prescaler()};
+   /*! Length of each chunk of long delays. As long as possible, to keep the number of interrupts to what the
+   timer needs anyway; for 16-bit timers, that’s the same as max_timer_ticks. */
+   static constexpr uint16_t chunk_ticks{0xffff};
+
+protected:
+   timer_mux_base() :
+      queue_head{nullptr},
+      free_delays{nullptr} {
+      static_this = this;
+      power_manager::power_up(timer_counter_power_reduction<Index>::bit);
+#ifdef RAWR_POWER_MANAGEMENT
+      power_manager::set_timebase(&timebase);
+#endif
+   }
+
+   //! Makes a delay available for scheduling.
+   void release(delay_t * delay) {
+      delay->next = free_delays;
+      free_delays = delay;
+   }
+
+   //! Schedules a callback to be invoked after the specified number of ticks.
+   delay_control schedule(uint16_t ticks, bool recurring, Callback const & callback) {
+      return schedule(ticks, 0, recurring, callback);
+   }
+
+   /*! Schedules a callback to be invoked after the specified number of ticks, which may exceed 0xffff. Any
+   32-bit math happens here, rather than in the interrupt handler. */
+   delay_control schedule(uint32_t ticks, bool recurring, Callback const & callback) {
+      if (ticks <= 0xffff) {
+         // Also keeps 0 from wrapping around in the chunk calculation below.
+         return schedule(static_cast<uint16_t>(ticks), 0, recurring, callback);
+      }
+      auto chunks{static_cast<uint16_t>((ticks - 1) / chunk_ticks)};
+      auto first_ticks{static_cast<uint16_t>(ticks - static_cast<uint32_t>(chunks) * chunk_ticks)};
+      return schedule(first_ticks, chunks, recurring, callback);
+   }
+
+private:
+   delay_control schedule(
+      uint16_t first_ticks, uint16_t chunks, bool recurring, Callback const & callback
+   ) {
+      /* Disable the timer interrupt to make sure the queue doesn’t change while we manipulate it. This is
+      also safe to do from a callback, since those are invoked with interrupts disabled. */
+      timer_counter_t::interrupt_mask.clear_bit(tc_comp::interrupt_enable_bit);
+      auto delay{free_delays};
+      if (!delay) {
+         abort(abort_reason::timer_mux_full);
+      }
+      free_delays = delay->next;
+      delay->remaining_chunks = chunks;
+      delay->initial_ticks = recurring ? first_ticks : 0;
+      delay->initial_chunks = chunks;
+#ifdef RAWR_DEFERRED_CALLBACKS
+      delay->flags = 0;
+#endif
+      delay->callback = move(callback);
+      // Make the head of the queue relative to now, which is what first_ticks is relative to.
+      consume_elapsed_ticks();
+      enqueue(delay, first_ticks);
+      arm();
+      return delay_control{delay};
+   }
+
+   /*! Removes a delay from the queue, if it’s still there, making it available for reuse right away instead
+   of when it would have expired; its callback won’t be invoked, even if already posted to the event loop. */
+   void unschedule(delay_t * delay) {
+      timer_counter_t::interrupt_mask.clear_bit(tc_comp::interrupt_enable_bit);
+      consume_elapsed_ticks();
+      delay->callback = nullptr;
+      for (delay_t ** next_ptr{&queue_head}; *next_ptr; next_ptr = &(*next_ptr)->next) {
+         if (*next_ptr == delay) {
+            if (auto next{delay->next}) {
+               /* The next delay will now expire relative to the previous one. This can’t overflow, since no
+               delay is enqueued further than 0xffff ticks from the head. */
+               next->delta_ticks = static_cast<uint16_t>(next->delta_ticks + delay->delta_ticks);
+            }
+            *next_ptr = delay->next;
+            retire(delay);
+            break;
+         }
+      }
+      arm();
+   }
+
+   /*! Subtracts from the queue the ticks elapsed since the last reset of the timer, and resets the timer. See
+   consume_ticks(). */
+   void consume_elapsed_ticks() {
+      timer_ticks elapsed_ticks{timer_counter_t::value};
+      timer_counter_t::value = 0;
+      consume_ticks(elapsed_ticks);
+   }
+
+   /*! Subtracts the specified ticks from the queue, starting from its head. Ticks in excess of those left to
+   the head (e.g. because the interrupt was serviced late) are carried into the delays after it, which would
+   otherwise expire late by as much. */
+   void consume_ticks(uint16_t ticks) {
+      for (auto delay{queue_head}; delay && ticks != 0; delay = delay->next) {
+         auto consumed{min(ticks, delay->delta_ticks)};
+         delay->delta_ticks = static_cast<uint16_t>(delay->delta_ticks - consumed);
+         ticks = static_cast<uint16_t>(ticks - consumed);
+      }
+   }
+
+   //! Inserts a delay in the queue, after any delays expiring at or before the same time.
+   void enqueue(delay_t * delay, uint16_t ticks) {
+      delay_t ** next_ptr{&queue_head};
+      for (; *next_ptr && (*next_ptr)->delta_ticks <= ticks; next_ptr = &(*next_ptr)->next) {
+         ticks = static_cast<uint16_t>(ticks - (*next_ptr)->delta_ticks);
+      }
+      if (*next_ptr) {
+         // The next delay will now expire relative to this one.
+         (*next_ptr)->delta_ticks = static_cast<uint16_t>((*next_ptr)->delta_ticks - ticks);
+      }
+      delay->delta_ticks = ticks;
+      delay->next = *next_ptr;
+      *next_ptr = delay;
+   }
+
+   /*! Programs the comparator to fire when the head of the queue expires, or disables it if the queue is
+   empty. */
+   void arm() {
+      if (queue_head) {
+         /* Avoid 0: the counter was just reset, and writing it blocks a compare match on the next timer
+         clock, so 0 would only match after a complete overflow. */
+         tc_comp::top = static_cast<timer_ticks>(max(
+            min(queue_head->delta_ticks, static_cast<uint16_t>(max_timer_ticks)), uint16_t{1}
+         ));
+         timer_counter_t::interrupt_mask.set_bit(tc_comp::interrupt_enable_bit);
+         power_manager::require_io_clock(io_clock_user, true);
+      } else {
+         timer_counter_t::interrupt_mask.clear_bit(tc_comp::interrupt_enable_bit);
+         power_manager::require_io_clock(io_clock_user, false);
+      }
+   }
+
+   /*! Invokes the callback for any delays that expired, re-enqueueing recurring ones. Wake-ups that only
+   bring the head of the queue closer to its expiration (because it’s further away than max_timer_ticks) don’t
+   touch any other delay, and expired chunks of long delays only need to be re-enqueued. */
+   void interrupt() {
+      for (;;) {
+         // This also accounts for any time spent in callbacks invoked by the previous iteration.
+         consume_elapsed_ticks();
+         auto delay{queue_head};
+         if (!delay || delay->delta_ticks != 0) {
+            break;
+         }
+         queue_head = delay->next;
+         if (!delay->callback) {
+            // Scheduled without a callback.
+            retire(delay);
+         } else if (delay->remaining_chunks != 0) {
+            --delay->remaining_chunks;
+            enqueue(delay, chunk_ticks);
+         } else if (delay->initial_ticks != 0) {
+            // Re-enqueue it first, so the callback is free to cancel it.
+            delay->remaining_chunks = delay->initial_chunks;
+            enqueue(delay, delay->initial_ticks);
+            invoke(delay);
+         } else {
+            invoke(delay);
+            retire(delay);
+         }
+      }
+      arm();
+   }
+
+#ifdef RAWR_DEFERRED_CALLBACKS
+   //! Posts the delay’s callback to the event loop, unless it’s already there.
+   static void invoke(delay_t * delay) {
+      if ((delay->flags & pending_flag) == 0) {
+         delay->flags |= pending_flag;
+         event_loop::post(&dispatch, delay, 0);
+      }
+   }
+
+   //! Releases a delay that left the queue, or leaves that to dispatch() if the delay is still pending.
+   void retire(delay_t * delay) {
+      if ((delay->flags & pending_flag) != 0) {
+         delay->flags |= retired_flag;
+      } else {
+         delay->callback = nullptr;
+         release(delay);
+      }
+   }
+
+   //! Invoked by the event loop, with interrupts enabled.
+   static void dispatch(void * context, uint8_t) {
+      auto delay{static_cast<delay_t *>(context)};
+      if (delay->callback) {
+         delay->callback();
+      }
+      // The interrupt handler must not see the flags or the list of available delays change midway.
+      timer_counter_t::interrupt_mask.clear_bit(tc_comp::interrupt_enable_bit);
+      delay->flags &= static_cast<uint8_t>(~pending_flag);
+      if ((delay->flags & retired_flag) != 0) {
+         delay->flags = 0;
+         static_this->retire(delay);
+      }
+      if (static_this->queue_head) {
+         timer_counter_t::interrupt_mask.set_bit(tc_comp::interrupt_enable_bit);
+      }
+   }
+#else
+   static void invoke(delay_t * delay) {
+      delay->callback();
+   }
+
+   //! Releases a delay that left the queue.
+   void retire(delay_t * delay) {
+      delay->callback = nullptr;
+      release(delay);
+   }
+#endif
+
+   /*! Invoked by the interrupt vector. Being a friend, it’s declared in this namespace, where timer_mux_tag
+   declared it too. */
+   friend void timer_mux_interrupt(timer_mux_tag<Index>) {
+      static_this->interrupt();
+   }
+
+#ifdef RAWR_POWER_MANAGEMENT
+   //! See power_manager::timebase::suspend.
+   static uint16_t suspend() {
+      static_this->consume_elapsed_ticks();
+      suspended_cs = timer_counter_t::control_registers.get_cs();
+      timer_counter_t::control_registers.set_cs(0);
+      auto head{static_this->queue_head};
+      if (!head) {
+         return 0;
+      }
+      return static_cast<uint16_t>(min(
+         static_cast<uint32_t>(head->delta_ticks) * suspended_prescaler() / cycles_per_ms, uint32_t{0xffff}
+      ));
+   }
+
+   //! See power_manager::timebase::resume.
+   static void resume(uint16_t slept_ms) {
+      auto slept_ticks{static_cast<uint32_t>(slept_ms) * cycles_per_ms / suspended_prescaler()};
+      static_this->consume_ticks(static_cast<uint16_t>(min(slept_ticks, uint32_t{0xffff})));
+      // The counter was reset by suspend(), so the comparator can be re-armed for the updated head.
+      timer_counter_t::control_registers.set_cs(suspended_cs);
+      static_this->arm();
+   }
+
+   //! Returns the prescaler selected by suspended_cs.
+   static uint32_t suspended_prescaler() {
+      return hw::timer_counter_prescaler_list<Index>::values[suspended_cs - 1];
+   }
+#endif
+
+private:
+   static constexpr uint8_t io_clock_user{power_manager::timer_counter_clock(Index)};
+#ifdef RAWR_POWER_MANAGEMENT
+   static constexpr uint32_t cycles_per_ms{static_cast<uint32_t>(F_CPU / 1000)};
+   static constexpr power_manager::timebase timebase{io_clock_user, &suspend, &resume};
+   //! Clock Select bits saved by suspend().
+   static inline uint8_t suspended_cs;
+#endif
+
+
+   //! Delay expiring first; its delta_ticks is relative to the last reset of the timer.
+   delay_t * queue_head;
+   //! Delays available for scheduling.
+   delay_t * free_delays;
+   // Used to find *this from __vector().
+   static timer_mux_base * static_this;
+};
+
+template <int Index, typename Callback>
+__attribute__((used)) timer_mux_base<Index, Callback> * timer_mux_base<Index, Callback>::static_this;
+
+/*! Awaitable returned by timer_mux::delay(): schedules the resumption of the awaiting coroutine. The
+callback only captures the coroutine handle, so it fits any Callback that stores a copy of it. */
+template <typename TimerMux, typename Duration>
+struct timer_mux_delay {
+   TimerMux & timer_mux;
+   Duration duration;
+
+   bool await_ready() const {
+      return false;
+   }
+
+   void await_suspend(std::coroutine_handle<> handle) {
+      timer_mux.once(duration, [handle] () {
+         handle.resume();
+      });
+   }
+
+   void await_resume() const {
+   }
+};
+
+}} //namespace rawr::_pvt
+
+namespace rawr {
+
+/*! Timer multiplexer. Allows to create up to Capacity delays or virtual timers while consuming a single
+hardware timer.
+
+Once created, a delay can be canceled by invoking cancel() on the returned object. Delays created with the
+repeat() methods are automatically re-scheduled; those created with once() are not. Canceling a delay makes it
+available for reuse right away; scheduling more than Capacity delays at the same time results in abort().
+
+With the default Resolution, chrono::milliseconds, the range for delays is 1 millisecond up to
+min_max_duration (currently 3 seconds); this range is chosen to avoid 32-bit math operations while at the same
+time minimizing the number of interrupts generated (i.e. wake-ups from sleep). Longer delays, up to hours, can
+be specified in chrono::seconds; these need 32-bit math to be scheduled, but not when they expire.
+
+With Resolution = chrono::microseconds, the timer is prescaled for ticks of at most 1 µs, and delays are
+specified in chrono::microseconds or chrono::seconds; this is best used with a 16-bit timer/counter, to limit
+the number of wake-ups (see microsecond_timer_mux). In either case, delays in chrono::seconds are limited to
+2^32 ticks, i.e. max_seconds; longer ones are shortened to that, rather than wrapping around.
+
+Callback is the type each delay stores its callback as: the default rawr::function, rawr::inplace_function
+sized for the largest lambda actually scheduled, or rawr::function_ref if the lambdas are kept alive by the
+caller. Since a timer/counter has a single interrupt vector, only one Callback type can be used with each. */
+template <
+   int Index, unsigned Capacity = 5, typename Resolution = chrono::milliseconds,
+   typename Callback = function<void ()>
+>
+class timer_mux : public _pvt::timer_mux_base<Index, Callback> {
+private:
+   typedef _pvt::timer_mux_base<Index, Callback> timer_mux_base_;
+   typedef typename timer_mux_base_::delay_t delay_t;
+   typedef typename timer_mux_base_::timer_counter_t timer_counter_t;
+
+public:
+   using typename timer_mux_base_::delay_control;
+   using timer_mux_base_::frequency;
+   using timer_mux_base_::min_max_duration;
+
+private:
+   static constexpr uint16_t prescaler{_pvt::timer_mux_resolution<Resolution>::prescaler};
    typedef typename timer_counter_t::template prescalers<prescaler> tc_prescaler;
 
+   static constexpr uint32_t ticks_per_second{
+      static_cast<uint32_t>(int_round_div(frequency, prescaler).count())
+   };
+
    /* Given a goal of avoiding overflow of uint16_t for min_max_duration, returns a “milliscaler” appropriate
    for frequency and the given prescaler. A milliscaler must divide 1000 yielding an integer quotient. */
    static constexpr uint16_t default_milliscaler() {
@@ -153,116 +564,90 @@ private:
    static constexpr uint16_t milliscaler = default_milliscaler();
 
 public:
-   timer_mux() {
-      static_this = this;
-      timer.control_registers.set_cs(tc_prescaler::control_register_bits);
-   }
+   /*! Longest delay that can be specified in chrono::seconds, whose ticks must fit in 32 bits. Longer delays
+   are shortened to this, instead of wrapping around to a shorter one. */
+   static constexpr chrono::seconds max_seconds{static_cast<chrono::seconds::count_type>(
+      // The whole range of chrono::seconds, if possible.
+      min<uint32_t>(0xffff, 0xffffffff / ticks_per_second)
+   )};
 
-   delay_control once_or_repeat(
-      chrono::milliseconds duration, bool recurring, function<void ()> const & callback
-   ) {
-      delay_t * ret_delay{nullptr};
-      timer_ticks next_ticks{max_timer_ticks};
-      /* Disable the timer interrupt to make sure delays doesn’t change in the middle of iterating over it,
-      then get the current counter value to account for any spent ticks, since we’ll be resetting it to 0 at
-      the end of this function. */
-      TIMSK.clear_bit(tc_comp::interrupt_enable_bit);
-      timer_ticks curr_ticks{timer.value};
+   timer_mux() {
       for (auto & delay : delays) {
-         if (delay.active()) {
-            // Won’t be negative, or the interrupt would have been triggered.
-            delay.remaining_ticks -= curr_ticks;
-         } else {
-            if (ret_delay) {
-               // Already picked a return value.
-               continue;
-            }
-            /* Directly calculating:
-
-               ticks = duration * 1000 / (frequency / prescaler);
-
-            would overflow uint16_t on duration * 1000. On the other hand,
-
-               ticks = duration / (frequency / prescaler / 1000);
-
-            would introduce too much error on the frequency divisions for lower frequencies, even with proper
-            integer rounding.
-
-            Instead, calculate the number of ticks by using a “milliscaler” factor that ensures duration, up
-            to a value of at least min_max_duration, will not exceed 0xffff, while at the same time avoiding
-            excessive denominator values for the frequency division.
-            */
-            delay.remaining_ticks = int_round_div(
-               milliscaled_ticks(duration, prescaler, milliscaler),
-               1000 / milliscaler /*no remainder*/
-            );
-            delay.initial_ticks = recurring ? delay.remaining_ticks : 0;
-            delay.callback = move(callback);
-            ret_delay = &delay;
-         }
-         next_ticks = calc_next_ticks(next_ticks, delay.remaining_ticks);
-      }
-      if (!ret_delay) {
-         abort();
+         timer_mux_base_::release(&delay);
       }
+      timer_counter_t::control_registers.set_cs(tc_prescaler::control_register_bits);
+   }
 
-      // Reset the timer and (re-)enable the interrupt.
-      tc_comp::top = next_ticks;
-      timer.value = 0;
-      TIMSK.set_bit(tc_comp::interrupt_enable_bit);
+   delay_control once_or_repeat(Resolution duration, bool recurring, Callback const & callback) {
+      return timer_mux_base_::schedule(ticks(duration), recurring, callback);
+   }
 
-      return delay_control{ret_delay};
+   delay_control once_or_repeat(
+      chrono::seconds duration, bool recurring, Callback const & callback
+   ) {
+      auto count{static_cast<uint32_t>(min(duration.count(), max_seconds.count()))};
+      return timer_mux_base_::schedule(count * ticks_per_second, recurring, callback);
    }
 
    /*! Schedules a delayed call to the specified callback. The call can be prevented by invoking cancel() on
    the returned object. */
-   delay_control once(chrono::milliseconds delay, function<void ()> const & callback) {
+   delay_control once(Resolution delay, Callback const & callback) {
+      return once_or_repeat(delay, false, callback);
+   }
+   delay_control once(chrono::seconds delay, Callback const & callback) {
       return once_or_repeat(delay, false, callback);
    }
 
    /*! Schedules a virtual timer to repeatedly call the specified callback. Invoking cancel() on the returned
    object ends the calls. */
-   delay_control repeat(chrono::milliseconds period, function<void ()> const & callback) {
+   delay_control repeat(Resolution period, Callback const & callback) {
       return once_or_repeat(period, true, callback);
    }
+   delay_control repeat(chrono::seconds period, Callback const & callback) {
+      return once_or_repeat(period, true, callback);
+   }
+
+   /*! Returns an awaitable suspending the awaiting rawr::task coroutine for the specified duration, using one
+   of the Capacity delays until then; with RAWR_DEFERRED_CALLBACKS, that delay is only released once the
+   coroutine suspends again, so a coroutine awaiting delays in a loop needs two. Callback can’t be
+   rawr::function_ref, since there is no lambda to keep alive. */
+   _pvt::timer_mux_delay<timer_mux, Resolution> delay(Resolution duration) {
+      return {*this, duration};
+   }
+   _pvt::timer_mux_delay<timer_mux, chrono::seconds> delay(chrono::seconds duration) {
+      return {*this, duration};
+   }
 
 private:
-   static constexpr timer_ticks calc_next_ticks(timer_ticks next_ticks, uint16_t remaining_ticks) {
-      return static_cast<timer_ticks>(min(
-         min(remaining_ticks, static_cast<uint16_t>(next_ticks)),
-         static_cast<uint16_t>(~timer_ticks{0})
-      ));
+   static uint16_t ticks(chrono::milliseconds duration) {
+      /* Directly calculating:
+
+         ticks = duration * 1000 / (frequency / prescaler);
+
+      would overflow uint16_t on duration * 1000. On the other hand,
+
+         ticks = duration / (frequency / prescaler / 1000);
+
+      would introduce too much error on the frequency divisions for lower frequencies, even with proper
+      integer rounding.
+
+      Instead, calculate the number of ticks by using a “milliscaler” factor that ensures duration, up to a
+      value of at least min_max_duration, will not exceed 0xffff, while at the same time avoiding excessive
+      denominator values for the frequency division.
+      */
+      return int_round_div(
+         milliscaled_ticks(duration, prescaler, milliscaler),
+         static_cast<uint16_t>(1000 / milliscaler) /*no remainder*/
+      );
    }
 
-   /*! Iterates over the delays, invoking the callback for any that expired. It uses the timer to track how
-   much time elapsed since it started running, for improved precision. */
-   void interrupt() {
-      // Must use tc_comp::top instead of timer.value because by now value has already been reset to 0.
-      timer_ticks curr_ticks = tc_comp::top, next_ticks = max_timer_ticks;
-      bool any_active = false;
-      for (auto & delay : delays) {
-         if (delay.active()) {
-            auto new_remaining_ticks = delay.remaining_ticks - curr_ticks;
-            if (static_cast<int16_t>(new_remaining_ticks) <= 0) {
-               delay.callback();
-               if (delay.initial_ticks == 0) {
-                  delay.callback = nullptr;
-                  continue;
-               }
-               new_remaining_ticks = delay.initial_ticks;
-            }
-            delay.remaining_ticks = new_remaining_ticks;
-            next_ticks = calc_next_ticks(next_ticks, new_remaining_ticks);
-            any_active = true;
-         }
-      }
-      if (any_active) {
-         // Reset the timer, and keep the interrupt enabled.
-         tc_comp::top = next_ticks;
-         timer.value = 0;
-      } else {
-         TIMSK.clear_bit(tc_comp::interrupt_enable_bit);
-      }
+   static uint32_t ticks(chrono::microseconds duration) {
+      // Reduce ticks_per_second / 1000000 to the smallest terms, to postpone overflow as much as possible.
+      constexpr uint32_t divisor{gcd(ticks_per_second, 1000000)};
+      constexpr uint32_t multiplier{ticks_per_second / divisor}, denominator{1000000 / divisor};
+      // Like max_seconds, saturate instead of wrapping around; this also leaves room for the rounding.
+      constexpr uint32_t max_count{(0xffffffff - denominator / 2) / multiplier};
+      return int_round_div(min(duration.count(), max_count) * multiplier, denominator);
    }
 
    template <typename Ret = uint16_t>
@@ -274,21 +659,15 @@ private:
       );
    }
 
-   //! Interrupt vector. It has a weird name to work around g++’s name check for interrupt vectors.
-   static __attribute__((signal, used)) void __vector() {
-      _pvt::timer_mux_asm<Index, comparator_name>::emit();
-      static_this->interrupt();
-   }
-
 private:
-   timer_counter_t timer;
-   // Fixed-size array of delays.
-   delay_t delays[5];
-   // Used to find *this from __vector().
-   static timer_mux * static_this;
+   // Fixed-size array of delays, threaded onto the queue or the list of available delays.
+   delay_t delays[Capacity];
 };
 
-template <int Index>
-__attribute__((used)) timer_mux<Index> * timer_mux<Index>::static_this;
+/*! Timer multiplexer with microsecond resolution, using the 16-bit timer/counter 1 so that each interrupt can
+cover as much time as possible. */
+template <unsigned Capacity = 5, typename Callback = function<void ()>>
+using microsecond_timer_mux = timer_mux<1, Capacity, chrono::microseconds, Callback>;
 
 } //namespace rawr
+
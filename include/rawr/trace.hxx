@@ -0,0 +1,175 @@
+/* -*- coding: utf-8; mode: c++; tab-width: 3; indent-tabs-mode: nil -*-
+
+Copyright 2022 Raffaello D. Di Napoli
+
+This file is part of RAWR.
+
+RAWR is free software: you can redistribute it and/or modify it under the terms of version 2.1 of the GNU
+Lesser General Public License as published by the Free Software Foundation.
+
+RAWR is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for
+more details.
+------------------------------------------------------------------------------------------------------------*/
+
+#pragma once
+
+#include <inttypes.h>
+#ifdef RAWR_TRACE
+   #include <rawr/hw/io.hxx>
+   #include <rawr/steady_clock.hxx>
+   #ifdef RAWR_HOST
+      #include <rawr/host.hxx>
+   #else
+      #include <avr/interrupt.h>
+   #endif
+#endif
+
+//! Number of records kept by rawr::trace; once full, each new record overwrites the oldest one.
+#ifndef RAWR_TRACE_SIZE
+   #define RAWR_TRACE_SIZE 32
+#endif
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace rawr {
+
+/*! Trace buffer recording timestamped events: entry into and exit from interrupt handlers, and markers placed
+by the program, e.g. around a callback to measure its duration.
+
+Defining RAWR_TRACE before including any rawr header, as the index of the timer/counter of a
+rawr::steady_clock the program creates, enables recording; timestamps are that clock’s now(), and can be
+converted with its to(). The interrupt handlers of rawr::timer_mux, rawr::binary_input_pin and rawr::adc
+record their entry and exit. Without RAWR_TRACE, all methods generate no code.
+
+Records are kept in a ring of RAWR_TRACE_SIZE entries, overwriting the oldest one when full, so that the
+buffer always holds the latest events; drain() moves them out, e.g. to send them over a USART:
+
+   rawr::trace::record records[8];
+   while (auto count{rawr::trace::drain(records, RAWR_COUNTOF(records))}) {
+      usart.write(records, static_cast<uint16_t>(count * sizeof records[0]));
+      while (usart.busy()) {}
+   }
+
+Each record’s event is one of:
+
+•  0b00ssssss: entry into the interrupt handler of source s;
+•  0b01ssssss: exit from the interrupt handler of source s;
+•  0b1mmmmmmm: marker m.
+
+Sources 0x00–0x1f are reserved for RAWR (see timer_mux_source(), binary_input_port_source(),
+pin_change_port_source(), adc_source() and eeprom_source()); the program can use the rest for its own
+interrupt handlers. */
+class trace {
+public:
+   struct record {
+      //! steady_clock ticks at the time of the event.
+      uint32_t ticks;
+      uint8_t event;
+   };
+
+   static constexpr uint8_t isr_exit_flag{0x40};
+   static constexpr uint8_t marker_flag{0x80};
+
+public:
+   //! Returns the source used by the interrupt handler of rawr::timer_mux on timer/counter index.
+   static constexpr uint8_t timer_mux_source(int index) {
+      return static_cast<uint8_t>(index);
+   }
+
+   //! Returns the source used by the pin change interrupt handler of rawr::binary_input_pin on port.
+   static constexpr uint8_t binary_input_port_source(char port) {
+      return static_cast<uint8_t>(0x08 + (port - 'A'));
+   }
+
+   //! Returns the source used by the pin change interrupt handler of rawr::pin_change_port on port.
+   static constexpr uint8_t pin_change_port_source(char port) {
+      return static_cast<uint8_t>(0x18 + (port - 'A'));
+   }
+
+   //! Returns the source used by the conversion complete interrupt handler of rawr::adc.
+   static constexpr uint8_t adc_source() {
+      return 0x10;
+   }
+
+   //! Returns the source used by the EEPROM ready interrupt handler of rawr::eeprom_store.
+   static constexpr uint8_t eeprom_source() {
+      return 0x11;
+   }
+
+#ifdef RAWR_TRACE
+   static_assert(RAWR_TRACE_SIZE > 0 && RAWR_TRACE_SIZE < 256, "RAWR_TRACE_SIZE must fit in uint8_t");
+
+   //! Records entry into the interrupt handler of source.
+   static void isr_entry(uint8_t source) {
+      add(source);
+   }
+
+   //! Records exit from the interrupt handler of source.
+   static void isr_exit(uint8_t source) {
+      add(static_cast<uint8_t>(isr_exit_flag | source));
+   }
+
+   //! Records marker id, which must be less than 0x80.
+   static void mark(uint8_t id) {
+      add(static_cast<uint8_t>(marker_flag | id));
+   }
+
+   /*! Moves up to max_count of the oldest records into dst, returning how many were moved; 0 means the buffer
+   is empty. Interrupts are disabled while copying, so max_count should be kept small. */
+   static uint8_t drain(record * dst, uint8_t max_count) {
+      uint8_t sreg{SREG};
+      cli();
+      uint8_t count{0};
+      for (; count < max_count && size != 0; ++count) {
+         dst[count] = records[first];
+         if (++first == RAWR_TRACE_SIZE) {
+            first = 0;
+         }
+         --size;
+      }
+      SREG = sreg;
+      return count;
+   }
+
+private:
+   static void add(uint8_t event) {
+      uint8_t sreg{SREG};
+      cli();
+      auto ticks{_pvt::steady_clock_base<RAWR_TRACE>::now()};
+      auto tail{static_cast<unsigned>(first + size)};
+      if (tail >= RAWR_TRACE_SIZE) {
+         tail -= RAWR_TRACE_SIZE;
+      }
+      records[tail].ticks = ticks;
+      records[tail].event = event;
+      if (size == RAWR_TRACE_SIZE) {
+         // Full: the oldest record was just overwritten.
+         if (++first == RAWR_TRACE_SIZE) {
+            first = 0;
+         }
+      } else {
+         ++size;
+      }
+      SREG = sreg;
+   }
+
+private:
+   static inline record records[RAWR_TRACE_SIZE];
+   //! Index of the oldest record.
+   static inline uint8_t first;
+   //! Number of records in the buffer.
+   static inline uint8_t size;
+#else
+   static void isr_entry(uint8_t) {
+   }
+
+   static void isr_exit(uint8_t) {
+   }
+
+   static void mark(uint8_t) {
+   }
+#endif
+};
+
+} //namespace rawr
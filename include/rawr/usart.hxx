@@ -0,0 +1,429 @@
+/* -*- coding: utf-8; mode: c++; tab-width: 3; indent-tabs-mode: nil -*-
+
+Copyright 2022 Raffaello D. Di Napoli
+
+This file is part of RAWR.
+
+RAWR is free software: you can redistribute it and/or modify it under the terms of version 2.1 of the GNU
+Lesser General Public License as published by the Free Software Foundation.
+
+RAWR is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for
+more details.
+------------------------------------------------------------------------------------------------------------*/
+
+#pragma once
+
+#include <rawr/abort.hxx>
+#include <rawr/alias.hxx>
+#ifdef RAWR_DEFERRED_CALLBACKS
+   #include <rawr/event_loop.hxx>
+#endif
+#include <rawr/function.hxx>
+#include <rawr/hw/usart.hxx>
+#include <rawr/misc.hxx>
+#include <rawr/power_manager.hxx>
+#include <rawr/serial_tx_queue.hxx>
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace rawr { namespace _pvt {
+
+template <int Index>
+struct usart_asm;
+
+#define _RAWR_SPECIALIZE_USART_ASM_IMPL(index, rx_vector, udre_vector, prefix) \
+   template <> \
+   struct usart_asm<index> { \
+      static void emit_rx() { \
+         RAWR_ALIAS(RAWR_TOSTRING(rx_vector), prefix "EE11__vector_rxEv"); \
+      } \
+      \
+      static void emit_udre() { \
+         RAWR_ALIAS(RAWR_TOSTRING(udre_vector), prefix "EE13__vector_udreEv"); \
+      } \
+   };
+#define _RAWR_SPECIALIZE_USART_ASM(index, rx_vector, udre_vector) \
+   _RAWR_SPECIALIZE_USART_ASM_IMPL( \
+      index, rx_vector, udre_vector, "_ZN4rawr4_pvt13usart_vectorsILi" RAWR_TOSTRING(index) \
+   )
+#if defined(USART0_RX_vect)
+   _RAWR_SPECIALIZE_USART_ASM(0, USART0_RX_vect, USART0_UDRE_vect)
+#elif defined(USART_RX_vect)
+   _RAWR_SPECIALIZE_USART_ASM(0, USART_RX_vect, USART_UDRE_vect)
+#elif defined(USART_RXC_vect)
+   _RAWR_SPECIALIZE_USART_ASM(0, USART_RXC_vect, USART_UDRE_vect)
+#endif
+#ifdef USART1_RX_vect
+   _RAWR_SPECIALIZE_USART_ASM(1, USART1_RX_vect, USART1_UDRE_vect)
+#endif
+#ifdef USART2_RX_vect
+   _RAWR_SPECIALIZE_USART_ASM(2, USART2_RX_vect, USART2_UDRE_vect)
+#endif
+#ifdef USART3_RX_vect
+   _RAWR_SPECIALIZE_USART_ASM(3, USART3_RX_vect, USART3_UDRE_vect)
+#endif
+#undef _RAWR_SPECIALIZE_USART_ASM
+#undef _RAWR_SPECIALIZE_USART_ASM_IMPL
+
+/*! Tag type used to find, via ADL, the interrupt handlers of the usart_base instantiated for a USART; see
+timer_mux_tag. */
+template <int Index>
+struct usart_tag {
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wnon-template-friend"
+   friend void usart_rx_interrupt(usart_tag);
+   friend void usart_udre_interrupt(usart_tag);
+#pragma GCC diagnostic pop
+};
+
+template <int Index>
+class usart_vectors {
+private:
+   //! Receive Complete interrupt vector. Its name starts with “__vector” to pass g++’s name check.
+   static __attribute__((signal, used)) void __vector_rx() {
+      usart_asm<Index>::emit_rx();
+      usart_rx_interrupt(usart_tag<Index>{});
+   }
+
+   //! Data Register Empty interrupt vector.
+   static __attribute__((signal, used)) void __vector_udre() {
+      usart_asm<Index>::emit_udre();
+      usart_udre_interrupt(usart_tag<Index>{});
+   }
+};
+
+/*! Buffers and interrupt handlers of rawr::usart, kept apart from it so that they don’t depend on the baud
+rate; the interrupt vectors are further kept apart in usart_vectors, so their names don’t depend on the
+buffer capacities either.
+
+The transmit queue is drained by the Data Register Empty interrupt, which is only enabled while the queue is
+not empty. Received bytes are stored by the Receive Complete interrupt in a ring buffer indexed by two
+free-running counters, each written by only one side, so reading doesn’t need to disable the interrupt. Like
+adc_base, this reaches the receive callback of rawr::usart via a function pointer, since its type is not known
+here. */
+template <int Index, uint8_t TxCapacity, uint8_t RxCapacity>
+class usart_base : private usart_vectors<Index> {
+protected:
+   typedef hw::usart<Index> usart_;
+
+   static_assert(
+      RxCapacity >= 2 && RxCapacity <= 128 && (RxCapacity & (RxCapacity - 1)) == 0,
+      "RxCapacity must be a power of 2, up to 128"
+   );
+
+protected:
+   /*! Queues a segment for transmission, disabling the Data Register Empty interrupt meanwhile; this is also
+   safe to do with interrupts disabled. */
+   static bool queue(void const * buffer, uint16_t size, bool progmem) {
+      usart_::control_status_b.clear_bit(usart_::data_register_empty_interrupt_enable_bit);
+      bool queued{tx_queue.push(buffer, size, progmem)};
+      resume_tx();
+      return queued;
+   }
+
+   static bool queue(uint8_t byte) {
+      usart_::control_status_b.clear_bit(usart_::data_register_empty_interrupt_enable_bit);
+      bool queued{tx_queue.push(byte)};
+      resume_tx();
+      return queued;
+   }
+
+   /*! Invoked by abort(): takes over from the Data Register Empty interrupt to transmit anything left in the
+   queue, followed by the abort reason, waiting for each byte to be transmitted. */
+   static void report_abort(abort_reason reason) {
+      usart_::control_status_b.clear_bit(usart_::data_register_empty_interrupt_enable_bit);
+      while (!tx_queue.empty()) {
+         transmit_polled(tx_queue.pop());
+      }
+      static constexpr char const prefix[] PROGMEM = "\r\nabort: ";
+      for (auto s{prefix}; pgm_read_byte(s) != 0; ++s) {
+         transmit_polled(pgm_read_byte(s));
+      }
+      auto code{static_cast<uint8_t>(reason)};
+      transmit_polled(hex_digit(static_cast<uint8_t>(code >> 4)));
+      transmit_polled(hex_digit(code & 0xf));
+      transmit_polled('\r');
+      transmit_polled('\n');
+      /* Clear the Transmit Complete flag (by writing 1 to it) only now that UDRn holds the last byte, so it
+      can’t be set by the end of the previous one; then wait for the last byte to be shifted out, or reset()
+      would cut it short. */
+      usart_::control_status_a = static_cast<uint8_t>(
+         (usart_::control_status_a & _BV(usart_::double_speed_bit)) | _BV(usart_::transmit_complete_bit)
+      );
+      while ((usart_::control_status_a & _BV(usart_::transmit_complete_bit)) == 0) {
+      }
+   }
+
+private:
+   //! Re-enables the Data Register Empty interrupt, if there’s anything to transmit.
+   static void resume_tx() {
+      if (!tx_queue.empty()) {
+         usart_::control_status_b.set_bit(usart_::data_register_empty_interrupt_enable_bit);
+#ifdef RAWR_HOST
+         // Writes to simulated registers don’t raise interrupts by themselves.
+         host::dispatch_interrupts();
+#endif
+      }
+   }
+
+   static void transmit_polled(uint8_t byte) {
+      while ((usart_::control_status_a & _BV(usart_::data_register_empty_bit)) == 0) {
+      }
+      usart_::data = byte;
+   }
+
+   static uint8_t hex_digit(uint8_t nibble) {
+      return static_cast<uint8_t>(nibble < 10 ? '0' + nibble : 'a' - 10 + nibble);
+   }
+
+   /*! Invoked by the interrupt vectors. Being friends, they’re declared in this namespace, where usart_tag
+   declared them too. */
+   friend void usart_udre_interrupt(usart_tag<Index>) {
+      usart_::data = tx_queue.pop();
+      if (tx_queue.empty()) {
+         usart_::control_status_b.clear_bit(usart_::data_register_empty_interrupt_enable_bit);
+      }
+   }
+
+   friend void usart_rx_interrupt(usart_tag<Index>) {
+      // Error flags are only valid until UDRn is read.
+      uint8_t status{usart_::control_status_a};
+      uint8_t byte{usart_::data};
+      if ((status & (_BV(usart_::frame_error_bit) | _BV(usart_::data_overrun_bit))) != 0) {
+         rx_error = true;
+         if ((status & _BV(usart_::frame_error_bit)) != 0) {
+            // byte is garbage; data overrun, on the other hand, means that earlier bytes were lost.
+            return;
+         }
+      }
+      if (static_cast<uint8_t>(rx_in - rx_out) == RxCapacity) {
+         rx_error = true;
+         return;
+      }
+      rx_buffer[rx_in & (RxCapacity - 1)] = byte;
+      rx_in = static_cast<uint8_t>(rx_in + 1);
+      if (rx_callback_owner && !rx_callback_pending) {
+         rx_callback_pending = true;
+#ifdef RAWR_DEFERRED_CALLBACKS
+         event_loop::post(rx_dispatch, rx_callback_owner, 0);
+#else
+         rx_dispatch(rx_callback_owner, 0);
+#endif
+      }
+   }
+
+protected:
+   static serial_tx_queue<TxCapacity> tx_queue;
+   static uint8_t rx_buffer[RxCapacity];
+   //! Count of bytes stored in rx_buffer; only written by the Receive Complete interrupt.
+   static uint8_t volatile rx_in;
+   //! Count of bytes read from rx_buffer; only written outside of the interrupt.
+   static uint8_t volatile rx_out;
+   //! Set if any received bytes were lost or garbled since the last check.
+   static bool volatile rx_error;
+   //! Set from posting the receive callback until it’s invoked, so that it’s not posted again meanwhile.
+   static bool volatile rx_callback_pending;
+   /*! Invokes the receive callback of rx_callback_owner. The signature matches event_loop::handler_t, so
+   that it can be posted as is. */
+   static void (* rx_dispatch)(void * owner, uint8_t);
+   //! rawr::usart whose receive callback is invoked as bytes arrive, or nullptr if none.
+   static void * rx_callback_owner;
+};
+
+template <int Index, uint8_t TxCapacity, uint8_t RxCapacity>
+serial_tx_queue<TxCapacity> usart_base<Index, TxCapacity, RxCapacity>::tx_queue;
+
+template <int Index, uint8_t TxCapacity, uint8_t RxCapacity>
+uint8_t usart_base<Index, TxCapacity, RxCapacity>::rx_buffer[RxCapacity];
+
+template <int Index, uint8_t TxCapacity, uint8_t RxCapacity>
+uint8_t volatile usart_base<Index, TxCapacity, RxCapacity>::rx_in;
+
+template <int Index, uint8_t TxCapacity, uint8_t RxCapacity>
+uint8_t volatile usart_base<Index, TxCapacity, RxCapacity>::rx_out;
+
+template <int Index, uint8_t TxCapacity, uint8_t RxCapacity>
+bool volatile usart_base<Index, TxCapacity, RxCapacity>::rx_error;
+
+template <int Index, uint8_t TxCapacity, uint8_t RxCapacity>
+bool volatile usart_base<Index, TxCapacity, RxCapacity>::rx_callback_pending;
+
+template <int Index, uint8_t TxCapacity, uint8_t RxCapacity>
+void (* usart_base<Index, TxCapacity, RxCapacity>::rx_dispatch)(void * owner, uint8_t);
+
+template <int Index, uint8_t TxCapacity, uint8_t RxCapacity>
+void * usart_base<Index, TxCapacity, RxCapacity>::rx_callback_owner;
+
+}} //namespace rawr::_pvt
+
+namespace rawr {
+
+/*! Interrupt-driven driver for a USART, in asynchronous mode with the frame format left at its default of 8
+data bits, no parity and 1 stop bit. The baud rate divisor is computed at compile time from F_CPU (see
+hw::usart_baud_rate), so an unachievable Baud fails to compile.
+
+Transmission never copies data: up to TxCapacity buffers, in RAM (write(), print()) or program memory
+(write_P(), print_P()), are queued as they are, and must not change until they’ve been transmitted, which
+busy() or flush() can tell. Each put() also takes one slot of the queue, so for telemetry it’s best to format
+into a buffer and write() that. All these return false, without queuing anything, if the queue is full.
+
+Received bytes are buffered by the interrupt handler in a ring of RxCapacity bytes, a power of 2; bytes that
+don’t fit, or that arrive garbled, are dropped, and reported by take_rx_error(). A receive callback can be
+set to read() them as they arrive, instead of polling; it’s invoked, or posted to rawr::event_loop if
+RAWR_DEFERRED_CALLBACKS is defined, with the count of bytes available, and not again until it’s returned, so
+it should read everything it can:
+
+   rawr::usart<0, 9600> usart;
+   usart.report_aborts();
+   usart.set_rx_callback([&usart] (uint8_t) {
+      uint8_t byte;
+      while (usart.read(&byte)) {
+         usart.put(byte);
+      }
+   });
+   usart.print_P(PSTR("hello\r\n"));
+   rawr::event_loop::run();
+
+Callback is the type the callback is stored as, like for rawr::binary_input_pin.
+
+MCUs without a USART can use rawr::usi_uart for transmission. */
+template <
+   int Index, uint32_t Baud, uint8_t TxCapacity = 4, uint8_t RxCapacity = 16,
+   typename Callback = function<void (uint8_t)>
+>
+class usart : public _pvt::usart_base<Index, TxCapacity, RxCapacity> {
+private:
+   typedef _pvt::usart_base<Index, TxCapacity, RxCapacity> usart_base_;
+   typedef hw::usart<Index> usart_;
+   typedef hw::usart_baud_rate<Baud> baud_rate;
+
+public:
+   /*! Configures the baud rate, and enables the receiver and the transmitter. The receiver keeps the CPU from
+   sleeping deeper than idle mode (see rawr::power_manager). */
+   usart() {
+      power_manager::power_up(_pvt::usart_power_reduction<Index>::bit);
+      power_manager::require_io_clock(power_manager::usart_clock(Index), true);
+      usart_::baud_rate_high = static_cast<uint8_t>(baud_rate::ubrr_value >> 8);
+      usart_::baud_rate_low = static_cast<uint8_t>(baud_rate::ubrr_value);
+      if (baud_rate::double_speed) {
+         /* Safe to read-modify-write: before the receiver and transmitter are enabled, no flag is set that
+         writing back would clear. */
+         usart_::control_status_a.set_bit(usart_::double_speed_bit);
+      }
+      usart_::control_status_b = static_cast<uint8_t>(
+         _BV(usart_::receive_complete_interrupt_enable_bit) |
+         _BV(usart_::receiver_enable_bit) | _BV(usart_::transmitter_enable_bit)
+      );
+   }
+
+   usart(usart const &) = delete;
+
+   /*! Destructor; disables the receiver, the transmitter and their interrupts, dropping anything still queued
+   (see flush()), and lets the CPU sleep deeper again. */
+   ~usart() {
+      usart_::control_status_b = 0;
+      usart_base_::tx_queue.clear();
+      usart_base_::rx_callback_owner = nullptr;
+      if (abort_reporter == &usart_base_::report_abort) {
+         abort_reporter = nullptr;
+      }
+      power_manager::require_io_clock(power_manager::usart_clock(Index), false);
+   }
+
+   usart & operator=(usart const &) = delete;
+
+   //! Queues size bytes from buffer, in RAM, for transmission.
+   bool write(void const * buffer, uint16_t size) {
+      return usart_base_::queue(buffer, size, false);
+   }
+
+   //! Queues size bytes from buffer, in program memory, for transmission.
+   bool write_P(void const * buffer, uint16_t size) {
+      return usart_base_::queue(buffer, size, true);
+   }
+
+   //! Queues a NUL-terminated string in RAM for transmission, without the NUL.
+   bool print(char const * s) {
+      return write(s, _pvt::string_length(s, false));
+   }
+
+   //! Queues a NUL-terminated string in program memory for transmission, without the NUL.
+   bool print_P(char const * s) {
+      return write_P(s, _pvt::string_length(s, true));
+   }
+
+   //! Queues a single byte for transmission; unlike the other methods, the byte is copied.
+   bool put(uint8_t byte) {
+      return usart_base_::queue(byte);
+   }
+
+   /*! Returns true if any queued data has not been handed to the USART yet; the last byte handed to it may
+   still be in transmission. */
+   bool busy() const {
+      return !usart_base_::tx_queue.empty();
+   }
+
+   //! Waits until all queued data has been handed to the USART. Interrupts must be enabled.
+   void flush() const {
+      while (busy()) {
+      }
+   }
+
+   //! Returns the number of received bytes waiting to be read.
+   uint8_t available() const {
+      return static_cast<uint8_t>(usart_base_::rx_in - usart_base_::rx_out);
+   }
+
+   //! Retrieves the oldest received byte; returns false if there’s none.
+   bool read(uint8_t * byte) {
+      uint8_t out{usart_base_::rx_out};
+      if (usart_base_::rx_in == out) {
+         return false;
+      }
+      *byte = usart_base_::rx_buffer[out & (RxCapacity - 1)];
+      usart_base_::rx_out = static_cast<uint8_t>(out + 1);
+      return true;
+   }
+
+   /*! Sets the callback to invoke when bytes are received, with the count of bytes available; it’s invoked
+   again for bytes received after it returns. */
+   template <typename F>
+   void set_rx_callback(F && callback_) {
+      rx_callback = forward<F>(callback_);
+      uint8_t sreg{SREG};
+      cli();
+      usart_base_::rx_callback_owner = rx_callback ? this : nullptr;
+      usart_base_::rx_dispatch = &rx_dispatch;
+      SREG = sreg;
+   }
+
+   //! Returns true, clearing the condition, if any received bytes were dropped since the last call.
+   bool take_rx_error() {
+      bool error{usart_base_::rx_error};
+      usart_base_::rx_error = false;
+      return error;
+   }
+
+   /*! Makes abort() transmit, after any data still queued, a line with its reason code in hexadecimal, e.g.
+   “abort: 02”. */
+   void report_aborts() {
+      abort_reporter = &usart_base_::report_abort;
+   }
+
+private:
+   //! Invoked by the interrupt handler, or by the event loop if RAWR_DEFERRED_CALLBACKS is defined.
+   static void rx_dispatch(void * owner, uint8_t) {
+      usart_base_::rx_callback_pending = false;
+      // The usart may have been destroyed, or its callback reset, after this was posted.
+      if (owner == usart_base_::rx_callback_owner) {
+         auto & owner_{*static_cast<usart *>(owner)};
+         owner_.rx_callback(owner_.available());
+      }
+   }
+
+private:
+   Callback rx_callback;
+};
+
+} //namespace rawr
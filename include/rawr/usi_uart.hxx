@@ -0,0 +1,321 @@
+/* -*- coding: utf-8; mode: c++; tab-width: 3; indent-tabs-mode: nil -*-
+
+Copyright 2022 Raffaello D. Di Napoli
+
+This file is part of RAWR.
+
+RAWR is free software: you can redistribute it and/or modify it under the terms of version 2.1 of the GNU
+Lesser General Public License as published by the Free Software Foundation.
+
+RAWR is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for
+more details.
+------------------------------------------------------------------------------------------------------------*/
+
+#pragma once
+
+#include <rawr/abort.hxx>
+#include <rawr/alias.hxx>
+#include <rawr/bitmanip.hxx>
+#include <rawr/hw/timer_counter.hxx>
+#include <rawr/hw/usi.hxx>
+#include <rawr/misc.hxx>
+#include <rawr/power_manager.hxx>
+#include <rawr/serial_tx_queue.hxx>
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace rawr { namespace _pvt {
+
+template <int Index>
+struct usi_uart_asm;
+
+#define _RAWR_SPECIALIZE_USI_UART_ASM(index, vector) \
+   template <> \
+   struct usi_uart_asm<index> { \
+      static void emit() { \
+         RAWR_ALIAS( \
+            RAWR_TOSTRING(vector), "_ZN4rawr4_pvt15usi_uart_vectorILi" RAWR_TOSTRING(index) "EE8__vectorEv" \
+         ); \
+      } \
+   };
+#if defined(USI_OVF_vect)
+   _RAWR_SPECIALIZE_USI_UART_ASM(0, USI_OVF_vect)
+#elif defined(USI_OVERFLOW_vect)
+   _RAWR_SPECIALIZE_USI_UART_ASM(0, USI_OVERFLOW_vect)
+#endif
+#undef _RAWR_SPECIALIZE_USI_UART_ASM
+
+//! Tag type used to find, via ADL, the interrupt handler of usi_uart_base; see timer_mux_tag.
+template <int Index>
+struct usi_uart_tag {
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wnon-template-friend"
+   friend void usi_uart_interrupt(usi_uart_tag);
+#pragma GCC diagnostic pop
+};
+
+template <int Index>
+class usi_uart_vector {
+private:
+   //! USI counter overflow interrupt vector. It has a weird name to work around g++’s name check.
+   static __attribute__((signal, used)) void __vector() {
+      usi_uart_asm<Index>::emit();
+      usi_uart_interrupt(usi_uart_tag<Index>{});
+   }
+};
+
+/*! Transmit queue and interrupt handler of rawr::usi_uart.
+
+Each frame is shifted out of USIDR in two parts, since the USI counter can’t count the 10 bits of a frame.
+With the USI clocked by timer/counter 0 (USICS1 = 0), the DO output latch is transparent: DO always shows
+bit 7 of USIDR, and writing USIDR changes it right away. So each part starts with the bit already on DO, and
+the counter overflows just as the last bit of a part starts being output, which leaves the interrupt handler
+a whole bit to load the next part without glitching the line: first the stop bit of the previous frame (or
+the idle level), the start bit and data bits 0-5; then data bit 5 again, data bits 6-7 and the stop bit.
+Data bits are shifted out MSB first, so each byte is bit-reversed first. After the last frame, the stop bit
+is held for one more clock before DO is handed back to its PORTx bit. */
+template <int Index, uint8_t TxCapacity>
+class usi_uart_base : private usi_uart_vector<Index> {
+protected:
+   typedef hw::usi<Index> usi_;
+
+   //! Value for USICR while transmitting: three-wire mode, clocked by timer/counter 0 compare matches.
+   static constexpr uint8_t active_control{
+      _BV(usi_::overflow_interrupt_enable_bit) | _BV(usi_::wire_mode_0_bit) | _BV(usi_::clock_select_0_bit)
+   };
+
+protected:
+   //! Queues a segment for transmission, starting it if the USI is idle.
+   static bool queue(void const * buffer, uint16_t size, bool progmem) {
+      usi_::control.clear_bit(usi_::overflow_interrupt_enable_bit);
+      bool queued{tx_queue.push(buffer, size, progmem)};
+      resume_tx();
+      return queued;
+   }
+
+   static bool queue(uint8_t byte) {
+      usi_::control.clear_bit(usi_::overflow_interrupt_enable_bit);
+      bool queued{tx_queue.push(byte)};
+      resume_tx();
+      return queued;
+   }
+
+   //! Invoked by abort(); see usart_base::report_abort().
+   static void report_abort(abort_reason reason) {
+      usi_::control.clear_bit(usi_::overflow_interrupt_enable_bit);
+      drain_polled();
+      static constexpr char const prefix[] PROGMEM = "\r\nabort: ";
+      static constexpr char const suffix[] PROGMEM = "\r\n";
+      auto code{static_cast<uint8_t>(reason)};
+      tx_queue.push(prefix, sizeof prefix - 1, true);
+      drain_polled();
+      tx_queue.push(hex_digit(static_cast<uint8_t>(code >> 4)));
+      drain_polled();
+      tx_queue.push(hex_digit(code & 0xf));
+      drain_polled();
+      tx_queue.push(suffix, sizeof suffix - 1, true);
+      drain_polled();
+   }
+
+private:
+   //! Starts transmitting if the USI is idle, or re-enables its interrupt otherwise.
+   static void resume_tx() {
+      if (usi_::control != 0) {
+         usi_::control.set_bit(usi_::overflow_interrupt_enable_bit);
+      } else if (!tx_queue.empty()) {
+         // Restart the baud rate clock, so the idle level is held for a whole bit before the start bit.
+         hw::timer_counter<0>::value = 0;
+         load_first_part();
+         usi_::control = active_control;
+         power_manager::require_io_clock(power_manager::usi_clock, true);
+      }
+   }
+
+   //! Transmits anything in the queue, waiting for each part of each frame to be shifted out.
+   static void drain_polled() {
+      if (usi_::control == 0) {
+         if (tx_queue.empty()) {
+            return;
+         }
+         hw::timer_counter<0>::value = 0;
+         load_first_part();
+         usi_::control = static_cast<uint8_t>(active_control & ~_BV(usi_::overflow_interrupt_enable_bit));
+      }
+      while (usi_::control != 0) {
+         while ((usi_::status & _BV(usi_::overflow_flag_bit)) == 0) {
+         }
+         overflow();
+      }
+   }
+
+   static uint8_t hex_digit(uint8_t nibble) {
+      return static_cast<uint8_t>(nibble < 10 ? '0' + nibble : 'a' - 10 + nibble);
+   }
+
+   /*! Loads the high level already on DO, the start bit and data bits 0-5 of the next byte, and counts 7 bits
+   (writing 1 clears USIOIF). */
+   static void load_first_part() {
+      second_part = bitmanip::reverse(tx_queue.pop());
+      usi_::data = static_cast<uint8_t>(0x80 | (second_part >> 2));
+      usi_::status = static_cast<uint8_t>(_BV(usi_::overflow_flag_bit) | (16 - 7));
+      second_part_pending = true;
+      stop_bit_held = false;
+   }
+
+   //! Invoked when the USI counter overflows, i.e. after each part of a frame has been clocked out.
+   static void overflow() {
+      if (second_part_pending) {
+         // Data bit 5, already on DO, data bits 6-7, then the stop bit.
+         usi_::data = static_cast<uint8_t>((second_part << 5) | 0x1f);
+         usi_::status = static_cast<uint8_t>(_BV(usi_::overflow_flag_bit) | (16 - 3));
+         second_part_pending = false;
+      } else if (!tx_queue.empty()) {
+         load_first_part();
+      } else if (!stop_bit_held) {
+         // The stop bit has just started; keep DO high until it ends.
+         usi_::data = 0xff;
+         usi_::status = static_cast<uint8_t>(_BV(usi_::overflow_flag_bit) | (16 - 1));
+         stop_bit_held = true;
+      } else {
+         // Hand DO back to its PORTx bit, which is high.
+         usi_::control = 0;
+         usi_::status = _BV(usi_::overflow_flag_bit);
+         power_manager::require_io_clock(power_manager::usi_clock, false);
+      }
+   }
+
+   friend void usi_uart_interrupt(usi_uart_tag<Index>) {
+      overflow();
+   }
+
+protected:
+   static serial_tx_queue<TxCapacity> tx_queue;
+   //! Bit-reversed byte being transmitted, whose bit 0 is data bit 7.
+   static uint8_t second_part;
+   //! true if the second part of the frame is still to be loaded into USIDR.
+   static bool second_part_pending;
+   //! true if the queue was found empty after the last frame, and only its stop bit is being completed.
+   static bool stop_bit_held;
+};
+
+template <int Index, uint8_t TxCapacity>
+serial_tx_queue<TxCapacity> usi_uart_base<Index, TxCapacity>::tx_queue;
+
+template <int Index, uint8_t TxCapacity>
+uint8_t usi_uart_base<Index, TxCapacity>::second_part;
+
+template <int Index, uint8_t TxCapacity>
+bool usi_uart_base<Index, TxCapacity>::second_part_pending;
+
+template <int Index, uint8_t TxCapacity>
+bool usi_uart_base<Index, TxCapacity>::stop_bit_held;
+
+//! Selects the timer/counter 0 prescaler and compare value generating Baud from F_CPU.
+template <uint32_t Baud>
+class usi_uart_baud_rate {
+private:
+   static constexpr uint32_t f_cpu{static_cast<uint32_t>(F_CPU)};
+
+   static constexpr uint32_t ticks(uint32_t prescaler_) {
+      return int_round_div(f_cpu, prescaler_ * Baud);
+   }
+
+   static constexpr uint32_t error_permille() {
+      auto actual{f_cpu / (prescaler * ticks(prescaler))};
+      return (actual > Baud ? actual - Baud : Baud - actual) * 1000 / Baud;
+   }
+
+public:
+   //! 1 if the bit period fits in 8 bits at full speed, else 8.
+   static constexpr uint16_t prescaler{ticks(1) <= 0x100 ? 1 : 8};
+   //! Value for OCR0A.
+   static constexpr uint8_t top{static_cast<uint8_t>(ticks(prescaler) - 1)};
+
+   static_assert(ticks(8) <= 0x100, "baud rate too low for F_CPU");
+   static_assert(ticks(1) >= 16, "baud rate too high for F_CPU");
+   // Same tolerance as hw::usart_baud_rate.
+   static_assert(error_permille() <= 20, "baud rate can’t be generated from F_CPU");
+};
+
+}} //namespace rawr::_pvt
+
+namespace rawr {
+
+/*! Transmit-only UART for MCUs without a USART, such as the ATtiny25/45/85, implemented with the Universal
+Serial Interface in three-wire mode: its DO pin is the TX line. Timer/counter 0 is taken over in CTC mode as
+the baud rate clock, so it can’t be used for anything else, e.g. rawr::timer_mux.
+
+The interface matches the transmit side of rawr::usart, including zero-copy transmission of buffers in RAM or
+program memory, and report_aborts(). Reception is not supported: detecting the start bit would need a pin
+change interrupt and resynchronizing the timer for every byte, which isn’t worth it for the telemetry and
+abort reports this is meant for. */
+template <uint32_t Baud, uint8_t TxCapacity = 4>
+class usi_uart : public _pvt::usi_uart_base<0, TxCapacity> {
+private:
+   typedef _pvt::usi_uart_base<0, TxCapacity> usi_uart_base_;
+   typedef typename usi_uart_base_::usi_ usi_;
+   typedef typename usi_::data_output_pin data_output_pin;
+   typedef hw::timer_counter<0> timer_counter_t;
+   typedef _pvt::usi_uart_baud_rate<Baud> baud_rate;
+
+public:
+   /*! Drives the TX line high (idle), and starts timer/counter 0 at the baud rate. While transmitting, the
+   CPU doesn’t sleep deeper than idle mode (see rawr::power_manager). */
+   usi_uart() {
+      power_manager::power_up(_pvt::usi_power_reduction<0>::bit);
+      power_manager::power_up(_pvt::timer_counter_power_reduction<0>::bit);
+      data_output_pin::port::data.set_bit(data_output_pin::pin);
+      data_output_pin::port::data_direction.set_bit(data_output_pin::pin);
+      usi_::control = 0;
+      // CTC mode, with TOP = OCR0A.
+      timer_counter_t::control_registers.set_wgm(2);
+      timer_counter_t::comparators<'A'>::top = baud_rate::top;
+      timer_counter_t::control_registers.set_cs(
+         timer_counter_t::prescalers<baud_rate::prescaler>::control_register_bits
+      );
+   }
+
+   //! See usart::write().
+   bool write(void const * buffer, uint16_t size) {
+      return usi_uart_base_::queue(buffer, size, false);
+   }
+
+   //! See usart::write_P().
+   bool write_P(void const * buffer, uint16_t size) {
+      return usi_uart_base_::queue(buffer, size, true);
+   }
+
+   //! See usart::print().
+   bool print(char const * s) {
+      return write(s, _pvt::string_length(s, false));
+   }
+
+   //! See usart::print_P().
+   bool print_P(char const * s) {
+      return write_P(s, _pvt::string_length(s, true));
+   }
+
+   //! See usart::put().
+   bool put(uint8_t byte) {
+      return usi_uart_base_::queue(byte);
+   }
+
+   //! Returns true if any queued data has not been completely transmitted yet.
+   bool busy() const {
+      return usi_::control != 0;
+   }
+
+   //! Waits until all queued data has been transmitted. Interrupts must be enabled.
+   void flush() const {
+      while (busy()) {
+      }
+   }
+
+   //! See usart::report_aborts().
+   void report_aborts() {
+      abort_reporter = &usi_uart_base_::report_abort;
+   }
+};
+
+} //namespace rawr
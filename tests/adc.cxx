@@ -0,0 +1,131 @@
+/* -*- coding: utf-8; mode: c++; tab-width: 3; indent-tabs-mode: nil -*-
+
+Copyright 2022 Raffaello D. Di Napoli
+
+This file is part of RAWR.
+
+RAWR is free software: you can redistribute it and/or modify it under the terms of version 2.1 of the GNU
+Lesser General Public License as published by the Free Software Foundation.
+
+RAWR is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for
+more details.
+------------------------------------------------------------------------------------------------------------*/
+
+/*! @file
+rawr::adc and <rawr/filter.hxx> tests: free running sample rate, results and channel switching, batched
+callbacks, overruns, and the output of each filter. The ADC tests are skipped on MCUs without one. */
+
+#include <rawr/filter.hxx>
+#include <rawr/hw/io.hxx>
+#ifdef ADCSRA
+   #include <rawr/adc.hxx>
+#endif
+#include "test.hxx"
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifdef ADCSRA
+
+typedef rawr::adc<rawr::adc_free_running_trigger, 32> adc_t;
+
+//! Simulated input: each channel reads as a different constant.
+static uint16_t read_input(uint8_t channel) {
+   return static_cast<uint16_t>(100 + channel * 100);
+}
+
+static void test_adc() {
+   rawr::host::adc_input = &read_input;
+   // Static, so the callback can use them without captures.
+   static adc_t adc{0};
+   static uint32_t samples_read;
+   static unsigned wrong_values, batches;
+   adc.set_callback(16, [] (uint8_t available) {
+      ++batches;
+      if (available < 16) {
+         ++wrong_values;
+      }
+      uint16_t samples[16];
+      for (uint8_t i = 0, count = adc.read(samples, 16); i < count; ++i) {
+         if (samples[i] != 100) {
+            ++wrong_values;
+         }
+         ++samples_read;
+      }
+   });
+
+   // Free running: one sample every conversion_cycles ADC clock cycles, after a longer first one.
+   rawr::host::advance(1_s);
+   RAWR_TEST_CHECK(samples_read + adc.available() + 1 >= adc_t::sample_rate * 99 / 100);
+   RAWR_TEST_CHECK(samples_read + adc.available() <= adc_t::sample_rate);
+   RAWR_TEST_CHECK(batches == samples_read / 16);
+   RAWR_TEST_CHECK(wrong_values == 0);
+   RAWR_TEST_CHECK(!adc.take_overrun());
+
+   // Up to two samples may still come from the old channel; after those, only the new one.
+   adc.set_callback(16, [] (uint8_t) {});
+   uint16_t samples[32];
+   adc.read(samples, 32);
+   adc.set_channel(2);
+   rawr::host::advance(10_ms);
+   auto count{adc.read(samples, 32)};
+   RAWR_TEST_CHECK(count > 4);
+   for (uint8_t i = 2; i < count; ++i) {
+      RAWR_TEST_CHECK(samples[i] == 300);
+   }
+
+   // The callback above doesn’t read, so the ring fills up, and further samples are dropped.
+   rawr::host::advance(50_ms);
+   RAWR_TEST_CHECK(adc.available() == 32);
+   RAWR_TEST_CHECK(adc.take_overrun());
+   RAWR_TEST_CHECK(!adc.take_overrun());
+
+   adc.stop();
+   adc.read(samples, 32);
+   rawr::host::advance(10_ms);
+   RAWR_TEST_CHECK(adc.available() == 0);
+}
+
+#endif //ifdef ADCSRA
+
+static void test_filters() {
+   rawr::decimator<4> average;
+   RAWR_TEST_CHECK(!average.push(1) && !average.push(2) && !average.push(3));
+   RAWR_TEST_CHECK(average.push(4) && average.value() == 2);
+
+   // 16 samples, keeping 2 more bits: the sum divided by 4.
+   rawr::decimator<16, 2> oversampler;
+   static_assert(decltype(oversampler)::output_bits == 12);
+   for (uint8_t i = 0; i < 15; ++i) {
+      oversampler.push(1000);
+   }
+   RAWR_TEST_CHECK(oversampler.push(1003) && oversampler.value() == 4000);
+
+   rawr::moving_average<4> moving{0};
+   RAWR_TEST_CHECK(moving.push(100) == 25);
+   RAWR_TEST_CHECK(moving.push(100) == 50);
+   RAWR_TEST_CHECK(moving.push(100) == 75);
+   RAWR_TEST_CHECK(moving.push(100) == 100);
+   RAWR_TEST_CHECK(moving.push(0) == 75);
+
+   // A step from 0 to 1023: about 63% of the way after 2^Shift samples, then settled.
+   rawr::iir_filter<3> iir{0};
+   uint16_t value{0};
+   for (uint8_t i = 0; i < 8; ++i) {
+      value = iir.push(1023);
+   }
+   RAWR_TEST_CHECK(value >= 1023 * 60 / 100 && value <= 1023 * 70 / 100);
+   for (uint8_t i = 0; i < 200; ++i) {
+      value = iir.push(1023);
+   }
+   RAWR_TEST_CHECK(value >= 1022 && value <= 1023);
+}
+
+int main() {
+   sei();
+#ifdef ADCSRA
+   test_adc();
+#endif
+   test_filters();
+   return rawr::test::result();
+}
@@ -0,0 +1,23 @@
+/* -*- coding: utf-8; mode: c++; tab-width: 3; indent-tabs-mode: nil -*-
+
+Copyright 2022 Raffaello D. Di Napoli
+
+This file is part of RAWR.
+
+RAWR is free software: you can redistribute it and/or modify it under the terms of version 2.1 of the GNU
+Lesser General Public License as published by the Free Software Foundation.
+
+RAWR is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for
+more details.
+------------------------------------------------------------------------------------------------------------*/
+
+/*! @file
+The rawr::binary_output_pin_aggregator tests in binary_output_pin_aggregator.cxx, with writes to PINx
+toggling PORTx as on the MCU, so that ports are updated via PINx instead of read-modify-write of PORTx. */
+
+#define RAWR_HOST_PINS_TOGGLE_DATA
+
+#include "binary_output_pin_aggregator.cxx"
+
+static_assert(rawr::hw::io_port<'B'>::pins_toggle_data, "PINx writes should toggle PORTx");
@@ -0,0 +1,133 @@
+/* -*- coding: utf-8; mode: c++; tab-width: 3; indent-tabs-mode: nil -*-
+
+Copyright 2022 Raffaello D. Di Napoli
+
+This file is part of RAWR.
+
+RAWR is free software: you can redistribute it and/or modify it under the terms of version 2.1 of the GNU
+Lesser General Public License as published by the Free Software Foundation.
+
+RAWR is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for
+more details.
+------------------------------------------------------------------------------------------------------------*/
+
+/*! @file
+rawr::binary_output_pin_aggregator tests: set() and set_atomically() are compared against a naive bit-by-bit
+reference over pseudo-random words and initial port values, for pin layouts that exercise both the shift and
+the nibble table mappings. Needs ports B, C and D, as on the ATmega328P; skipped on MCUs lacking any. */
+
+#include <rawr/binary_output_pin_aggregator.hxx>
+#include "test.hxx"
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#if defined(PORTB) && defined(PORTC) && defined(PORTD)
+
+using rawr::hw::io_port_pin;
+
+//! Ports the layouts below use.
+static constexpr char ports[]{'B', 'C', 'D'};
+
+//! Deterministic pseudo-random numbers (xorshift32).
+static uint32_t next_random() {
+   static uint32_t state{0x12345678};
+   state ^= state << 13;
+   state ^= state >> 17;
+   state ^= state << 5;
+   return state;
+}
+
+template <char Port>
+static uint8_t & port_value(uint8_t (& values)[RAWR_COUNTOF(ports)]) {
+   return values[Port - 'B'];
+}
+
+//! Sets the bit of port_values for each pin, one by one; the first pin gets the most significant bit.
+template <typename... IoPortPins>
+static void naive_set(uint8_t (& port_values)[RAWR_COUNTOF(ports)], uint32_t word) {
+   unsigned bit{sizeof...(IoPortPins)};
+   ((
+      --bit,
+      ((word >> bit) & 1) != 0 ?
+         port_value<IoPortPins::port::name>(port_values) |= _BV(IoPortPins::pin) :
+         port_value<IoPortPins::port::name>(port_values) &= static_cast<uint8_t>(~_BV(IoPortPins::pin))
+   ), ...);
+}
+
+static void write_ports(uint8_t const (& port_values)[RAWR_COUNTOF(ports)]) {
+   rawr::hw::io_port<'B'>::data = port_values[0];
+   rawr::hw::io_port<'C'>::data = port_values[1];
+   rawr::hw::io_port<'D'>::data = port_values[2];
+}
+
+static bool ports_equal(uint8_t const (& port_values)[RAWR_COUNTOF(ports)]) {
+   return
+      rawr::hw::io_port<'B'>::data == port_values[0] &&
+      rawr::hw::io_port<'C'>::data == port_values[1] &&
+      rawr::hw::io_port<'D'>::data == port_values[2];
+}
+
+template <typename... IoPortPins>
+static void test_layout() {
+   typedef rawr::binary_output_pin_aggregator<IoPortPins...> aggregator_t;
+   constexpr auto word_mask{static_cast<uint32_t>((uint64_t{1} << sizeof...(IoPortPins)) - 1)};
+   aggregator_t aggregator;
+   unsigned mismatches{0};
+   for (unsigned i = 0; i < 1000; ++i) {
+      // Random starting values for all pins, so that pins not in the aggregator are checked as well.
+      uint8_t expected[RAWR_COUNTOF(ports)];
+      for (auto & port_value_ : expected) {
+         port_value_ = static_cast<uint8_t>(next_random());
+      }
+      write_ports(expected);
+      auto word{next_random() & word_mask};
+      naive_set<IoPortPins...>(expected, word);
+      if (i % 2 == 0) {
+         aggregator.set(static_cast<typename aggregator_t::word_type>(word));
+      } else {
+         aggregator.set_atomically(static_cast<typename aggregator_t::word_type>(word));
+      }
+      if (!ports_equal(expected)) {
+         ++mismatches;
+      }
+   }
+   RAWR_TEST_CHECK(mismatches == 0);
+}
+
+int main() {
+   // Same order as the port: a single shift group.
+   test_layout<
+      io_port_pin<'B', 7>, io_port_pin<'B', 6>, io_port_pin<'B', 5>, io_port_pin<'B', 4>,
+      io_port_pin<'B', 3>, io_port_pin<'B', 2>, io_port_pin<'B', 1>, io_port_pin<'B', 0>
+   >();
+   // Reversed: one shift per bit, so nibble tables are cheaper.
+   test_layout<
+      io_port_pin<'D', 0>, io_port_pin<'D', 1>, io_port_pin<'D', 2>, io_port_pin<'D', 3>,
+      io_port_pin<'D', 4>, io_port_pin<'D', 5>, io_port_pin<'D', 6>, io_port_pin<'D', 7>
+   >();
+   // Scattered across three ports.
+   test_layout<
+      io_port_pin<'D', 5>, io_port_pin<'B', 1>, io_port_pin<'C', 3>, io_port_pin<'D', 0>,
+      io_port_pin<'B', 6>, io_port_pin<'C', 0>, io_port_pin<'D', 7>, io_port_pin<'B', 2>,
+      io_port_pin<'C', 5>, io_port_pin<'D', 2>
+   >();
+   // 17 pins, needing a 32-bit word.
+   test_layout<
+      io_port_pin<'B', 0>, io_port_pin<'B', 1>, io_port_pin<'B', 2>, io_port_pin<'B', 3>,
+      io_port_pin<'B', 4>, io_port_pin<'B', 5>, io_port_pin<'B', 6>, io_port_pin<'B', 7>,
+      io_port_pin<'C', 0>, io_port_pin<'C', 1>, io_port_pin<'C', 2>, io_port_pin<'C', 3>,
+      io_port_pin<'C', 4>, io_port_pin<'C', 5>, io_port_pin<'D', 6>, io_port_pin<'D', 3>,
+      io_port_pin<'D', 1>
+   >();
+   return rawr::test::result();
+}
+
+#else //if defined(PORTB) && defined(PORTC) && defined(PORTD)
+
+int main() {
+   puts("skipped: the selected MCU lacks port B, C or D");
+   return 0;
+}
+
+#endif //if defined(PORTB) && defined(PORTC) && defined(PORTD) … else
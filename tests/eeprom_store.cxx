@@ -0,0 +1,124 @@
+/* -*- coding: utf-8; mode: c++; tab-width: 3; indent-tabs-mode: nil -*-
+
+Copyright 2022 Raffaello D. Di Napoli
+
+This file is part of RAWR.
+
+RAWR is free software: you can redistribute it and/or modify it under the terms of version 2.1 of the GNU
+Lesser General Public License as published by the Free Software Foundation.
+
+RAWR is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for
+more details.
+------------------------------------------------------------------------------------------------------------*/
+
+/*! @file
+rawr::eeprom_store tests: defaults on an erased EEPROM, persistence across “reboots” (new stores over the same
+simulated EEPROM), coalescing of changes made during a commit, skipped no-op commits, recovery from a commit
+torn by a power loss, and many commits wrapping around the ring of slots. They all use the same store type,
+since the EEPROM ready interrupt handler can only be defined once. */
+
+#include <rawr/eeprom_store.hxx>
+#include "test.hxx"
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct settings {
+   uint8_t brightness;
+   uint16_t period;
+   uint8_t mode;
+};
+
+typedef rawr::eeprom_store<settings, 4, 16> store_t;
+
+static bool equal(settings const & a, settings const & b) {
+   return a.brightness == b.brightness && a.period == b.period && a.mode == b.mode;
+}
+
+//! Runs the simulated clock until the pending commit is done; returns how long that took, in ms.
+static unsigned wait_commit(store_t const & store) {
+   unsigned ms{0};
+   for (; store.pending() && ms < 10000; ++ms) {
+      rawr::host::advance(1_ms);
+   }
+   return ms;
+}
+
+static void test_defaults_and_persistence() {
+   rawr::host::eeprom = {};
+   {
+      store_t store{settings{128, 500, 1}};
+      RAWR_TEST_CHECK(equal(store.get(), settings{128, 500, 1}));
+      RAWR_TEST_CHECK(!store.pending());
+      store.set(&settings::brightness, 200);
+      RAWR_TEST_CHECK(store.pending());
+      RAWR_TEST_CHECK(equal(store.get(), settings{200, 500, 1}));
+      wait_commit(store);
+      RAWR_TEST_CHECK(!store.pending());
+      // Same value: nothing to commit.
+      store.set(&settings::mode, 1);
+      RAWR_TEST_CHECK(!store.pending());
+   }
+   store_t store{settings{0, 0, 0}};
+   RAWR_TEST_CHECK(equal(store.get(), settings{200, 500, 1}));
+}
+
+static void test_coalescing() {
+   store_t store{settings{0, 0, 0}};
+   unsigned ms{0};
+   // Changes keep coming while commits are in progress, like from a knob being turned.
+   for (uint16_t i = 0; i < 50; ++i) {
+      store.set(&settings::period, static_cast<uint16_t>(600 + i));
+      rawr::host::advance(1_ms);
+      ++ms;
+   }
+   ms += wait_commit(store);
+   /* One commit of the whole record (up to 6 bytes, 3.4 ms each) per change would take over 500 ms; coalesced,
+   only a few commits are needed. */
+   RAWR_TEST_CHECK(ms < 150);
+   RAWR_TEST_CHECK(store.get().period == 649);
+}
+
+static void test_torn_commit() {
+   settings before;
+   decltype(rawr::host::eeprom) torn;
+   {
+      store_t store{settings{0, 0, 0}};
+      before = store.get();
+      store.update([] (settings & record) {
+         record.brightness = 7;
+         record.period = 1234;
+      });
+      // Lose power a few bytes into the commit.
+      rawr::host::advance(5_ms);
+      torn = rawr::host::eeprom;
+      wait_commit(store);
+   }
+   rawr::host::eeprom = torn;
+   store_t store{settings{0, 0, 0}};
+   RAWR_TEST_CHECK(equal(store.get(), before));
+}
+
+static void test_ring_wrap() {
+   rawr::host::eeprom = {};
+   // Enough commits to wrap around the ring, and the 8-bit sequence numbers, several times.
+   unsigned mismatches{0};
+   for (uint16_t i = 1; i <= 700; ++i) {
+      store_t store{settings{0, 0, 0}};
+      if (store.get().period != i - 1) {
+         ++mismatches;
+      }
+      store.set(&settings::period, i);
+      wait_commit(store);
+   }
+   RAWR_TEST_CHECK(mismatches == 0);
+}
+
+int main() {
+   sei();
+   test_defaults_and_persistence();
+   test_coalescing();
+   test_torn_commit();
+   test_ring_wrap();
+   return rawr::test::result();
+}
@@ -0,0 +1,129 @@
+/* -*- coding: utf-8; mode: c++; tab-width: 3; indent-tabs-mode: nil -*-
+
+Copyright 2022 Raffaello D. Di Napoli
+
+This file is part of RAWR.
+
+RAWR is free software: you can redistribute it and/or modify it under the terms of version 2.1 of the GNU
+Lesser General Public License as published by the Free Software Foundation.
+
+RAWR is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for
+more details.
+------------------------------------------------------------------------------------------------------------*/
+
+/*! @file
+rawr::function, rawr::inplace_function and rawr::function_ref tests: calls, and copies, moves, assignments
+and destruction of captured objects, counted to catch leaks and double destructions. */
+
+#include <rawr/function.hxx>
+#include <rawr/function_ref.hxx>
+#include <rawr/inplace_function.hxx>
+#include "test.hxx"
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//! Captured by the lambdas below; counts its constructions and destructions.
+struct counted {
+   static inline int live, copies, moves;
+
+   int value;
+
+   explicit counted(int value_) :
+      value{value_} {
+      ++live;
+   }
+
+   counted(counted const & src) :
+      value{src.value} {
+      ++live;
+      ++copies;
+   }
+
+   counted(counted && src) :
+      value{src.value} {
+      ++live;
+      ++moves;
+   }
+
+   ~counted() {
+      --live;
+   }
+
+   static void reset() {
+      live = copies = moves = 0;
+   }
+};
+
+template <typename F>
+static void test_non_trivial() {
+   counted::reset();
+   {
+      F f{[c = counted{40}] (int i) {
+         return c.value + i;
+      }};
+      RAWR_TEST_CHECK(counted::live == 1);
+      RAWR_TEST_CHECK(f && f(2) == 42);
+
+      F copy{f};
+      RAWR_TEST_CHECK(counted::copies == 1 && counted::live == 2);
+      RAWR_TEST_CHECK(copy(1) == 41 && f(1) == 41);
+
+      F moved{static_cast<F &&>(copy)};
+      RAWR_TEST_CHECK(!copy);
+      RAWR_TEST_CHECK(counted::live == 2);
+      RAWR_TEST_CHECK(moved(3) == 43);
+
+      F assigned;
+      RAWR_TEST_CHECK(!assigned);
+      assigned = f;
+      RAWR_TEST_CHECK(counted::live == 3 && assigned(0) == 40);
+      // Replacing a set F must destruct its lambda first.
+      assigned = static_cast<F &&>(moved);
+      RAWR_TEST_CHECK(!moved);
+      RAWR_TEST_CHECK(counted::live == 2 && assigned(0) == 40);
+      assigned = nullptr;
+      RAWR_TEST_CHECK(!assigned);
+      RAWR_TEST_CHECK(counted::live == 1);
+      // Self-assignment must leave it unchanged.
+      auto & f_alias{f};
+      f = f_alias;
+      RAWR_TEST_CHECK(counted::live == 1 && f(0) == 40);
+   }
+   RAWR_TEST_CHECK(counted::live == 0);
+}
+
+template <typename F>
+static void test_trivial() {
+   int base{10};
+   F f{[base] (int i) {
+      return base * i;
+   }};
+   F copy{f}, moved{static_cast<F &&>(f)};
+   RAWR_TEST_CHECK(!f);
+   RAWR_TEST_CHECK(copy(2) == 20 && moved(3) == 30);
+   f = copy;
+   RAWR_TEST_CHECK(f(4) == 40);
+}
+
+static void test_function_ref() {
+   int calls{0};
+   auto lambda{[&calls] (int i) {
+      ++calls;
+      return i + 1;
+   }};
+   rawr::function_ref<int (int)> ref{lambda}, empty;
+   RAWR_TEST_CHECK(!empty);
+   RAWR_TEST_CHECK(ref && ref(1) == 2 && calls == 1);
+   auto copy{ref};
+   RAWR_TEST_CHECK(copy(2) == 3 && calls == 2);
+}
+
+int main() {
+   test_non_trivial<rawr::function<int (int)>>();
+   test_non_trivial<rawr::inplace_function<int (int), sizeof(counted)>>();
+   test_trivial<rawr::function<int (int)>>();
+   test_trivial<rawr::inplace_function<int (int), sizeof(int)>>();
+   test_function_ref();
+   return rawr::test::result();
+}
@@ -0,0 +1,106 @@
+/* -*- coding: utf-8; mode: c++; tab-width: 3; indent-tabs-mode: nil -*-
+
+Copyright 2022 Raffaello D. Di Napoli
+
+This file is part of RAWR.
+
+RAWR is free software: you can redistribute it and/or modify it under the terms of version 2.1 of the GNU
+Lesser General Public License as published by the Free Software Foundation.
+
+RAWR is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for
+more details.
+------------------------------------------------------------------------------------------------------------*/
+
+/*! @file
+rawr::power_manager tests: a timer_mux delay slept through with watchdog naps must never expire early, an
+interrupt cutting a nap short must not be credited as time slept and must shorten the following naps, and a
+watchdog timer already in interrupt mode must be left alone. */
+
+#define RAWR_POWER_MANAGEMENT
+
+#include <rawr/binary_input_pin.hxx>
+#include <rawr/power_manager.hxx>
+#include <rawr/timer_mux.hxx>
+#include "test.hxx"
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+typedef rawr::timer_mux<0, 2> timer_mux_t;
+
+static bool fired;
+//! Prescaler bits of the watchdog timer when each pin change interrupt was serviced.
+static uint8_t watchdog_bits_at_pin_change[2];
+static uint8_t pin_changes;
+
+static uint8_t watchdog_bits() {
+   return static_cast<uint8_t>(WDTCR & (_BV(WDP3) | _BV(WDP2) | _BV(WDP1) | _BV(WDP0)));
+}
+
+//! Sleeps like rawr::event_loop::run() would, until the delay scheduled by schedule() expires.
+static uint32_t sleep_until_fired() {
+   auto start{rawr::host::elapsed_cycles()};
+   while (!fired) {
+      cli();
+      rawr::power_manager::sleep();
+   }
+   return static_cast<uint32_t>((rawr::host::elapsed_cycles() - start) * 1000 / F_CPU);
+}
+
+static void schedule(timer_mux_t & timer_mux) {
+   fired = false;
+   timer_mux.once(2000_ms, [] () {
+      fired = true;
+   });
+}
+
+//! Returns how long the delay takes without naps, i.e. with the accuracy of the timer/counter alone.
+static uint32_t test_watchdog_interrupt_mode_not_taken_over(timer_mux_t & timer_mux) {
+   WDTCR = _BV(WDIE) | _BV(WDP1);
+   schedule(timer_mux);
+   auto ms{sleep_until_fired()};
+   RAWR_TEST_CHECK(WDTCR == (_BV(WDIE) | _BV(WDP1)));
+   WDTCR = 0;
+   return ms;
+}
+
+static void test_naps_never_early(timer_mux_t & timer_mux, uint32_t idle_ms) {
+   schedule(timer_mux);
+   auto ms{sleep_until_fired()};
+   // Crediting the shortest possible nap makes the delay a little late, never early.
+   RAWR_TEST_CHECK(ms > idle_ms);
+   RAWR_TEST_CHECK(ms <= idle_ms * 6 / 5);
+}
+
+static void test_early_wake_up(timer_mux_t & timer_mux, uint32_t idle_ms) {
+   schedule(timer_mux);
+   // A pending pin change interrupt cuts each of the next two naps short, right as they start.
+   for (uint8_t i = 0; i < 2; ++i) {
+      cli();
+      rawr::host::set_pin<'D'>(4, i == 0);
+      rawr::power_manager::sleep();
+   }
+   RAWR_TEST_CHECK(pin_changes == 2);
+   RAWR_TEST_CHECK(watchdog_bits_at_pin_change[0] > 0);
+   RAWR_TEST_CHECK(watchdog_bits_at_pin_change[1] == watchdog_bits_at_pin_change[0] - 1);
+   // No time was lost, and none must be credited.
+   auto ms{sleep_until_fired()};
+   RAWR_TEST_CHECK(ms > idle_ms);
+   RAWR_TEST_CHECK(ms <= idle_ms * 6 / 5);
+}
+
+int main() {
+   sei();
+   timer_mux_t timer_mux;
+   rawr::binary_input_pin<'D', 4> pin{false};
+   pin.set_callback([] (bool) {
+      if (pin_changes < 2) {
+         watchdog_bits_at_pin_change[pin_changes] = watchdog_bits();
+      }
+      ++pin_changes;
+   });
+   auto idle_ms{test_watchdog_interrupt_mode_not_taken_over(timer_mux)};
+   test_naps_never_early(timer_mux, idle_ms);
+   test_early_wake_up(timer_mux, idle_ms);
+   return rawr::test::result();
+}
@@ -0,0 +1,47 @@
+/* -*- coding: utf-8; mode: c++; tab-width: 3; indent-tabs-mode: nil -*-
+
+Copyright 2022 Raffaello D. Di Napoli
+
+This file is part of RAWR.
+
+RAWR is free software: you can redistribute it and/or modify it under the terms of version 2.1 of the GNU
+Lesser General Public License as published by the Free Software Foundation.
+
+RAWR is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for
+more details.
+------------------------------------------------------------------------------------------------------------*/
+
+/*! @file
+rawr::pwm_output tests: lowering TOP = ICRn below the counter must neither wait for the period to end, nor let
+the counter run up to its maximum value before wrapping around. */
+
+#include <rawr/pwm_output.hxx>
+#include "test.hxx"
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+typedef rawr::hw::timer_counter<1> timer_counter_t;
+
+static void test_lower_top_past_counter() {
+   rawr::pwm_output<1, 'B'> pwm{10_Hz, 128};
+   auto slow_top{pwm.top()};
+   // Most of the way through a 100 ms period.
+   rawr::host::advance(90_ms);
+   RAWR_TEST_CHECK(timer_counter_t::value > slow_top / 2);
+
+   auto start{rawr::host::elapsed_cycles()};
+   pwm.set_frequency(1_kHz);
+   RAWR_TEST_CHECK(rawr::host::elapsed_cycles() == start);
+   RAWR_TEST_CHECK(pwm.top() < slow_top / 2);
+   RAWR_TEST_CHECK(timer_counter_t::control_registers.get_cs() != 0);
+
+   // The counter wraps around within a period of the new frequency, rather than after 0xffff ticks.
+   rawr::host::advance(2_ms);
+   RAWR_TEST_CHECK(timer_counter_t::value <= pwm.top());
+}
+
+int main() {
+   test_lower_top_past_counter();
+   return rawr::test::result();
+}
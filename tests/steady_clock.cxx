@@ -0,0 +1,91 @@
+/* -*- coding: utf-8; mode: c++; tab-width: 3; indent-tabs-mode: nil -*-
+
+Copyright 2022 Raffaello D. Di Napoli
+
+This file is part of RAWR.
+
+RAWR is free software: you can redistribute it and/or modify it under the terms of version 2.1 of the GNU
+Lesser General Public License as published by the Free Software Foundation.
+
+RAWR is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for
+more details.
+------------------------------------------------------------------------------------------------------------*/
+
+/*! @file
+rawr::steady_clock and rawr::trace tests: ticks against simulated CPU cycles, reads across a wrap-around the
+interrupt handler hasn’t accounted for yet, and order, timestamps and overwriting of trace records. */
+
+#define RAWR_TRACE 1
+#define RAWR_TRACE_SIZE 8
+
+#include <rawr/steady_clock.hxx>
+#include <rawr/trace.hxx>
+#include "test.hxx"
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+typedef rawr::steady_clock<1, 8> clock_t_;
+
+static void test_ticks(clock_t_ & clock) {
+   auto start_cycles{rawr::host::elapsed_cycles()};
+   auto start{clock.now()};
+   rawr::host::advance(1_s);
+   auto ticks{clock.now() - start};
+   auto cycles{rawr::host::elapsed_cycles() - start_cycles};
+   RAWR_TEST_CHECK(ticks == cycles / 8 || ticks == cycles / 8 + 1);
+   RAWR_TEST_CHECK(clock_t_::to<rawr::chrono::milliseconds>(ticks).count() == 1000);
+   RAWR_TEST_CHECK(clock.elapsed<rawr::chrono::microseconds>(start).count() >= 1000000);
+}
+
+static void test_wrap_with_interrupts_disabled(clock_t_ & clock) {
+   cli();
+   // Stop right past a wrap-around of the 16-bit counter, which the handler can’t count yet.
+   auto before{clock.now()};
+   auto to_wrap{0x10000u - rawr::hw::timer_counter<1>::value};
+   rawr::host::advance_cycles(uint64_t{to_wrap} * 8 + 8);
+   auto during{clock.now()};
+   sei();
+   auto after{clock.now()};
+   RAWR_TEST_CHECK(during - before == to_wrap + 1);
+   // Once the handler runs, the wrap-around must not be counted twice.
+   RAWR_TEST_CHECK(after - during <= 1);
+}
+
+static void test_trace() {
+   rawr::trace::record records[RAWR_TRACE_SIZE];
+   while (rawr::trace::drain(records, RAWR_TRACE_SIZE) != 0) {
+   }
+
+   rawr::trace::isr_entry(0x20);
+   rawr::host::advance(1_ms);
+   rawr::trace::mark(5);
+   rawr::host::advance(1_ms);
+   rawr::trace::isr_exit(0x20);
+   auto count{rawr::trace::drain(records, RAWR_TRACE_SIZE)};
+   RAWR_TEST_CHECK(count == 3);
+   RAWR_TEST_CHECK(records[0].event == 0x20);
+   RAWR_TEST_CHECK(records[1].event == (rawr::trace::marker_flag | 5));
+   RAWR_TEST_CHECK(records[2].event == (rawr::trace::isr_exit_flag | 0x20));
+   // Stamped with the ticks of the clock at the time of each event.
+   RAWR_TEST_CHECK(records[1].ticks > records[0].ticks && records[2].ticks > records[1].ticks);
+
+   // When full, the oldest records are overwritten.
+   for (uint8_t i = 0; i < RAWR_TRACE_SIZE + 3; ++i) {
+      rawr::trace::mark(i);
+   }
+   count = rawr::trace::drain(records, RAWR_TRACE_SIZE);
+   RAWR_TEST_CHECK(count == RAWR_TRACE_SIZE);
+   RAWR_TEST_CHECK(records[0].event == (rawr::trace::marker_flag | 3));
+   RAWR_TEST_CHECK(records[RAWR_TRACE_SIZE - 1].event == (rawr::trace::marker_flag | (RAWR_TRACE_SIZE + 2)));
+   RAWR_TEST_CHECK(rawr::trace::drain(records, RAWR_TRACE_SIZE) == 0);
+}
+
+int main() {
+   sei();
+   clock_t_ clock;
+   test_ticks(clock);
+   test_wrap_with_interrupts_disabled(clock);
+   test_trace();
+   return rawr::test::result();
+}
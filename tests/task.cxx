@@ -0,0 +1,132 @@
+/* -*- coding: utf-8; mode: c++; tab-width: 3; indent-tabs-mode: nil -*-
+
+Copyright 2022 Raffaello D. Di Napoli
+
+This file is part of RAWR.
+
+RAWR is free software: you can redistribute it and/or modify it under the terms of version 2.1 of the GNU
+Lesser General Public License as published by the Free Software Foundation.
+
+RAWR is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for
+more details.
+------------------------------------------------------------------------------------------------------------*/
+
+/*! @file
+rawr::task tests: resuming via rawr::resume_callback, timing of timer_mux::delay() with deferred callbacks,
+reuse of the frames of finished coroutines, and abort() when the pool is exhausted. */
+
+#define RAWR_DEFERRED_CALLBACKS
+
+#include <rawr/event_loop.hxx>
+#include <rawr/inplace_function.hxx>
+#include <rawr/task.hxx>
+#include <rawr/timer_mux.hxx>
+#include "test.hxx"
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+typedef rawr::task<2> task_t;
+typedef rawr::timer_mux<
+   0, 2, rawr::chrono::milliseconds, rawr::inplace_function<void (), sizeof(void *)>
+> timer_mux_t;
+
+//! Thrown by the abort reporter, to get back to the test instead of resetting.
+struct aborted {
+   rawr::abort_reason reason;
+};
+
+static void throw_aborted(rawr::abort_reason reason) {
+   throw aborted{reason};
+}
+
+//! Advances the simulated clock 1 ms at a time, running posted callbacks after each step.
+static void advance_ms(unsigned ms) {
+   for (; ms > 0; --ms) {
+      rawr::host::advance(1_ms);
+      rawr::event_loop::run_until_idle();
+   }
+}
+
+static task_t sum_events(rawr::resume_callback<int> & event, unsigned count, int & sum) {
+   for (; count > 0; --count) {
+      int value{co_await event.wait()};
+      sum += value;
+   }
+}
+
+static task_t record_steps(timer_mux_t & timer_mux, uint64_t (& times)[4]) {
+   uint64_t start{rawr::host::elapsed_cycles()};
+   co_await timer_mux.delay(100_ms);
+   times[0] = rawr::host::elapsed_cycles() - start;
+   co_await timer_mux.delay(100_ms);
+   times[1] = rawr::host::elapsed_cycles() - start;
+   co_await timer_mux.delay(100_ms);
+   times[2] = rawr::host::elapsed_cycles() - start;
+   co_await timer_mux.delay(700_ms);
+   times[3] = rawr::host::elapsed_cycles() - start;
+}
+
+static void test_resume_callback() {
+   rawr::resume_callback<int> event;
+   int sum{0};
+   sum_events(event, 3, sum);
+   event(1);
+   event(2);
+   RAWR_TEST_CHECK(sum == 3);
+   event(4);
+   RAWR_TEST_CHECK(sum == 7);
+   // The coroutine has returned: further calls find no waiter.
+   event(8);
+   RAWR_TEST_CHECK(sum == 7);
+}
+
+static void test_delays(timer_mux_t & timer_mux) {
+   uint64_t times[4]{};
+   record_steps(timer_mux, times);
+   advance_ms(1100);
+   constexpr uint64_t expected_ms[4]{100, 200, 300, 1000};
+   for (uint8_t i = 0; i < 4; ++i) {
+      auto ms{times[i] * 1000 / F_CPU};
+      // Within the rounding of timer_mux’s milliseconds to ticks, plus the 1 ms polling above.
+      RAWR_TEST_CHECK(ms + expected_ms[i] / 32 + 2 >= expected_ms[i] && ms <= expected_ms[i] * 33 / 32 + 2);
+   }
+}
+
+static void test_pool() {
+   rawr::resume_callback<int> event_a, event_b, event_c;
+   int sum{0};
+   // Both frames in use.
+   sum_events(event_a, 1, sum);
+   sum_events(event_b, 1, sum);
+   bool aborted_pool_full{false};
+   try {
+      sum_events(event_c, 1, sum);
+   } catch (aborted const & x) {
+      aborted_pool_full = x.reason == rawr::abort_reason::task_pool_full;
+   }
+   RAWR_TEST_CHECK(aborted_pool_full);
+
+   // Once one returns, its frame can be used again.
+   event_a(1);
+   bool aborted_again{false};
+   try {
+      sum_events(event_c, 1, sum);
+   } catch (aborted const &) {
+      aborted_again = true;
+   }
+   RAWR_TEST_CHECK(!aborted_again);
+   event_b(2);
+   event_c(4);
+   RAWR_TEST_CHECK(sum == 7);
+}
+
+int main() {
+   sei();
+   rawr::abort_reporter = &throw_aborted;
+   timer_mux_t timer_mux;
+   test_resume_callback();
+   test_delays(timer_mux);
+   test_pool();
+   return rawr::test::result();
+}
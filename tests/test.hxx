@@ -0,0 +1,50 @@
+/* -*- coding: utf-8; mode: c++; tab-width: 3; indent-tabs-mode: nil -*-
+
+Copyright 2022 Raffaello D. Di Napoli
+
+This file is part of RAWR.
+
+RAWR is free software: you can redistribute it and/or modify it under the terms of version 2.1 of the GNU
+Lesser General Public License as published by the Free Software Foundation.
+
+RAWR is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for
+more details.
+------------------------------------------------------------------------------------------------------------*/
+
+/*! @file
+Minimal support for the host test programs in this directory, run by `make test`. Each program is built with
+RAWR_HOST, checks its results with RAWR_TEST_CHECK(), and exits with 0 only if all of them passed. */
+
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace rawr { namespace test {
+
+//! Number of failed checks so far.
+inline unsigned failures;
+
+//! Reports a failed check; used by RAWR_TEST_CHECK().
+inline void fail(char const * file, unsigned line, char const * expr) {
+   fprintf(stderr, "%s:%u: check failed: %s\n", file, line, expr);
+   ++failures;
+}
+
+//! Returns the exit code for main(), after printing a summary.
+inline int result() {
+   if (failures != 0) {
+      fprintf(stderr, "%u checks failed\n", failures);
+      return 1;
+   }
+   return 0;
+}
+
+}} //namespace rawr::test
+
+//! Checks that expr is true, reporting it as a failure otherwise; execution continues either way.
+#define RAWR_TEST_CHECK(expr) \
+   ((expr) ? void() : rawr::test::fail(__FILE__, __LINE__, #expr))
@@ -0,0 +1,173 @@
+/* -*- coding: utf-8; mode: c++; tab-width: 3; indent-tabs-mode: nil -*-
+
+Copyright 2022 Raffaello D. Di Napoli
+
+This file is part of RAWR.
+
+RAWR is free software: you can redistribute it and/or modify it under the terms of version 2.1 of the GNU
+Lesser General Public License as published by the Free Software Foundation.
+
+RAWR is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for
+more details.
+------------------------------------------------------------------------------------------------------------*/
+
+/*! @file
+rawr::timer_mux tests: expiry order and timing of queued delays, repeats, delays long enough to be split
+into chunks, cancellation, zero-length delays, late interrupts, and delays in seconds too long for 32-bit
+ticks. timer_mux-deferred.cxx runs them again with RAWR_DEFERRED_CALLBACKS. */
+
+#include <rawr/timer_mux.hxx>
+#include "test.hxx"
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//! Advances the simulated clock, running deferred callbacks within 1 ms of being posted.
+template <typename Duration>
+static void advance(Duration duration) {
+#ifdef RAWR_DEFERRED_CALLBACKS
+   for (auto ms{uint32_t{duration.count()} * 1000 / Duration::scale}; ms > 0; --ms) {
+      rawr::host::advance(1_ms);
+      rawr::event_loop::run_until_idle();
+   }
+#else
+   rawr::host::advance(duration);
+#endif
+}
+
+//! Returns the simulated time elapsed since start, in ms.
+static uint64_t ms_since(uint64_t start) {
+   return (rawr::host::elapsed_cycles() - start) * 1000 / F_CPU;
+}
+
+/*! Returns true if actual_ms is expected_ms, give or take about 3% and 2 ms: millisecond delays are converted
+with a whole number of ticks per milliscaler, which can be off by a few % (e.g. 16 instead of 15.625 ticks
+per 4 ms at 1 MHz), and each delay can end up to a tick late. */
+static bool close_to(uint64_t actual_ms, uint64_t expected_ms) {
+   uint64_t tolerance{expected_ms / 32 + 2};
+   return actual_ms + tolerance >= expected_ms && actual_ms <= expected_ms + tolerance;
+}
+
+static void test_expiry_order(rawr::timer_mux<0, 4> & timer_mux) {
+   uint64_t start{rawr::host::elapsed_cycles()};
+   uint16_t fired[3]{};
+   uint64_t fired_ms[3]{};
+   uint8_t count{0};
+   auto record{[&] (uint16_t id) {
+      fired[count] = id;
+      fired_ms[count] = ms_since(start);
+      ++count;
+   }};
+   // Enqueued out of order, so each one is inserted at a different position in the queue.
+   timer_mux.once(300_ms, [&] { record(300); });
+   timer_mux.once(100_ms, [&] { record(100); });
+   timer_mux.once(200_ms, [&] { record(200); });
+   advance(400_ms);
+   RAWR_TEST_CHECK(count == 3);
+   RAWR_TEST_CHECK(fired[0] == 100 && fired[1] == 200 && fired[2] == 300);
+   for (uint8_t i = 0; i < count; ++i) {
+      RAWR_TEST_CHECK(close_to(fired_ms[i], fired[i]));
+   }
+}
+
+static void test_repeat(rawr::timer_mux<0, 4> & timer_mux) {
+   unsigned count{0};
+   auto repeat{timer_mux.repeat(50_ms, [&] { ++count; })};
+   advance(1025_ms);
+   RAWR_TEST_CHECK(count == 20);
+   repeat.cancel();
+   advance(200_ms);
+   RAWR_TEST_CHECK(count == 20);
+}
+
+static void test_chunked(rawr::timer_mux<0, 4> & timer_mux) {
+   // Long enough to need several chunks of 0xffff ticks with any F_CPU and prescaler.
+   constexpr uint64_t long_ms{200000};
+   uint64_t start{rawr::host::elapsed_cycles()}, fired_ms{0};
+   unsigned ticks{0};
+   timer_mux.once(200_s, [&] { fired_ms = ms_since(start); });
+   // Other delays come and go while the long one is queued, and must not shift it.
+   auto repeat{timer_mux.repeat(1000_ms, [&] { ++ticks; })};
+   advance(199_s);
+   RAWR_TEST_CHECK(fired_ms == 0);
+   advance(2_s);
+   RAWR_TEST_CHECK(close_to(fired_ms, long_ms));
+   RAWR_TEST_CHECK(close_to(ticks * uint64_t{1000}, 201000));
+   repeat.cancel();
+}
+
+static void test_cancel(rawr::timer_mux<0, 4> & timer_mux) {
+   unsigned canceled_count{0}, first_count{0};
+   // Grouped, so the lambda that needs it all only captures one reference.
+   struct {
+      uint64_t start{rawr::host::elapsed_cycles()}, fired_ms{0};
+      unsigned count{0};
+   } last_state;
+   // Canceling must release the delay right away, or the 4 delays would run out.
+   for (unsigned i = 0; i < 100; ++i) {
+      timer_mux.once(100_ms, [&] { ++canceled_count; }).cancel();
+   }
+   // Cancel the middle of three queued delays; the last one must keep its timing.
+   auto first{timer_mux.once(100_ms, [&] { ++first_count; })};
+   auto middle{timer_mux.once(200_ms, [&] { ++canceled_count; })};
+   auto last{timer_mux.once(300_ms, [&last_state] {
+      ++last_state.count;
+      last_state.fired_ms = ms_since(last_state.start);
+   })};
+   middle.cancel();
+   advance(400_ms);
+   RAWR_TEST_CHECK(canceled_count == 0);
+   RAWR_TEST_CHECK(first_count == 1);
+   RAWR_TEST_CHECK(last_state.count == 1);
+   RAWR_TEST_CHECK(close_to(last_state.fired_ms, 300));
+   (void) first;
+   (void) last;
+}
+
+static void test_zero(rawr::timer_mux<0, 4> & timer_mux) {
+   unsigned ms_count{0}, s_count{0};
+   timer_mux.once(0_ms, [&] { ++ms_count; });
+   timer_mux.once(0_s, [&] { ++s_count; });
+   advance(2_ms);
+   RAWR_TEST_CHECK(ms_count == 1);
+   RAWR_TEST_CHECK(s_count == 1);
+}
+
+static void test_late_interrupt(rawr::microsecond_timer_mux<2> & us_timer_mux) {
+   uint64_t start{rawr::host::elapsed_cycles()}, fired_ms[2]{};
+   us_timer_mux.once(rawr::chrono::microseconds(10000), [&] { fired_ms[0] = ms_since(start); });
+   us_timer_mux.once(rawr::chrono::microseconds(30000), [&] { fired_ms[1] = ms_since(start); });
+   /* Keep the interrupt from being serviced until after both delays expired; the ticks past the first one
+   must count towards the second one too, instead of restarting it from the late interrupt. */
+   cli();
+   rawr::host::advance(50_ms);
+   sei();
+   advance(2_ms);
+   RAWR_TEST_CHECK(close_to(fired_ms[0], 50));
+   RAWR_TEST_CHECK(close_to(fired_ms[1], 50));
+}
+
+static void test_saturated(rawr::microsecond_timer_mux<2> & us_timer_mux) {
+   // With ticks of about 1 µs, 0xffff seconds overflow 32 bits, and would wrap around to a shorter delay.
+   constexpr auto max_seconds{rawr::microsecond_timer_mux<2>::max_seconds};
+   uint64_t start{rawr::host::elapsed_cycles()}, fired_ms{0};
+   us_timer_mux.once(rawr::chrono::seconds(0xffff), [&] { fired_ms = ms_since(start); });
+   for (uint32_t s = 0; fired_ms == 0 && s <= 0xffff; ++s) {
+      advance(1_s);
+   }
+   RAWR_TEST_CHECK(close_to(fired_ms, uint64_t{max_seconds.count()} * 1000));
+}
+
+int main() {
+   sei();
+   rawr::timer_mux<0, 4> timer_mux;
+   rawr::microsecond_timer_mux<2> us_timer_mux;
+   test_expiry_order(timer_mux);
+   test_repeat(timer_mux);
+   test_chunked(timer_mux);
+   test_cancel(timer_mux);
+   test_zero(timer_mux);
+   test_late_interrupt(us_timer_mux);
+   test_saturated(us_timer_mux);
+   return rawr::test::result();
+}
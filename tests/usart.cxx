@@ -0,0 +1,104 @@
+/* -*- coding: utf-8; mode: c++; tab-width: 3; indent-tabs-mode: nil -*-
+
+Copyright 2022 Raffaello D. Di Napoli
+
+This file is part of RAWR.
+
+RAWR is free software: you can redistribute it and/or modify it under the terms of version 2.1 of the GNU
+Lesser General Public License as published by the Free Software Foundation.
+
+RAWR is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for
+more details.
+------------------------------------------------------------------------------------------------------------*/
+
+/*! @file
+rawr::usart tests: the receive callback is invoked for each byte as it arrives, so an echo keeps up with any
+amount of data without dropping any, and the destructor disables the USART and lets the CPU sleep in
+power-down mode again. */
+
+#define RAWR_POWER_MANAGEMENT
+
+#include <rawr/power_manager.hxx>
+#include <rawr/timer_mux.hxx>
+#include <rawr/usart.hxx>
+#include "test.hxx"
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+typedef rawr::usart<0, 9600> usart_t;
+
+static uint8_t transmitted[200];
+static uint8_t transmitted_size;
+
+static void record_transmitted(int, uint8_t byte) {
+   transmitted[transmitted_size++] = byte;
+}
+
+/*! Sleeps through a delay like rawr::event_loop::run() would, returning true if power_manager put the CPU in
+power-down mode at least once, i.e. nothing but the timer_mux needed the I/O clock. */
+static bool sleeps_in_power_down(rawr::timer_mux<0> & timer_mux) {
+   bool fired{false}, power_down{false};
+   timer_mux.once(50_ms, [&fired] () {
+      fired = true;
+   });
+   while (!fired) {
+      cli();
+      rawr::power_manager::sleep();
+      auto mode{static_cast<uint8_t>(rawr::_pvt::sleep_control & (_BV(SM2) | _BV(SM1) | _BV(SM0)))};
+      power_down = power_down || mode == rawr::_pvt::sleep_modes::power_down;
+   }
+   return power_down;
+}
+
+static void test_echo(usart_t & usart) {
+   unsigned callbacks{0};
+   usart.set_rx_callback([&usart, &callbacks] (uint8_t available) {
+      ++callbacks;
+      RAWR_TEST_CHECK(available == 1);
+      uint8_t byte;
+      while (usart.read(&byte)) {
+         usart.put(byte);
+      }
+   });
+   // Far more than RxCapacity, with no time for polling in between.
+   for (uint8_t i = 0; i < sizeof transmitted; ++i) {
+      rawr::host::receive<0>(static_cast<uint8_t>(i * 7));
+   }
+   RAWR_TEST_CHECK(callbacks == sizeof transmitted);
+   RAWR_TEST_CHECK(transmitted_size == sizeof transmitted);
+   bool all_echoed{true};
+   for (uint8_t i = 0; i < transmitted_size; ++i) {
+      all_echoed = all_echoed && transmitted[i] == static_cast<uint8_t>(i * 7);
+   }
+   RAWR_TEST_CHECK(all_echoed);
+   RAWR_TEST_CHECK(!usart.take_rx_error());
+}
+
+static void test_destructor(rawr::timer_mux<0> & timer_mux) {
+   unsigned callbacks{0};
+   {
+      usart_t usart;
+      usart.set_rx_callback([&callbacks] (uint8_t) {
+         ++callbacks;
+      });
+      // The receiver keeps the I/O clock running.
+      RAWR_TEST_CHECK(!sleeps_in_power_down(timer_mux));
+   }
+   RAWR_TEST_CHECK(rawr::hw::usart<0>::control_status_b == 0);
+   rawr::host::receive<0>('x');
+   RAWR_TEST_CHECK(callbacks == 0);
+   RAWR_TEST_CHECK(sleeps_in_power_down(timer_mux));
+}
+
+int main() {
+   rawr::host::usart_transmit_handler = &record_transmitted;
+   sei();
+   rawr::timer_mux<0> timer_mux;
+   {
+      usart_t usart;
+      test_echo(usart);
+   }
+   test_destructor(timer_mux);
+   return rawr::test::result();
+}